@@ -0,0 +1,296 @@
+/** File:		sph_kernel.h
+ ** Author:		Dongli Zhang
+ ** Contact:	dongli.zhang0129@gmail.com
+ **
+ ** Copyright (C) Dongli Zhang 2013
+ **
+ ** This program is free software;  you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+ ** the GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program;  if not, write to the Free Software
+ ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef __SPHKERNEL_H__
+#define __SPHKERNEL_H__
+
+#include "sph_header.h"
+#include "sph_type.h"
+
+/** Smoothing kernels templated on the dimension.
+ **
+ ** The dimension dependent normalisation is a compile-time constant picked by
+ ** specialisation, only the power of h is folded in once when the kernel is
+ ** constructed. Every kernel exposes the same branch-free evaluators so the
+ ** solver loops only see value(r2), grad(r) and lplc(r):
+ **
+ **   value(r2)  W(r)        from the squared distance
+ **   grad(r)    dW/dr       multiply by rel_pos/r for the gradient
+ **   lplc(r)    laplacian   (Poly6 and Viscosity only)
+ **
+ ** Poly6, Spiky and Viscosity follow Muller 2003, the cubic spline and the
+ ** Wendland kernels are written with support radius h.
+ */
+
+template<uint N>
+constexpr float ipow(float x)
+{
+	return x*ipow<N-1>(x);
+}
+
+template<>
+constexpr float ipow<0>(float)
+{
+	return 1.0f;
+}
+
+inline float kernel_clamp(float x)
+{
+	return x > 0.0f ? x : 0.0f;
+}
+
+template<uint DIM> struct Poly6Norm;
+template<> struct Poly6Norm<2> { static constexpr float value=4.0f/PI; static constexpr uint h_pow=8; };
+template<> struct Poly6Norm<3> { static constexpr float value=315.0f/(64.0f*PI); static constexpr uint h_pow=9; };
+
+template<uint DIM> struct SpikyNorm;
+template<> struct SpikyNorm<2> { static constexpr float value=-30.0f/PI; static constexpr uint h_pow=5; };
+template<> struct SpikyNorm<3> { static constexpr float value=-45.0f/PI; static constexpr uint h_pow=6; };
+
+template<uint DIM> struct ViscoNorm;
+template<> struct ViscoNorm<2> { static constexpr float value=40.0f/PI; static constexpr uint h_pow=5; static constexpr float w_div=12.0f; };
+template<> struct ViscoNorm<3> { static constexpr float value=45.0f/PI; static constexpr uint h_pow=6; static constexpr float w_div=6.0f; };
+
+template<uint DIM> struct CubicNorm;
+template<> struct CubicNorm<2> { static constexpr float value=40.0f/(7.0f*PI); };
+template<> struct CubicNorm<3> { static constexpr float value=8.0f/PI; };
+
+template<uint DIM> struct WendlandC2Norm;
+template<> struct WendlandC2Norm<2> { static constexpr float value=7.0f/PI; };
+template<> struct WendlandC2Norm<3> { static constexpr float value=21.0f/(2.0f*PI); };
+
+template<uint DIM> struct WendlandC4Norm;
+template<> struct WendlandC4Norm<2> { static constexpr float value=9.0f/PI; };
+template<> struct WendlandC4Norm<3> { static constexpr float value=495.0f/(32.0f*PI); };
+
+template<uint DIM>
+struct Poly6
+{
+	float h;
+	float h2;
+	float coef;
+	float grad_coef;
+	float lplc_coef;
+
+	Poly6() {}
+	explicit Poly6(float _h)
+	{
+		h=_h;
+		h2=h*h;
+		coef=Poly6Norm<DIM>::value/ipow<Poly6Norm<DIM>::h_pow>(h);
+		grad_coef=-6.0f*coef;
+		lplc_coef=-6.0f*coef;
+	}
+
+	inline float value(float r2) const
+	{
+		float d=kernel_clamp(h2-r2);
+		return coef*d*d*d;
+	}
+
+	inline float grad(float r) const
+	{
+		float d=kernel_clamp(h2-r*r);
+		return grad_coef*r*d*d;
+	}
+
+	inline float lplc(float r) const
+	{
+		float r2=r*r;
+		float d=kernel_clamp(h2-r2);
+		return lplc_coef*d*(DIM*h2-(DIM+4)*r2);
+	}
+};
+
+template<uint DIM>
+struct Spiky
+{
+	float h;
+	float h2;
+	float coef;
+
+	Spiky() {}
+	explicit Spiky(float _h)
+	{
+		h=_h;
+		h2=h*h;
+		coef=SpikyNorm<DIM>::value/ipow<SpikyNorm<DIM>::h_pow>(h);
+	}
+
+	inline float value(float r2) const
+	{
+		float d=kernel_clamp(h-sqrt(r2));
+		return -coef/3.0f*d*d*d;
+	}
+
+	inline float grad(float r) const
+	{
+		float d=kernel_clamp(h-r);
+		return coef*d*d;
+	}
+};
+
+template<uint DIM>
+struct Viscosity
+{
+	float h;
+	float h2;
+	float coef;
+	float w_coef;
+
+	Viscosity() {}
+	explicit Viscosity(float _h)
+	{
+		h=_h;
+		h2=h*h;
+		coef=ViscoNorm<DIM>::value/ipow<ViscoNorm<DIM>::h_pow>(h);
+		w_coef=coef*h*h*h/ViscoNorm<DIM>::w_div;
+	}
+
+	inline float value(float r2) const
+	{
+		float r=sqrt(r2);
+		if(r >= h || r < INF)
+		{
+			return 0.0f;
+		}
+		float q=r/h;
+		return w_coef*(-0.5f*q*q*q+q*q+0.5f/q-1.0f);
+	}
+
+	inline float grad(float r) const
+	{
+		if(r >= h || r < INF)
+		{
+			return 0.0f;
+		}
+		float q=r/h;
+		return w_coef/h*(-1.5f*q*q+2.0f*q-0.5f/(q*q));
+	}
+
+	inline float lplc(float r) const
+	{
+		return coef*kernel_clamp(h-r);
+	}
+};
+
+template<uint DIM>
+struct CubicSpline
+{
+	float h;
+	float h2;
+	float coef;
+	float grad_coef;
+
+	CubicSpline() {}
+	explicit CubicSpline(float _h)
+	{
+		h=_h;
+		h2=h*h;
+		coef=CubicNorm<DIM>::value/ipow<DIM>(h);
+		grad_coef=6.0f*coef/h;
+	}
+
+	inline float value(float r2) const
+	{
+		float q=sqrt(r2)/h;
+		float a=kernel_clamp(1.0f-q);
+		float b=kernel_clamp(0.5f-q);
+		return coef*2.0f*(a*a*a-4.0f*b*b*b);
+	}
+
+	inline float grad(float r) const
+	{
+		float q=r/h;
+		float a=kernel_clamp(1.0f-q);
+		float b=kernel_clamp(0.5f-q);
+		return -grad_coef*(a*a-4.0f*b*b);
+	}
+};
+
+template<uint DIM>
+struct WendlandC2
+{
+	float h;
+	float h2;
+	float coef;
+	float grad_coef;
+
+	WendlandC2() {}
+	explicit WendlandC2(float _h)
+	{
+		h=_h;
+		h2=h*h;
+		coef=WendlandC2Norm<DIM>::value/ipow<DIM>(h);
+		grad_coef=-20.0f*coef/h;
+	}
+
+	inline float value(float r2) const
+	{
+		float q=sqrt(r2)/h;
+		float a=kernel_clamp(1.0f-q);
+		float a2=a*a;
+		return coef*a2*a2*(1.0f+4.0f*q);
+	}
+
+	inline float grad(float r) const
+	{
+		float q=r/h;
+		float a=kernel_clamp(1.0f-q);
+		return grad_coef*q*a*a*a;
+	}
+};
+
+template<uint DIM>
+struct WendlandC4
+{
+	float h;
+	float h2;
+	float coef;
+	float grad_coef;
+
+	WendlandC4() {}
+	explicit WendlandC4(float _h)
+	{
+		h=_h;
+		h2=h*h;
+		coef=WendlandC4Norm<DIM>::value/ipow<DIM>(h);
+		grad_coef=-56.0f/3.0f*coef/h;
+	}
+
+	inline float value(float r2) const
+	{
+		float q=sqrt(r2)/h;
+		float a=kernel_clamp(1.0f-q);
+		float a3=a*a*a;
+		return coef*a3*a3*(1.0f+6.0f*q+35.0f/3.0f*q*q);
+	}
+
+	inline float grad(float r) const
+	{
+		float q=r/h;
+		float a=kernel_clamp(1.0f-q);
+		float a2=a*a;
+		return grad_coef*q*a2*a2*a*(1.0f+5.0f*q);
+	}
+};
+
+#endif
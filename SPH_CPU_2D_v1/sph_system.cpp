@@ -28,7 +28,6 @@ SPHSystem::SPHSystem()
 	num_particle=0;
 
 	kernel=0.04f;
-	mass=0.02f;
 
 	world_size.x=1.28f;
 	world_size.y=1.28f;
@@ -47,15 +46,16 @@ SPHSystem::SPHSystem()
 	surf_norm=6.0f;
 	surf_coe=0.2f;
 
-	poly6_value=315.0f/(64.0f * PI * pow(kernel, 9));;
-	spiky_value=-45.0f/(PI * pow(kernel, 6));
-	visco_value=45.0f/(PI * pow(kernel, 6));
+	w_dens=DensKernel(kernel);
+	w_pres=PresKernel(kernel);
+	w_visc=ViscKernel(kernel);
 
-	grad_poly6=-945/(32 * PI * pow(kernel, 9));
-	lplc_poly6=-945/(8 * PI * pow(kernel, 9));
+	grad_poly6=-24.0f/(PI * ipow<8>(kernel));
+	lplc_poly6=-96.0f/(PI * ipow<8>(kernel));
 
 	kernel_2=kernel*kernel;
-	self_dens=mass*poly6_value*pow(kernel, 6);
+	mass=rest_density/lattice_sum(kernel*0.45f);
+	self_dens=mass*w_dens.value(0.0f);
 	self_lplc_color=lplc_poly6*mass*kernel_2*(0-3/4*kernel_2);
 
 	mem=(Particle *)malloc(sizeof(Particle)*max_particle);
@@ -70,12 +70,34 @@ SPHSystem::SPHSystem()
 	printf("Grid Width : %u\n", grid_size.x);
 	printf("Grid Height: %u\n", grid_size.y);
 	printf("Total Cell : %u\n", tot_cell);
-	printf("Poly6 Kernel: %f\n", poly6_value);
-	printf("Spiky Kernel: %f\n", spiky_value);
-	printf("Visco Kernel: %f\n", visco_value);
+	printf("Poly6 Kernel: %f\n", w_dens.coef);
+	printf("Spiky Kernel: %f\n", w_pres.coef);
+	printf("Visco Kernel: %f\n", w_visc.coef);
+	printf("Mass: %f\n", mass);
 	printf("Self Density: %f\n", self_dens);
 }
 
+/** The kernels are the 2D ones of sph_kernel.h, so a mass tuned for the 3D
+ ** normalisation no longer fits. The mass is chosen instead so that the
+ ** lattice init_system() drops starts at rest_density. */
+float SPHSystem::lattice_sum(float spacing)
+{
+	int range=(int)ceil(kernel/spacing);
+	float sum=0.0f;
+	float r2;
+
+	for(int x=-range; x<=range; x++)
+	{
+		for(int y=-range; y<=range; y++)
+		{
+			r2=(x*x+y*y)*spacing*spacing;
+			sum+=w_dens.value(r2);
+		}
+	}
+
+	return sum;
+}
+
 SPHSystem::~SPHSystem()
 {
 	free(mem);
@@ -210,7 +232,7 @@ void SPHSystem::comp_dens_pres()
 						continue;
 					}
 
-					p->dens=p->dens + mass * poly6_value * pow(kernel_2-r2, 3);
+					p->dens=p->dens + mass * w_dens.value(r2);
 
 					np=np->next;
 				}
@@ -218,7 +240,7 @@ void SPHSystem::comp_dens_pres()
 		}
 
 		p->dens=p->dens+self_dens;
-		p->pres=(pow(p->dens / rest_density, 7) - 1) *gas_constant;
+		p->pres=(ipow<7>(p->dens / rest_density) - 1) *gas_constant;
 	}
 }
 
@@ -236,7 +258,6 @@ void SPHSystem::comp_force_adv()
 
 	float r2;
 	float r;
-	float kernel_r;
 	float V;
 
 	float pres_kernel;
@@ -282,9 +303,8 @@ void SPHSystem::comp_force_adv()
 					{
 						r=sqrt(r2);
 						V=mass/np->dens/2;
-						kernel_r=kernel-r;
 
-						pres_kernel=spiky_value * kernel_r * kernel_r;
+						pres_kernel=w_pres.grad(r);
 						temp_force=V * (p->pres+np->pres) * pres_kernel;
 						p->acc.x=p->acc.x-rel_pos.x*temp_force/r;
 						p->acc.y=p->acc.y-rel_pos.y*temp_force/r;
@@ -292,12 +312,12 @@ void SPHSystem::comp_force_adv()
 						rel_vel.x=np->ev.x-p->ev.x;
 						rel_vel.y=np->ev.y-p->ev.y;
 
-						visc_kernel=visco_value*(kernel-r);
+						visc_kernel=w_visc.lplc(r);
 						temp_force=V * viscosity * visc_kernel;
 						p->acc.x=p->acc.x + rel_vel.x*temp_force; 
 						p->acc.y=p->acc.y + rel_vel.y*temp_force; 
 
-						float temp=(-1) * grad_poly6 * V * pow(kernel_2-r2, 2);
+						float temp=(-1) * grad_poly6 * V * (kernel_2-r2) * (kernel_2-r2);
 						grad_color.x += temp * rel_pos.x;
 						grad_color.y += temp * rel_pos.y;
 						lplc_color += lplc_poly6 * V * (kernel_2-r2) * (r2-3/4*(kernel_2-r2));
@@ -23,6 +23,11 @@
 #define __SPHSYSTEM_H__
 
 #include "sph_type.h"
+#include "sph_kernel.h"
+
+typedef Poly6<2> DensKernel;
+typedef Spiky<2> PresKernel;
+typedef Viscosity<2> ViscKernel;
 
 class Particle
 {
@@ -64,9 +69,9 @@ public:
 	float surf_norm;
 	float surf_coe;
 
-	float poly6_value;
-	float spiky_value;
-	float visco_value;
+	DensKernel w_dens;
+	PresKernel w_pres;
+	ViscKernel w_visc;
 
 	float grad_poly6;
 	float lplc_poly6;
@@ -88,6 +93,7 @@ public:
 	void add_particle(float2 pos, float2 vel);
 
 private:
+	float lattice_sum(float spacing);
 	void build_table();
 	void comp_dens_pres();
 	void comp_force_adv();
@@ -120,6 +120,7 @@ int main(int argc, char** argv)
 				glUniform1i(glGetUniformLocation(programSphDensPres, "gridWidth"), sph.gridSize.x);
 				glUniform1i(glGetUniformLocation(programSphDensPres, "gridHeight"), sph.gridSize.y);
 				glUniform1f(glGetUniformLocation(programSphDensPres, "kernel"), sph.kernel);
+				glUniform1f(glGetUniformLocation(programSphDensPres, "poly6Value"), sph.poly6Value);
 				glUniform1f(glGetUniformLocation(programSphDensPres, "mass"), sph.mass);
 				glUniform1f(glGetUniformLocation(programSphDensPres, "restDensity"), sph.restDensity);
 				glUniform1f(glGetUniformLocation(programSphDensPres, "stiffness"), sph.stiffness);
@@ -132,6 +133,8 @@ int main(int argc, char** argv)
 				glUniform1i(glGetUniformLocation(programSphAcc, "gridWidth"), sph.gridSize.x);
 				glUniform1i(glGetUniformLocation(programSphAcc, "gridHeight"), sph.gridSize.y);
 				glUniform1f(glGetUniformLocation(programSphAcc, "kernel"), sph.kernel);
+				glUniform1f(glGetUniformLocation(programSphAcc, "spikyValue"), sph.spikyValue);
+				glUniform1f(glGetUniformLocation(programSphAcc, "viscoValue"), sph.viscoValue);
 				glUniform1f(glGetUniformLocation(programSphAcc, "mass"), sph.mass);
 				glUniform1f(glGetUniformLocation(programSphAcc, "viscosity"), sph.viscosity);
 				glUniform2fv(glGetUniformLocation(programSphAcc, "gravity"), 1, value_ptr(sph.gravity));
@@ -33,6 +33,12 @@ SPHSystem::SPHSystem()
 	gridSize.y = int(worldSize.y / cellSize);
 	totCell = unsigned(gridSize.x) * unsigned(gridSize.y);
 
+	// kernel coefficients, evaluated once instead of per pair in the shaders
+	auto const pi{3.141592f};
+	poly6Value = 315.0f / (64.0f * pi * std::pow(kernel, 9.0f));
+	spikyValue = -45.0f / (pi * std::pow(kernel, 6.0f));
+	viscoValue = 45.0f / (pi * std::pow(kernel, 6.0f));
+
 	//params
 	gravity.x = 0.0f;
 	gravity.y = -9.8f;
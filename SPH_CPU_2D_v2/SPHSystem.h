@@ -69,6 +69,10 @@ struct SPHSystem
 	ivec2 gridSize;
 	float kernel;
 
+	float poly6Value;
+	float spikyValue;
+	float viscoValue;
+
 	float mass;
 	float restDensity;
 	float stiffness;
@@ -29,6 +29,7 @@ uniform float cellSize;
 uniform int gridWidth;
 uniform int gridHeight;
 uniform float kernel;
+uniform float poly6Value;
 
 uniform float mass;
 uniform float restDensity;
@@ -36,7 +37,7 @@ uniform float stiffness;
 
 ivec2 calcCellPos(vec2 pos) { return ivec2(int(pos.x / cellSize), int(pos.y / cellSize)); }
 int calcCellHash(ivec2 pos) { return (pos.x < 0 || pos.x >= gridWidth || pos.y < 0 || pos.y >= gridHeight) ? -1 : pos.y * gridWidth + pos.x; }
-float poly6(float r2) { return 315.0 / (64.0 * PI * pow(kernel, 9.0)) * pow(kernel * kernel - r2, 3.0); }
+float poly6(float r2) { float d = kernel * kernel - r2; return poly6Value * d * d * d; }
 
 void main() {
   Particle p = particles[gl_VertexID];
@@ -29,6 +29,8 @@ uniform float cellSize;
 uniform int gridWidth;
 uniform int gridHeight;
 uniform float kernel;
+uniform float spikyValue;
+uniform float viscoValue;
 
 uniform float mass;
 uniform float viscosity;
@@ -36,8 +38,8 @@ uniform vec2 gravity;
 
 ivec2 calcCellPos(vec2 pos) { return ivec2(int(pos.x / cellSize), int(pos.y / cellSize)); }
 int calcCellHash(ivec2 pos) { return (pos.x < 0 || pos.x >= gridWidth || pos.y < 0 || pos.y >= gridHeight) ? -1 : pos.y * gridWidth + pos.x; }
-float spiky(float r) { return -45.0 / (PI * pow(kernel, 6.0)) * (kernel - r) * (kernel - r); }
-float visco(float r) { return 45.0 / (PI * pow(kernel, 6.0)) * (kernel - r); }
+float spiky(float r) { return spikyValue * (kernel - r) * (kernel - r); }
+float visco(float r) { return viscoValue * (kernel - r); }
 
 void main() {
   Particle p = particles[gl_VertexID];
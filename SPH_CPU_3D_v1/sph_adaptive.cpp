@@ -0,0 +1,676 @@
+/** File:		sph_adaptive.cpp
+ ** Author:		Dongli Zhang
+ ** Contact:	dongli.zhang0129@gmail.com
+ **
+ ** Copyright (C) Dongli Zhang 2013
+ **
+ ** This program is free software;  you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+ ** the GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program;  if not, write to the Free Software
+ ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "sph_system.h"
+#include "sph_header.h"
+#include <string.h>
+
+/** Adaptive particle resolution for the WCSPH path.
+ **
+ ** Particles carry their own mass and support radius. Two neighbors of the
+ ** same res_level merge into one of twice the mass and a support radius
+ ** 2^(1/3) larger, at their center of mass and with their momentum; a
+ ** merged particle splits back into two along one axis. Every kernel is
+ ** the fixed-radius one scaled to the pair radius (h_i+h_j)/2, with the
+ ** factor s of each pair of levels kept in adapt_scale and the squared
+ ** radius in adapt_range:
+ **
+ **   W_h(r)=s^3 W(r s), dW_h/dr=s^4 W'(r s), lplc W_h(r)=s^5 lplc W(r s), s=kernel/h
+ **
+ ** The pressure, viscosity and color field terms are those of
+ ** comp_force_adv(), so a particle at res_level 0 sees the usual forces.
+ ** The mean radius spreads the mass of a coarse particle over its own
+ ** support; with min(h_i, h_j) a fine particle next to it sees a point mass
+ ** and its pressure spikes. A particle searches the cells overlapping the
+ ** box around its largest pair radius, never more than one period of a
+ ** periodic axis.
+ **
+ ** The target level comes from cell_depth, the distance in cells to the
+ ** nearest surface cell, a filled cell next to an air cell or within a cell
+ ** of an obstacle. Air is an empty cell with another empty cell next to it,
+ ** so the odd empty cell between coarse particles does not count; the color
+ ** field is not used since it is not zero across a change of resolution.
+ ** Within adapt_depth cells everything is at full resolution, one level is
+ ** allowed per cell beyond that up to adapt_max_level. Above level 2 the
+ ** coarse spacing reaches the cell size and interior cells start to look
+ ** empty.
+ **
+ ** Particles merge below the target and split one level above it, so the
+ ** interface does not flicker. A particle only tries to merge every
+ ** adapt_interval steps, staggered by id, and neither merges nor splits
+ ** within adapt_interval steps of its last change, so the pressure
+ ** disturbance of a change settles before the next one.
+ **
+ ** Merges fill their holes from the end of mem and splits append, which
+ ** scatters the neighbors of a cell over memory. mem doubles when a split
+ ** finds it full. Every adapt_interval steps adapt_sort() puts mem back in
+ ** cell order. Indices into mem therefore only hold for one step; id stays
+ ** with the particle.
+ **
+ ** This does not reach the 3-5x fewer particles that was asked for: the
+ ** deep tank of sph_bench_solver adapt settles at about 1.85x. Two levels
+ ** are the most that work on this grid (see above), which caps the gain at
+ ** 4x for fluid far from any surface. The tank is only about ten cells
+ ** deep, adapt_depth keeps the top two at full resolution, the next one is
+ ** level 1 and the hysteresis holds particles a level finer than their
+ ** target, so the interior that reaches level 2 is a thin slab. A deeper
+ ** domain or a level 3 on a grid finer than the kernel would be needed.
+ **
+ ** The boundary particles of sph_boundary.cpp are not used here, walls and
+ ** obstacles are only the clamps in bound_particle(); bound_part is ignored
+ ** with adaptive_res on.
+ */
+
+void SPHSystem::adapt_step()
+{
+	adapt_depth_field();
+	adapt_merge();
+	adapt_split();
+	if(tot_step%adapt_interval == 0)
+	{
+		adapt_sort();
+	}
+	build_table();
+
+	adapt_dens_pres();
+	adapt_force();
+	advection();
+
+	num_coarse=0;
+	for(uint i=0; i<num_particle; i++)
+	{
+		num_coarse+=mem[i].res_level > 0;
+	}
+
+	tot_force_eval+=num_particle;
+}
+
+void SPHSystem::adapt_refine()
+{
+	uint count;
+
+	while(num_coarse > 0)
+	{
+		count=num_particle;
+		num_coarse=0;
+
+		for(uint i=0; i<count; i++)
+		{
+			if(num_particle == max_particle)
+			{
+				reserve_particle(max_particle*2);
+			}
+
+			if(mem[i].res_level > 0)
+			{
+				adapt_halve(&(mem[i]));
+				num_coarse+=mem[i].res_level > 0;
+			}
+		}
+	}
+}
+
+uint SPHSystem::adapt_target(float3 pos)
+{
+	uint depth=cell_depth[calc_cell_hash(calc_cell_pos(pos))];
+
+	if(depth <= adapt_depth)
+	{
+		return 0;
+	}
+
+	uint max_level=adapt_max_level < MAX_RES_LEVEL ? adapt_max_level : MAX_RES_LEVEL;
+
+	return depth-adapt_depth < max_level ? depth-adapt_depth : max_level;
+}
+
+static const int face[6][3]={{-1, 0, 0}, {1, 0, 0}, {0, -1, 0}, {0, 1, 0}, {0, 0, -1}, {0, 0, 1}};
+
+uint SPHSystem::adapt_air(int3 cell_pos)
+{
+	int3 near_pos;
+	uint hash;
+
+	if(cell[calc_cell_hash(cell_pos)] != NULL)
+	{
+		return 0;
+	}
+
+	for(uint f=0; f<6; f++)
+	{
+		near_pos.x=cell_pos.x+face[f][0];
+		near_pos.y=cell_pos.y+face[f][1];
+		near_pos.z=cell_pos.z+face[f][2];
+		hash=calc_cell_hash(near_pos);
+
+		if(hash != 0xffffffff && cell[hash] == NULL)
+		{
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+void SPHSystem::adapt_depth_field()
+{
+	int3 cell_pos;
+	int3 near_pos;
+	uint hash;
+	uint max_depth=adapt_depth+adapt_max_level;
+
+	float3 center;
+
+	for(uint i=0; i<tot_cell; i++)
+	{
+		cell_depth[i]=max_depth;
+
+		if(cell[i] == NULL)
+		{
+			continue;
+		}
+
+		cell_pos=calc_cell_pos(cell[i]->pos);
+
+		if(num_obstacle > 0)
+		{
+			center.x=(cell_pos.x+0.5f)*cell_size;
+			center.y=(cell_pos.y+0.5f)*cell_size;
+			center.z=(cell_pos.z+0.5f)*cell_size;
+
+			if(obstacle_dist(center) < cell_size)
+			{
+				cell_depth[i]=0;
+				continue;
+			}
+		}
+
+		for(uint f=0; f<6; f++)
+		{
+			near_pos.x=cell_pos.x+face[f][0];
+			near_pos.y=cell_pos.y+face[f][1];
+			near_pos.z=cell_pos.z+face[f][2];
+			hash=calc_cell_hash(near_pos);
+
+			if(hash != 0xffffffff && adapt_air(near_pos))
+			{
+				cell_depth[i]=0;
+				break;
+			}
+		}
+	}
+
+	for(uint d=1; d<max_depth; d++)
+	{
+		for(uint i=0; i<tot_cell; i++)
+		{
+			if(cell_depth[i] != d-1)
+			{
+				continue;
+			}
+
+			cell_pos.x=i%grid_size.x;
+			cell_pos.y=(i/grid_size.x)%grid_size.y;
+			cell_pos.z=i/(grid_size.x*grid_size.y);
+
+			for(int x=-1; x<=1; x++)
+			{
+				for(int y=-1; y<=1; y++)
+				{
+					for(int z=-1; z<=1; z++)
+					{
+						near_pos.x=cell_pos.x+x;
+						near_pos.y=cell_pos.y+y;
+						near_pos.z=cell_pos.z+z;
+						hash=calc_cell_hash(near_pos);
+
+						if(hash != 0xffffffff && cell_depth[hash] > d)
+						{
+							cell_depth[hash]=d;
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+void SPHSystem::adapt_merge()
+{
+	Particle *p;
+	Particle *np;
+	Particle *near;
+
+	int3 cell_pos;
+	int3 near_pos;
+	uint hash;
+
+	float3 rel_pos;
+	float r2;
+	float near_r2;
+	float m;
+
+	for(uint i=0; i<num_particle; i++)
+	{
+		p=&(mem[i]);
+
+		if(p->mass == 0.0f || (p->id+tot_step)%adapt_interval != 0 || tot_step-p->res_step < adapt_interval)
+		{
+			continue;
+		}
+
+		if(p->res_level >= adapt_target(p->pos) || p->dens < 0.9f*lattice_density)
+		{
+			continue;
+		}
+
+		near=NULL;
+		near_r2=p->kernel*p->kernel;
+		cell_pos=calc_cell_pos(p->pos);
+
+		for(int x=-1; x<=1; x++)
+		{
+			for(int y=-1; y<=1; y++)
+			{
+				for(int z=-1; z<=1; z++)
+				{
+					near_pos.x=cell_pos.x+x;
+					near_pos.y=cell_pos.y+y;
+					near_pos.z=cell_pos.z+z;
+					hash=calc_cell_hash(near_pos);
+
+					if(hash == 0xffffffff)
+					{
+						continue;
+					}
+
+					for(np=cell[hash]; np != NULL; np=np->next)
+					{
+						if(np == p || np->mass == 0.0f || tot_step-np->res_step < adapt_interval || np->res_level != p->res_level)
+						{
+							continue;
+						}
+
+						rel_pos.x=np->pos.x-p->pos.x;
+						rel_pos.y=np->pos.y-p->pos.y;
+						rel_pos.z=np->pos.z-p->pos.z;
+						wrap_rel(rel_pos);
+						r2=rel_pos.x*rel_pos.x+rel_pos.y*rel_pos.y+rel_pos.z*rel_pos.z;
+
+						if(r2 < near_r2 && np->res_level < adapt_target(np->pos))
+						{
+							near_r2=r2;
+							near=np;
+						}
+					}
+				}
+			}
+		}
+
+		if(near == NULL)
+		{
+			continue;
+		}
+
+		m=p->mass+near->mass;
+
+		p->pos.x=(p->pos.x*p->mass+near->pos.x*near->mass)/m;
+		p->pos.y=(p->pos.y*p->mass+near->pos.y*near->mass)/m;
+		p->pos.z=(p->pos.z*p->mass+near->pos.z*near->mass)/m;
+		p->vel.x=(p->vel.x*p->mass+near->vel.x*near->mass)/m;
+		p->vel.y=(p->vel.y*p->mass+near->vel.y*near->mass)/m;
+		p->vel.z=(p->vel.z*p->mass+near->vel.z*near->mass)/m;
+		p->ev.x=(p->ev.x*p->mass+near->ev.x*near->mass)/m;
+		p->ev.y=(p->ev.y*p->mass+near->ev.y*near->mass)/m;
+		p->ev.z=(p->ev.z*p->mass+near->ev.z*near->mass)/m;
+
+		p->mass=m;
+		p->kernel=p->kernel*adapt_h_ratio;
+		p->res_level++;
+		p->res_step=tot_step;
+
+		near->mass=0.0f;
+	}
+
+	for(uint i=0; i<num_particle; )
+	{
+		if(mem[i].mass == 0.0f)
+		{
+			num_particle--;
+			mem[i]=mem[num_particle];
+		}
+		else
+		{
+			i++;
+		}
+	}
+}
+
+void SPHSystem::adapt_split()
+{
+	Particle *p;
+	uint target;
+	uint count=num_particle;
+
+	for(uint i=0; i<count; i++)
+	{
+		if(num_particle == max_particle)
+		{
+			reserve_particle(max_particle*2);
+		}
+		p=&(mem[i]);
+
+		if(p->res_level == 0 || tot_step-p->res_step < adapt_interval)
+		{
+			continue;
+		}
+
+		target=adapt_target(p->pos);
+		if(p->res_level <= target+(target > 0 ? 1 : 0))
+		{
+			continue;
+		}
+
+		adapt_halve(p);
+	}
+}
+
+void SPHSystem::adapt_halve(Particle *p)
+{
+	Particle *np=&(mem[num_particle]);
+	float offset;
+
+	p->mass=p->mass*0.5f;
+	p->kernel=p->kernel/adapt_h_ratio;
+	p->res_level--;
+	p->res_step=tot_step;
+
+	*np=*p;
+	np->id=next_id;
+	next_id++;
+	np->next=NULL;
+
+	offset=p->kernel*0.25f;
+	switch(p->id%3)
+	{
+	case 0:
+		p->pos.x-=offset;
+		np->pos.x+=offset;
+		break;
+	case 1:
+		p->pos.y-=offset;
+		np->pos.y+=offset;
+		break;
+	default:
+		p->pos.z-=offset;
+		np->pos.z+=offset;
+		break;
+	}
+
+	clamp_pos(p->pos);
+	clamp_pos(np->pos);
+
+	num_particle++;
+}
+
+void SPHSystem::adapt_sort()
+{
+	uint *start=(uint *)calloc(tot_cell+2, sizeof(uint));
+	Particle *sorted=(Particle *)malloc(sizeof(Particle)*num_particle);
+	uint hash;
+
+	for(uint i=0; i<num_particle; i++)
+	{
+		hash=calc_cell_hash(calc_cell_pos(mem[i].pos));
+		start[(hash == 0xffffffff ? tot_cell : hash)+1]++;
+	}
+
+	for(uint i=0; i<=tot_cell; i++)
+	{
+		start[i+1]+=start[i];
+	}
+
+	for(uint i=0; i<num_particle; i++)
+	{
+		hash=calc_cell_hash(calc_cell_pos(mem[i].pos));
+		sorted[start[hash == 0xffffffff ? tot_cell : hash]++]=mem[i];
+	}
+
+	memcpy(mem, sorted, sizeof(Particle)*num_particle);
+
+	free(sorted);
+	free(start);
+}
+
+void SPHSystem::adapt_span(int3 &min_pos, int3 &max_pos)
+{
+	if(periodic.x && max_pos.x-min_pos.x >= (int)grid_size.x)
+	{
+		max_pos.x=min_pos.x+grid_size.x-1;
+	}
+
+	if(periodic.y && max_pos.y-min_pos.y >= (int)grid_size.y)
+	{
+		max_pos.y=min_pos.y+grid_size.y-1;
+	}
+
+	if(periodic.z && max_pos.z-min_pos.z >= (int)grid_size.z)
+	{
+		max_pos.z=min_pos.z+grid_size.z-1;
+	}
+}
+
+void SPHSystem::adapt_dens_pres()
+{
+	Particle *p;
+	Particle *np;
+
+	int3 min_pos;
+	int3 max_pos;
+	int3 near_pos;
+	uint hash;
+
+	float3 corner;
+	float reach;
+	uint top=adapt_max_level < MAX_RES_LEVEL ? adapt_max_level : MAX_RES_LEVEL;
+	float3 rel_pos;
+	float r2;
+	float s;
+
+	prof.begin(PHASE_DENS);
+
+	for(uint i=0; i<num_particle; i++)
+	{
+		p=&(mem[i]);
+		reach=sqrt(adapt_range[p->res_level][top]);
+		corner.x=p->pos.x-reach;
+		corner.y=p->pos.y-reach;
+		corner.z=p->pos.z-reach;
+		min_pos=calc_cell_pos(corner);
+		corner.x=p->pos.x+reach;
+		corner.y=p->pos.y+reach;
+		corner.z=p->pos.z+reach;
+		max_pos=calc_cell_pos(corner);
+		adapt_span(min_pos, max_pos);
+
+		s=adapt_scale[p->res_level][p->res_level];
+		p->dens=p->mass*s*s*s*w_dens.value(0.0f);
+
+		for(near_pos.x=min_pos.x; near_pos.x<=max_pos.x; near_pos.x++)
+		{
+			for(near_pos.y=min_pos.y; near_pos.y<=max_pos.y; near_pos.y++)
+			{
+				for(near_pos.z=min_pos.z; near_pos.z<=max_pos.z; near_pos.z++)
+				{
+					hash=calc_cell_hash(near_pos);
+
+					if(hash == 0xffffffff)
+					{
+						continue;
+					}
+
+					for(np=cell[hash]; np != NULL; np=np->next)
+					{
+						rel_pos.x=np->pos.x-p->pos.x;
+						rel_pos.y=np->pos.y-p->pos.y;
+						rel_pos.z=np->pos.z-p->pos.z;
+						wrap_rel(rel_pos);
+						r2=rel_pos.x*rel_pos.x+rel_pos.y*rel_pos.y+rel_pos.z*rel_pos.z;
+
+						if(r2 < INF || r2 >= adapt_range[p->res_level][np->res_level])
+						{
+							continue;
+						}
+
+						s=adapt_scale[p->res_level][np->res_level];
+
+						p->dens=p->dens+np->mass*s*s*s*w_dens.value(r2*s*s);
+					}
+				}
+			}
+		}
+
+		p->pres=(ipow<7>(p->dens / rest_density) - 1) *gas_constant;
+	}
+
+	prof.end(PHASE_DENS);
+}
+
+void SPHSystem::adapt_force()
+{
+	Particle *p;
+	Particle *np;
+
+	int3 min_pos;
+	int3 max_pos;
+	int3 near_pos;
+	uint hash;
+
+	float3 corner;
+	float reach;
+	uint top=adapt_max_level < MAX_RES_LEVEL ? adapt_max_level : MAX_RES_LEVEL;
+	float3 rel_pos;
+	float3 rel_vel;
+
+	float r2;
+	float r;
+	float s;
+	float s4;
+	float V;
+	float temp_force;
+
+	float3 grad_color;
+	float lplc_color;
+
+	prof.begin(PHASE_FORCE);
+
+	for(uint i=0; i<num_particle; i++)
+	{
+		p=&(mem[i]);
+		reach=sqrt(adapt_range[p->res_level][top]);
+		corner.x=p->pos.x-reach;
+		corner.y=p->pos.y-reach;
+		corner.z=p->pos.z-reach;
+		min_pos=calc_cell_pos(corner);
+		corner.x=p->pos.x+reach;
+		corner.y=p->pos.y+reach;
+		corner.z=p->pos.z+reach;
+		max_pos=calc_cell_pos(corner);
+		adapt_span(min_pos, max_pos);
+
+		p->acc.x=0.0f;
+		p->acc.y=0.0f;
+		p->acc.z=0.0f;
+
+		grad_color.x=0.0f;
+		grad_color.y=0.0f;
+		grad_color.z=0.0f;
+		lplc_color=0.0f;
+
+		for(near_pos.x=min_pos.x; near_pos.x<=max_pos.x; near_pos.x++)
+		{
+			for(near_pos.y=min_pos.y; near_pos.y<=max_pos.y; near_pos.y++)
+			{
+				for(near_pos.z=min_pos.z; near_pos.z<=max_pos.z; near_pos.z++)
+				{
+					hash=calc_cell_hash(near_pos);
+
+					if(hash == 0xffffffff)
+					{
+						continue;
+					}
+
+					for(np=cell[hash]; np != NULL; np=np->next)
+					{
+						rel_pos.x=p->pos.x-np->pos.x;
+						rel_pos.y=p->pos.y-np->pos.y;
+						rel_pos.z=p->pos.z-np->pos.z;
+						wrap_rel(rel_pos);
+						r2=rel_pos.x*rel_pos.x+rel_pos.y*rel_pos.y+rel_pos.z*rel_pos.z;
+
+						if(r2 >= adapt_range[p->res_level][np->res_level] || r2 <= INF)
+						{
+							continue;
+						}
+
+						s=adapt_scale[p->res_level][np->res_level];
+
+						r=sqrt(r2);
+						s4=s*s*s*s;
+						V=np->mass/np->dens/2;
+
+						temp_force=V*(p->pres+np->pres)*s4*w_pres.grad(r*s);
+						p->acc.x=p->acc.x-rel_pos.x*temp_force/r;
+						p->acc.y=p->acc.y-rel_pos.y*temp_force/r;
+						p->acc.z=p->acc.z-rel_pos.z*temp_force/r;
+
+						rel_vel.x=np->ev.x-p->ev.x;
+						rel_vel.y=np->ev.y-p->ev.y;
+						rel_vel.z=np->ev.z-p->ev.z;
+
+						temp_force=V*viscosity*s4*s*w_visc.lplc(r*s);
+						p->acc.x=p->acc.x+rel_vel.x*temp_force;
+						p->acc.y=p->acc.y+rel_vel.y*temp_force;
+						p->acc.z=p->acc.z+rel_vel.z*temp_force;
+
+						temp_force=V*s4*w_dens.grad(r*s)/r;
+						grad_color.x-=temp_force*rel_pos.x;
+						grad_color.y-=temp_force*rel_pos.y;
+						grad_color.z-=temp_force*rel_pos.z;
+						r2=r2*s*s;
+						lplc_color+=lplc_poly6*V*s4*s*(kernel_2-r2)*r2;
+					}
+				}
+			}
+		}
+
+		p->surf_norm=sqrt(grad_color.x*grad_color.x+grad_color.y*grad_color.y+grad_color.z*grad_color.z);
+
+		if(p->surf_norm > surf_norm)
+		{
+			p->acc.x+=surf_coe * lplc_color * grad_color.x / p->surf_norm;
+			p->acc.y+=surf_coe * lplc_color * grad_color.y / p->surf_norm;
+			p->acc.z+=surf_coe * lplc_color * grad_color.z / p->surf_norm;
+		}
+	}
+
+	prof.end(PHASE_FORCE);
+}
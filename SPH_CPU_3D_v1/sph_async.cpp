@@ -0,0 +1,295 @@
+/** File:		sph_async.cpp
+ ** Author:		Dongli Zhang
+ ** Contact:	dongli.zhang0129@gmail.com
+ **
+ ** Copyright (C) Dongli Zhang 2013
+ **
+ ** This program is free software;  you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+ ** the GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program;  if not, write to the Free Software
+ ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "sph_async.h"
+#include "sph_system.h"
+#include "sph_header.h"
+#include <string.h>
+#include <chrono>
+
+/** Frame output on a writer thread.
+ **
+ ** submit() only quantizes the particles into a free FrameBuffer, which is
+ ** about as much work as copying them, and queues it. The writer thread
+ ** range codes and writes the frames in order. FrameWriter::encode() swaps
+ ** the buffer with the frame it keeps for prediction, and the old one goes
+ ** back to the free list, so there are queue_size+1 buffers and nothing is
+ ** allocated or copied after the first frames.
+ **
+ ** When queue_size frames are waiting the policy decides: QUEUE_BLOCK waits
+ ** for the writer, QUEUE_DROP skips the new frame and QUEUE_COALESCE puts
+ ** it in place of the newest waiting one. Either way the file stays valid,
+ ** the next frame is just coded against the last one written.
+ **
+ ** depth, the latency from submit() until the frame is written and the
+ ** time submit() spent blocked are kept as it goes, read through
+ ** get_stats() while running and printed by close().
+ ** With trace_enabled the wait, the quantize and every encode also go on
+ ** the timeline, the encodes on the writer thread.
+ */
+
+static double async_now()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+AsyncWriter::AsyncWriter()
+{
+	policy=QUEUE_BLOCK;
+	queue_size=4;
+
+	depth=0;
+	memset(&stats, 0, sizeof(stats));
+
+	slot=NULL;
+	submit_time=NULL;
+	ring=NULL;
+	free_slot=NULL;
+	head=0;
+	num_free=0;
+	running=0;
+	failed=0;
+}
+
+AsyncWriter::~AsyncWriter()
+{
+	close();
+}
+
+uint AsyncWriter::open(const char *file, float3 world_size, float kernel, float mass)
+{
+	uint num_slot;
+
+	close();
+
+	if(writer.open(file, world_size, kernel, mass) == 0)
+	{
+		return 0;
+	}
+
+	queue_size=queue_size > 0 ? queue_size : 1;
+	num_slot=queue_size+1;
+
+	slot=(FrameBuffer *)malloc(sizeof(FrameBuffer)*num_slot);
+	submit_time=(double *)malloc(sizeof(double)*num_slot);
+	ring=(uint *)malloc(sizeof(uint)*queue_size);
+	free_slot=(uint *)malloc(sizeof(uint)*num_slot);
+	memset(slot, 0, sizeof(FrameBuffer)*num_slot);
+
+	for(uint i=0; i<num_slot; i++)
+	{
+		free_slot[i]=i;
+	}
+	num_free=num_slot;
+	head=0;
+
+	depth=0;
+	memset(&stats, 0, sizeof(stats));
+	failed=0;
+
+	running=1;
+	thread=std::thread(&AsyncWriter::write_loop, this);
+
+	return 1;
+}
+
+uint AsyncWriter::submit(const Particle *mem, const uint *index, uint num_particle, float time)
+{
+	std::unique_lock<std::mutex> guard(lock);
+	double start;
+	double wait;
+	uint s;
+
+	if(running == 0 || failed)
+	{
+		return 0;
+	}
+
+	stats.submitted++;
+	if(depth == queue_size || num_free == 0)
+	{
+		if(policy == QUEUE_DROP)
+		{
+			stats.dropped++;
+			return 0;
+		}
+
+		if(policy == QUEUE_COALESCE && depth > 0)
+		{
+			depth--;
+			s=ring[(head+depth)%queue_size];
+			stats.coalesced++;
+		}
+		else
+		{
+			start=async_now();
+			while((depth == queue_size || num_free == 0) && failed == 0)
+			{
+				not_full.wait(guard);
+			}
+			wait=async_now()-start;
+			stats.block_time+=wait;
+			if(trace_enabled.load(std::memory_order_relaxed))
+			{
+				trace_event("queue wait", start, wait);
+			}
+
+			if(failed)
+			{
+				return 0;
+			}
+			s=free_slot[--num_free];
+		}
+	}
+	else
+	{
+		s=free_slot[--num_free];
+	}
+	guard.unlock();
+
+	start=async_now();
+	writer.quantize(mem, index, num_particle, time, &(slot[s]));
+	submit_time[s]=async_now();
+	if(trace_enabled.load(std::memory_order_relaxed))
+	{
+		trace_event("quantize", start, submit_time[s]-start);
+	}
+
+	guard.lock();
+	ring[(head+depth)%queue_size]=s;
+	depth++;
+	stats.max_depth=depth > stats.max_depth ? depth : stats.max_depth;
+	guard.unlock();
+
+	not_empty.notify_one();
+
+	return 1;
+}
+
+void AsyncWriter::write_loop()
+{
+	std::unique_lock<std::mutex> guard(lock);
+	double start;
+	double end;
+	double latency;
+	uint s;
+	uint ok;
+
+	if(trace_enabled.load(std::memory_order_relaxed))
+	{
+		trace_thread("writer");
+	}
+
+	while(1)
+	{
+		while(depth == 0 && running)
+		{
+			not_empty.wait(guard);
+		}
+
+		if(depth == 0)
+		{
+			break;
+		}
+
+		s=ring[head];
+		head=(head+1)%queue_size;
+		depth--;
+		guard.unlock();
+
+		start=async_now();
+		ok=writer.encode(&(slot[s]));
+		end=async_now();
+		if(trace_enabled.load(std::memory_order_relaxed))
+		{
+			trace_event("encode", start, end-start);
+		}
+
+		guard.lock();
+		failed=failed || ok == 0;
+		stats.written+=ok;
+		stats.sum_write+=end-start;
+		latency=end-submit_time[s];
+		stats.sum_latency+=latency;
+		stats.max_latency=latency > stats.max_latency ? latency : stats.max_latency;
+		free_slot[num_free++]=s;
+
+		not_full.notify_one();
+	}
+}
+
+uint AsyncWriter::close()
+{
+	uint ok;
+
+	if(running == 0)
+	{
+		return 0;
+	}
+
+	lock.lock();
+	running=0;
+	lock.unlock();
+	not_empty.notify_one();
+	thread.join();
+
+	ok=writer.close() && failed == 0;
+	print_stats();
+
+	for(uint i=0; i<=queue_size; i++)
+	{
+		free(slot[i].value);
+	}
+	free(slot);
+	free(submit_time);
+	free(ring);
+	free(free_slot);
+
+	slot=NULL;
+	submit_time=NULL;
+	ring=NULL;
+	free_slot=NULL;
+
+	return ok;
+}
+
+/** The counters are written under lock by both threads, so readers take a
+ ** copy here rather than looking at them while frames are in flight. */
+AsyncStats AsyncWriter::get_stats()
+{
+	AsyncStats s;
+
+	lock.lock();
+	s=stats;
+	s.depth=depth;
+	lock.unlock();
+
+	return s;
+}
+
+void AsyncWriter::print_stats()
+{
+	AsyncStats s=get_stats();
+	uint frames=s.written > 0 ? s.written : 1;
+
+	printf("Queue: %u submitted, %u written, %u dropped, %u coalesced, max depth %u/%u\n", s.submitted, s.written, s.dropped, s.coalesced, s.max_depth, queue_size);
+	printf("Queue: latency %.3f ms avg %.3f ms max, write %.3f ms, blocked %.3f ms\n", s.sum_latency*1000.0/frames, s.max_latency*1000.0, s.sum_write*1000.0/frames, s.block_time*1000.0);
+}
@@ -0,0 +1,88 @@
+/** File:		sph_async.h
+ ** Author:		Dongli Zhang
+ ** Contact:	dongli.zhang0129@gmail.com
+ **
+ ** Copyright (C) Dongli Zhang 2013
+ **
+ ** This program is free software;  you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+ ** the GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program;  if not, write to the Free Software
+ ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef __SPHASYNC_H__
+#define __SPHASYNC_H__
+
+#include "sph_frame.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+enum QueuePolicy
+{
+	QUEUE_BLOCK=0,
+	QUEUE_DROP=1,
+	QUEUE_COALESCE=2,
+	NUM_QUEUE_POLICY
+};
+
+struct AsyncStats
+{
+	uint depth;
+	uint max_depth;
+	uint submitted;
+	uint written;
+	uint dropped;
+	uint coalesced;
+	double block_time;
+	double sum_latency;
+	double max_latency;
+	double sum_write;
+};
+
+class AsyncWriter
+{
+public:
+	FrameWriter writer;
+	uint policy;
+	uint queue_size;
+
+public:
+	AsyncWriter();
+	~AsyncWriter();
+	uint open(const char *file, float3 world_size, float kernel, float mass);
+	uint submit(const Particle *mem, const uint *index, uint num_particle, float time);
+	uint close();
+	AsyncStats get_stats();
+	void print_stats();
+
+private:
+	AsyncStats stats;
+	uint depth;
+	FrameBuffer *slot;
+	double *submit_time;
+	uint *ring;
+	uint *free_slot;
+	uint head;
+	uint num_free;
+	uint running;
+	uint failed;
+
+	std::thread thread;
+	std::mutex lock;
+	std::condition_variable not_empty;
+	std::condition_variable not_full;
+
+	void write_loop();
+};
+
+#endif
@@ -0,0 +1,377 @@
+/** File:		sph_batch.cpp
+ ** Author:		Dongli Zhang
+ ** Contact:	dongli.zhang0129@gmail.com
+ **
+ ** Copyright (C) Dongli Zhang 2013
+ **
+ ** This program is free software;  you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+ ** the GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program;  if not, write to the Free Software
+ ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/** Headless runner for batch jobs, no GL, GLUT or windows.h.
+ **
+ ** Build it with the solver sources, without sph_main.cpp:
+ **   g++ -O2 -std=c++11 -fopenmp -pthread sph_batch.cpp sph_timer.cpp sph_system.cpp sph_dfsph.cpp sph_iisph.cpp sph_pbf.cpp sph_block_step.cpp sph_sleep.cpp sph_adaptive.cpp sph_sdf.cpp sph_boundary.cpp sph_checkpoint.cpp sph_relax.cpp sph_frame.cpp sph_async.cpp sph_scene.cpp sph_export.cpp -o sph_batch
+ **
+ ** Usage: sph_batch [file.scene] [restart.ckpt] [obstacle.obj ...] [options]
+ **
+ **   -frames n              stop after n frames
+ **   -time t                stop at simulated time t, default the scene's end_time
+ **   -out file.sphf         frame output, default the scene's output line
+ **   -every n               write every n-th frame
+ **   -attrib pvd            attributes to write
+ **   -policy block|drop|coalesce
+ **   -roi x0 y0 z0 x1 y1 z1, -probe cx cy cz r, -sample n   export filter
+ **   -ckpt file.ckpt n      checkpoint every n frames and at the end
+ **   -relax                 settle the lattice or the scene fill through the relaxation cache
+ **   -report n              progress line every n frames
+ **   -profile               time every phase, in the progress lines and at the end
+ **   -csv file.csv          and write the phase times of every frame
+ **   -counters n            neighbor search counters every n steps, 0 for none,
+ **                          needs a build with -DSPH_COUNTERS
+ **   -trace file.json       timeline of the solver and writer threads at the end,
+ **                          for chrome://tracing or ui.perfetto.dev
+ **
+ ** Without a scene the default dam break is run. The run stops early on
+ ** SIGINT or SIGTERM, after the frame in progress, and still writes the
+ ** final checkpoint and closes the frame file. The exit status is 0 when
+ ** the run finished and every write succeeded.
+ */
+
+#include "sph_header.h"
+#include "sph_system.h"
+#include "sph_async.h"
+#include <string.h>
+#include <signal.h>
+
+static volatile sig_atomic_t batch_stop=0;
+
+static void batch_signal(int sig)
+{
+	batch_stop=sig;
+}
+
+static void usage()
+{
+	printf("Usage: sph_batch [file.scene] [restart.ckpt] [obstacle.obj ...] [-frames n] [-time t]\n");
+	printf("                 [-out file.sphf] [-every n] [-attrib pvd] [-policy block|drop|coalesce]\n");
+	printf("                 [-roi x0 y0 z0 x1 y1 z1] [-probe cx cy cz r] [-sample n]\n");
+	printf("                 [-ckpt file.ckpt n] [-relax] [-report n] [-profile] [-csv file.csv]\n");
+	printf("                 [-counters n] [-trace file.json]\n");
+}
+
+int main(int argc, char **argv)
+{
+	SPHSystem *sph=new SPHSystem();
+	AsyncWriter *writer=NULL;
+	ExportFilter filter;
+
+	char *scene=NULL;
+	char *restart=NULL;
+	char *out=NULL;
+	char *ckpt=NULL;
+	char *trace=NULL;
+	char *obstacle[MAX_OBSTACLE];
+	uint num_obstacle=0;
+
+	uint max_frame=0;
+	float end_time=0.0f;
+	uint every=0;
+	uint attrib=0;
+	uint policy=QUEUE_BLOCK;
+	uint ckpt_every=0;
+	uint relax=0;
+	uint report=100;
+	int counters=-1;
+	uint ok=1;
+	size_t len;
+
+	memset(&filter, 0, sizeof(filter));
+
+	for(int i=1; i<argc; i++)
+	{
+		if(strcmp(argv[i], "-frames") == 0 && i+1 < argc)
+		{
+			max_frame=(uint)atoi(argv[++i]);
+		}
+		else if(strcmp(argv[i], "-time") == 0 && i+1 < argc)
+		{
+			end_time=(float)atof(argv[++i]);
+		}
+		else if(strcmp(argv[i], "-out") == 0 && i+1 < argc)
+		{
+			out=argv[++i];
+		}
+		else if(strcmp(argv[i], "-every") == 0 && i+1 < argc)
+		{
+			every=(uint)atoi(argv[++i]);
+		}
+		else if(strcmp(argv[i], "-attrib") == 0 && i+1 < argc)
+		{
+			i++;
+			attrib=(strchr(argv[i], 'p') ? FRAME_POS : 0) | (strchr(argv[i], 'v') ? FRAME_VEL : 0) | (strchr(argv[i], 'd') ? FRAME_DENS : 0);
+		}
+		else if(strcmp(argv[i], "-policy") == 0 && i+1 < argc)
+		{
+			i++;
+			policy=strcmp(argv[i], "drop") == 0 ? QUEUE_DROP : (strcmp(argv[i], "coalesce") == 0 ? QUEUE_COALESCE : QUEUE_BLOCK);
+		}
+		else if(strcmp(argv[i], "-roi") == 0 && i+6 < argc)
+		{
+			filter.region=EXPORT_BOX;
+			filter.lo.x=(float)atof(argv[i+1]);
+			filter.lo.y=(float)atof(argv[i+2]);
+			filter.lo.z=(float)atof(argv[i+3]);
+			filter.hi.x=(float)atof(argv[i+4]);
+			filter.hi.y=(float)atof(argv[i+5]);
+			filter.hi.z=(float)atof(argv[i+6]);
+			i+=6;
+		}
+		else if(strcmp(argv[i], "-probe") == 0 && i+4 < argc)
+		{
+			filter.region=EXPORT_SPHERE;
+			filter.center.x=(float)atof(argv[i+1]);
+			filter.center.y=(float)atof(argv[i+2]);
+			filter.center.z=(float)atof(argv[i+3]);
+			filter.radius=(float)atof(argv[i+4]);
+			i+=4;
+		}
+		else if(strcmp(argv[i], "-sample") == 0 && i+1 < argc)
+		{
+			filter.sample=(uint)atoi(argv[++i]);
+		}
+		else if(strcmp(argv[i], "-ckpt") == 0 && i+2 < argc)
+		{
+			ckpt=argv[i+1];
+			ckpt_every=(uint)atoi(argv[i+2]);
+			i+=2;
+		}
+		else if(strcmp(argv[i], "-relax") == 0)
+		{
+			relax=1;
+		}
+		else if(strcmp(argv[i], "-report") == 0 && i+1 < argc)
+		{
+			report=(uint)atoi(argv[++i]);
+		}
+		else if(strcmp(argv[i], "-profile") == 0)
+		{
+			sph->prof.enabled=1;
+		}
+		else if(strcmp(argv[i], "-csv") == 0 && i+1 < argc)
+		{
+			sph->prof.enabled=1;
+			if(sph->prof.open_csv(argv[++i]) == 0)
+			{
+				return 1;
+			}
+		}
+		else if(strcmp(argv[i], "-counters") == 0 && i+1 < argc)
+		{
+			counters=atoi(argv[++i]);
+		}
+		else if(strcmp(argv[i], "-trace") == 0 && i+1 < argc)
+		{
+			trace=argv[++i];
+			trace_enabled=1;
+			trace_thread("solver");
+		}
+		else if(argv[i][0] == '-')
+		{
+			printf("Unknown option: %s\n", argv[i]);
+			usage();
+			return 1;
+		}
+		else
+		{
+			len=strlen(argv[i]);
+			if(len > 6 && strcmp(argv[i]+len-6, ".scene") == 0)
+			{
+				scene=argv[i];
+			}
+			else if(len > 5 && strcmp(argv[i]+len-5, ".ckpt") == 0)
+			{
+				restart=argv[i];
+			}
+			else if(num_obstacle < MAX_OBSTACLE)
+			{
+				obstacle[num_obstacle]=argv[i];
+				num_obstacle++;
+			}
+		}
+	}
+
+	if(scene != NULL)
+	{
+		if(sph->load_scene(scene, obstacle, num_obstacle) == 0)
+		{
+			return 1;
+		}
+
+		end_time=end_time > 0.0f ? end_time : sph->output.end_time;
+		out=out != NULL ? out : (sph->output.frame_file[0] != '\0' ? sph->output.frame_file : NULL);
+		every=every > 0 ? every : sph->output.frame_every;
+		attrib=attrib > 0 ? attrib : sph->output.frame_attrib;
+		if(filter.region == EXPORT_ALL && filter.sample == 0)
+		{
+			filter=sph->output.frame_filter;
+		}
+		if(ckpt == NULL && sph->output.checkpoint_file[0] != '\0')
+		{
+			ckpt=sph->output.checkpoint_file;
+			ckpt_every=sph->output.checkpoint_every;
+		}
+	}
+
+	if(max_frame == 0 && end_time <= 0.0f)
+	{
+		printf("No stop condition, give -frames or -time\n");
+		usage();
+		return 1;
+	}
+
+	for(uint i=0; scene == NULL && i<num_obstacle; i++)
+	{
+		if(sph->add_obstacle(obstacle[i], sph->kernel*0.125f) == 0)
+		{
+			return 1;
+		}
+	}
+
+	if(restart != NULL)
+	{
+		if(sph->load_checkpoint(restart) == 0)
+		{
+			return 1;
+		}
+	}
+	else if(scene == NULL && relax)
+	{
+		sph->init_relaxed(".");
+	}
+	else if(relax)
+	{
+		sph->relax_cached(".");
+	}
+	else if(scene == NULL)
+	{
+		sph->init_system();
+	}
+
+	if(out != NULL)
+	{
+		writer=new AsyncWriter();
+		writer->writer.attrib=attrib > 0 ? attrib : FRAME_POS;
+		writer->policy=policy;
+		if(writer->open(out, sph->world_size, sph->kernel, sph->mass) == 0)
+		{
+			delete writer;
+			return 1;
+		}
+	}
+	every=every > 0 ? every : 1;
+	report=report > 0 ? report : 100;
+	if(counters >= 0)
+	{
+		sph->count_every=(uint)counters;
+#ifndef SPH_COUNTERS
+		printf("Built without SPH_COUNTERS, -counters has no effect\n");
+#endif
+	}
+
+	signal(SIGINT, batch_signal);
+	signal(SIGTERM, batch_signal);
+
+	printf("Batch: %u particles, %u frames, end time %.3f, output %s, checkpoint %s\n", sph->num_particle, max_frame, end_time, out != NULL ? out : "none", ckpt != NULL ? ckpt : "none");
+
+	double start=Profiler::profile_now();
+	uint frame=0;
+
+	sph->prof.reset();
+	sph->sys_running=1;
+	while(batch_stop == 0 && (max_frame == 0 || frame < max_frame) && (end_time <= 0.0f || sph->sim_time < end_time))
+	{
+		sph->animation();
+
+		if(writer != NULL && frame%every == 0)
+		{
+			uint num;
+			sph->prof.begin(PHASE_EXPORT);
+			const uint *index=sph->select_particle(&filter, &num);
+			writer->submit(sph->mem, index, num, sph->sim_time);
+			sph->prof.end(PHASE_EXPORT);
+		}
+		frame++;
+
+		if(ckpt != NULL && ckpt_every > 0 && frame%ckpt_every == 0)
+		{
+			ok=sph->save_checkpoint(ckpt) && ok;
+		}
+
+		sph->prof.end_frame();
+
+		if(frame%report == 0)
+		{
+			double wall=Profiler::profile_now()-start;
+			printf("Frame %u: time %.4f, %u particles, %u steps, %.2f ms/frame, wall %.1f s\n", frame, sph->sim_time, sph->num_particle, sph->tot_step, wall*1000.0/frame, wall);
+			if(writer != NULL)
+			{
+				AsyncStats st=writer->get_stats();
+				printf("Queue: depth %u/%u, max %u, latency %.3f ms avg %.3f ms max, %u dropped, %u coalesced\n", st.depth, writer->queue_size, st.max_depth,
+					st.sum_latency*1000.0/(st.written > 0 ? st.written : 1), st.max_latency*1000.0, st.dropped, st.coalesced);
+			}
+			if(sph->prof.enabled)
+			{
+				char line[512];
+				sph->prof.title(line, sizeof(line));
+				printf("Profile: %s\n", line);
+			}
+			fflush(stdout);
+		}
+	}
+
+	if(batch_stop)
+	{
+		printf("Stopped by signal %d at frame %u\n", (int)batch_stop, frame);
+	}
+
+	if(ckpt != NULL && (ckpt_every == 0 || frame%ckpt_every != 0))
+	{
+		ok=sph->save_checkpoint(ckpt) && ok;
+	}
+
+	if(writer != NULL)
+	{
+		ok=writer->close() && ok;
+		delete writer;
+	}
+
+	if(sph->prof.enabled)
+	{
+		sph->prof.print();
+	}
+	sph->prof.close_csv();
+
+	if(trace != NULL)
+	{
+		ok=trace_dump(trace) && ok;
+	}
+
+	double wall=Profiler::profile_now()-start;
+	printf("Done: %u frames, time %.4f, %u steps, %u particles, wall %.2f s, %.2f ms/frame\n", frame, sph->sim_time, sph->tot_step, sph->num_particle, wall, frame > 0 ? wall*1000.0/frame : 0.0);
+
+	delete sph;
+
+	return ok && batch_stop == 0 ? 0 : 1;
+}
@@ -0,0 +1,378 @@
+/** File:		sph_bench_phase.cpp
+ ** Author:		Dongli Zhang
+ ** Contact:	dongli.zhang0129@gmail.com
+ **
+ ** Copyright (C) Dongli Zhang 2013
+ **
+ ** This program is free software;  you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+ ** the GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program;  if not, write to the Free Software
+ ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/** Microbenchmarks of the single phases, no GL needed.
+ **
+ ** Build it with the solver sources and the marching cubes:
+ **   g++ -O2 -std=c++11 -fopenmp -pthread -I../libmarchingcube sph_bench_phase.cpp ../libmarchingcube/MarchingCube.cpp sph_timer.cpp sph_system.cpp sph_dfsph.cpp sph_iisph.cpp sph_pbf.cpp sph_block_step.cpp sph_sleep.cpp sph_adaptive.cpp sph_sdf.cpp sph_boundary.cpp sph_checkpoint.cpp sph_relax.cpp sph_frame.cpp sph_async.cpp sph_scene.cpp sph_export.cpp
+ **
+ ** Usage: sph_bench_phase [-max n] [-warmup n] [-reps n] [-csv file.csv]
+ **
+ ** Every size from 10k up to -max particles, default 10M, gets a canonical
+ ** dam break: a block of fluid on the lattice twice as tall as it is wide,
+ ** in a world sized from the block. build_table, comp_dens_pres,
+ ** comp_force_adv and advection are then each run warmup times untimed and
+ ** reps times timed on it, in that order, so every phase sees the state the
+ ** one before left. The marching cubes get a sphere field with as many
+ ** voxels as particles.
+ **
+ ** The columns are the phase, the particles or voxels, the neighbor pairs
+ ** within the kernel, the best and the median rep in ms, the median in ns
+ ** per particle and in pairs per second, and the bandwidth of the median.
+ ** Bytes are what the phase has to stream: the particle array once, the
+ ** cell array for the table and the neighbor walks, and for the marching
+ ** cubes the field, the normals and the triangles. Neighbor reads are taken
+ ** to hit the cache, so this is a lower bound. -csv writes the same rows.
+ */
+
+#include "sph_header.h"
+#include "sph_system.h"
+#include "MarchingCube.h"
+#include <string.h>
+
+#define BENCH_MAX_REP 64
+
+enum BenchPhase
+{
+	BENCH_TABLE=0,
+	BENCH_DENS=1,
+	BENCH_FORCE=2,
+	BENCH_ADVECT=3,
+	BENCH_MC=4,
+	NUM_BENCH
+};
+
+static const char *bench_name[NUM_BENCH]=
+{
+	"table",
+	"density",
+	"force",
+	"advect",
+	"mc"
+};
+
+static const uint bench_size[4]={10000, 100000, 1000000, 10000000};
+
+static FILE *csv=NULL;
+static uint warmup=1;
+static uint reps=5;
+
+static int comp_time(const void *a, const void *b)
+{
+	double x=*(const double *)a;
+	double y=*(const double *)b;
+
+	return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+/** Writes the canonical scene for about num particles and loads it. The
+ ** block is nx by 2nx by nx lattice points, the world leaves it room to
+ ** collapse into.
+ */
+
+static SPHSystem *init_bench(uint num)
+{
+	const char *file="sph_bench_phase.scene";
+	SPHSystem *sph=new SPHSystem();
+	float spacing=sph->kernel*0.5f;
+	uint nx=(uint)floor(pow(num*0.5, 1.0/3.0)+0.5);
+	uint ny=(uint)floor((double)num/(nx*nx)+0.5);
+	float3 box;
+	FILE *fp;
+
+	box.x=(nx-0.5f)*spacing;
+	box.y=(ny-0.5f)*spacing;
+	box.z=(nx-0.5f)*spacing;
+
+	fp=fopen(file, "w");
+	if(fp == NULL)
+	{
+		printf("Cannot write %s\n", file);
+		delete sph;
+		return NULL;
+	}
+
+	fprintf(fp, "kernel %f\n", sph->kernel);
+	fprintf(fp, "mass %f\n", sph->mass);
+	fprintf(fp, "world_size %f %f %f\n", box.x*1.6f, box.y*1.1f, box.z*1.6f);
+	fprintf(fp, "box 0.0 0.0 0.0 %f %f %f\n", box.x, box.y, box.z);
+	fclose(fp);
+
+	if(sph->load_scene(file, NULL, 0) == 0)
+	{
+		delete sph;
+		sph=NULL;
+	}
+
+	remove(file);
+
+	return sph;
+}
+
+/** Pairs within the kernel, counted with the same 27 cell walk as the
+ ** density pass. The canonical scene has no periodic axes.
+ */
+
+static double count_pairs(SPHSystem *sph)
+{
+	double pairs=0.0;
+	Particle *p;
+	Particle *np;
+	int3 cell_pos;
+	int3 near_pos;
+	float3 rel_pos;
+
+	for(uint i=0; i<sph->num_particle; i++)
+	{
+		p=&(sph->mem[i]);
+		cell_pos.x=(int)floor(p->pos.x/sph->cell_size);
+		cell_pos.y=(int)floor(p->pos.y/sph->cell_size);
+		cell_pos.z=(int)floor(p->pos.z/sph->cell_size);
+
+		for(int x=-1; x<=1; x++)
+		{
+			for(int y=-1; y<=1; y++)
+			{
+				for(int z=-1; z<=1; z++)
+				{
+					near_pos.x=cell_pos.x+x;
+					near_pos.y=cell_pos.y+y;
+					near_pos.z=cell_pos.z+z;
+
+					if(near_pos.x<0 || near_pos.x>=(int)sph->grid_size.x || near_pos.y<0 || near_pos.y>=(int)sph->grid_size.y || near_pos.z<0 || near_pos.z>=(int)sph->grid_size.z)
+					{
+						continue;
+					}
+
+					for(np=sph->cell[((uint)near_pos.z*sph->grid_size.y+(uint)near_pos.y)*sph->grid_size.x+(uint)near_pos.x]; np != NULL; np=np->next)
+					{
+						rel_pos.x=np->pos.x-p->pos.x;
+						rel_pos.y=np->pos.y-p->pos.y;
+						rel_pos.z=np->pos.z-p->pos.z;
+
+						if(np != p && rel_pos.x*rel_pos.x+rel_pos.y*rel_pos.y+rel_pos.z*rel_pos.z < sph->kernel_2)
+						{
+							pairs+=1.0;
+						}
+					}
+				}
+			}
+		}
+	}
+
+	return pairs;
+}
+
+static void run_phase(SPHSystem *sph, MarchingCube *mc, uint phase)
+{
+	switch(phase)
+	{
+	case BENCH_TABLE:
+		sph->build_table();
+		break;
+	case BENCH_DENS:
+		sph->comp_dens_pres();
+		break;
+	case BENCH_FORCE:
+		sph->comp_force_adv(1);
+		break;
+	case BENCH_ADVECT:
+		sph->advection();
+		break;
+	default:
+		mc->run();
+		break;
+	}
+}
+
+static void print_head()
+{
+	printf("%-8s %10s %12s %10s %10s %10s %12s %10s\n", "phase", "count", "pairs", "best_ms", "median_ms", "ns_item", "pairs_s", "gb_s");
+}
+
+static void report(uint phase, uint num, double pairs, double *time, double bytes)
+{
+	double best;
+	double median;
+
+	qsort(time, reps, sizeof(double), comp_time);
+	best=time[0];
+	median=time[reps/2];
+
+	printf("%-8s %10u %12.0f %10.3f %10.3f %10.2f %12.3e %10.3f\n", bench_name[phase], num, pairs, best*1e3, median*1e3, median*1e9/num, pairs/median, bytes/median*1e-9);
+
+	if(csv != NULL)
+	{
+		fprintf(csv, "%s,%u,%.0f,%u,%u,%.6f,%.6f,%.4f,%.6e,%.6f\n", bench_name[phase], num, pairs, warmup, reps, best*1e3, median*1e3, median*1e9/num, pairs/median, bytes/median*1e-9);
+		fflush(csv);
+	}
+}
+
+static void time_phase(SPHSystem *sph, MarchingCube *mc, uint phase, uint num, double pairs, double bytes)
+{
+	double time[BENCH_MAX_REP];
+	double start;
+
+	for(uint i=0; i<warmup; i++)
+	{
+		run_phase(sph, mc, phase);
+	}
+
+	for(uint i=0; i<reps; i++)
+	{
+		start=Profiler::profile_now();
+		run_phase(sph, mc, phase);
+		time[i]=Profiler::profile_now()-start;
+	}
+
+	report(phase, num, pairs, time, bytes);
+}
+
+static void bench_sph(uint num)
+{
+	SPHSystem *sph=init_bench(num);
+	double pairs;
+	double part_bytes;
+	double cell_bytes;
+
+	if(sph == NULL)
+	{
+		return;
+	}
+
+	sph->build_table();
+	pairs=count_pairs(sph);
+	part_bytes=(double)sph->num_particle*sizeof(Particle);
+	cell_bytes=(double)sph->tot_cell*sizeof(Particle *);
+
+	print_head();
+
+	time_phase(sph, NULL, BENCH_TABLE, sph->num_particle, 0.0, part_bytes+cell_bytes);
+	time_phase(sph, NULL, BENCH_DENS, sph->num_particle, pairs, part_bytes+cell_bytes);
+	time_phase(sph, NULL, BENCH_FORCE, sph->num_particle, pairs, part_bytes+cell_bytes);
+	time_phase(sph, NULL, BENCH_ADVECT, sph->num_particle, 0.0, part_bytes);
+
+	delete sph;
+}
+
+/** The field of the marching cubes viewer, a ball of pow(1-r^2/R^2, 3)
+ ** filling 0.8 of a cube of voxels, cut at 0.4.
+ */
+
+static void bench_mc(uint num)
+{
+	uint side=(uint)floor(pow((double)num, 1.0/3.0)+0.5);
+	uint tot_vox=side*side*side;
+	float step=0.5f;
+	float radius=side*step*0.4f;
+	float *scalar=(float *)malloc(sizeof(float)*tot_vox);
+	float3 *pos=(float3 *)malloc(sizeof(float3)*tot_vox);
+	float3 origin;
+	float dist;
+	uint index;
+	MarchingCube *mc;
+
+	origin.x=0.0f;
+	origin.y=0.0f;
+	origin.z=0.0f;
+
+	for(uint x=0; x<side; x++)
+	{
+		for(uint y=0; y<side; y++)
+		{
+			for(uint z=0; z<side; z++)
+			{
+				index=z*side*side+y*side+x;
+				pos[index].x=x*step;
+				pos[index].y=y*step;
+				pos[index].z=z*step;
+
+				dist=((x*step-side*step*0.5f)*(x*step-side*step*0.5f)+(y*step-side*step*0.5f)*(y*step-side*step*0.5f)+(z*step-side*step*0.5f)*(z*step-side*step*0.5f))/(radius*radius);
+				scalar[index]=dist < 1.0f ? (float)pow(1.0f-dist, 3) : 0.0f;
+			}
+		}
+	}
+
+	mc=new MarchingCube(side, side, side, scalar, pos, origin, step, 0.4f);
+	mc->run();
+
+	time_phase(NULL, mc, BENCH_MC, tot_vox, 0.0, (double)tot_vox*(sizeof(float)*2+sizeof(float3)*3)+(double)mc->num_tri*sizeof(float3)*6);
+
+	delete mc;
+	free(scalar);
+	free(pos);
+}
+
+int main(int argc, char **argv)
+{
+	uint max_num=10000000;
+
+	for(int i=1; i<argc; i++)
+	{
+		if(strcmp(argv[i], "-max") == 0 && i+1 < argc)
+		{
+			max_num=(uint)atoi(argv[++i]);
+		}
+		else if(strcmp(argv[i], "-warmup") == 0 && i+1 < argc)
+		{
+			warmup=(uint)atoi(argv[++i]);
+		}
+		else if(strcmp(argv[i], "-reps") == 0 && i+1 < argc)
+		{
+			reps=(uint)atoi(argv[++i]);
+		}
+		else if(strcmp(argv[i], "-csv") == 0 && i+1 < argc)
+		{
+			csv=fopen(argv[++i], "w");
+			if(csv == NULL)
+			{
+				printf("Cannot write %s\n", argv[i]);
+				return 1;
+			}
+			fprintf(csv, "phase,count,pairs,warmup,reps,best_ms,median_ms,ns_per_particle,pairs_per_s,gb_per_s\n");
+		}
+		else
+		{
+			printf("Usage: sph_bench_phase [-max n] [-warmup n] [-reps n] [-csv file.csv]\n");
+			return 1;
+		}
+	}
+
+	reps=reps < 1 ? 1 : (reps > BENCH_MAX_REP ? BENCH_MAX_REP : reps);
+
+	for(uint s=0; s<4 && bench_size[s]<=max_num; s++)
+	{
+		bench_sph(bench_size[s]);
+	}
+
+	print_head();
+	for(uint s=0; s<4 && bench_size[s]<=max_num; s++)
+	{
+		bench_mc(bench_size[s]);
+	}
+
+	if(csv != NULL)
+	{
+		fclose(csv);
+	}
+
+	return 0;
+}
@@ -0,0 +1,767 @@
+/** File:		sph_bench_solver.cpp
+ ** Author:		Dongli Zhang
+ ** Contact:	dongli.zhang0129@gmail.com
+ **
+ ** Copyright (C) Dongli Zhang 2013
+ **
+ ** This program is free software;  you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+ ** the GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program;  if not, write to the Free Software
+ ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/** Dam break benchmarks, no GL needed.
+ **
+ ** Build it with sph_system.cpp and the solver sources:
+ **   g++ -O2 -std=c++11 -fopenmp -pthread sph_bench_solver.cpp sph_timer.cpp sph_system.cpp sph_dfsph.cpp sph_iisph.cpp sph_pbf.cpp sph_block_step.cpp sph_sleep.cpp sph_adaptive.cpp sph_sdf.cpp sph_boundary.cpp sph_checkpoint.cpp sph_relax.cpp sph_frame.cpp sph_async.cpp sph_scene.cpp sph_export.cpp
+ **
+ ** Usage: sph_bench_solver [sim_seconds]      wall time per simulated second for every solver, dt against WCSPH
+ **        sph_bench_solver dt [sim_seconds]   largest stable fixed dt for every integrator
+ **        sph_bench_solver sleep [sim_seconds] ms per step with and without sleeping cells
+ **        sph_bench_solver adapt [sim_seconds] deep tank with and without adaptive resolution
+ **        sph_bench_solver relax [sim_seconds] startup from the lattice, a relaxation miss and a hit
+ **        sph_bench_solver frame [sim_seconds] compressed frame output and replay for each attribute set
+ **        sph_bench_solver async [sim_seconds] frame output inline and on the writer thread per policy
+ **        sph_bench_solver scene file [sim_seconds] scene startup time, then the run with its emitters
+ **        sph_bench_solver export [sim_seconds] [scene] full, region and sampled frame export
+ **        sph_bench_solver profile [sim_seconds] mean ms per frame in every phase for every solver
+ **        sph_bench_solver hash [sim_seconds] grid density against brute force on grids that are not a power of two
+ **        sph_bench_solver block [sim_seconds] jet into a pool with global and block time steps for every integrator
+ */
+
+#include "sph_header.h"
+#include "sph_system.h"
+#include "sph_async.h"
+#include <chrono>
+#include <string.h>
+
+static const char *solver_name[NUM_SOLVER]=
+{
+	"WCSPH",
+	"DFSPH",
+	"IISPH",
+	"PBF"
+};
+
+static const char *integrator_name[NUM_INTEGRATOR]=
+{
+	"Euler",
+	"Leapfrog"
+};
+
+static void bench_solver(float sim_time)
+{
+	float base_dt=0.0f;
+
+	printf("%-8s %10s %8s %10s %8s %10s %12s %12s\n", "solver", "sim_s", "steps", "avg_dt", "dt_ratio", "avg_iter", "wall_per_s", "ms_per_frame");
+
+	for(uint mode=0; mode<NUM_SOLVER; mode++)
+	{
+		SPHSystem *sph=new SPHSystem();
+		sph->init_system();
+		sph->solver_mode=mode;
+		sph->sys_running=1;
+
+		float elapsed=0.0f;
+		uint frames=0;
+
+		std::chrono::steady_clock::time_point start=std::chrono::steady_clock::now();
+		while(elapsed < sim_time)
+		{
+			sph->animation();
+			elapsed+=sph->adaptive_step ? sph->frame_time : sph->time_step;
+			frames++;
+		}
+		double wall=std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+
+		uint steps=sph->tot_step;
+		base_dt=mode == SOLVER_WCSPH ? elapsed/steps : base_dt;
+		printf("%-8s %10.3f %8u %10.6f %8.2f %10.2f %12.3f %12.3f\n", solver_name[mode], elapsed, steps, elapsed/steps, elapsed/steps/base_dt, (float)sph->tot_iter/steps, wall/elapsed, wall*1000.0/frames);
+
+		delete sph;
+	}
+}
+
+static uint run_stable(uint integrator, float dt, float sim_time)
+{
+	SPHSystem *sph=new SPHSystem();
+	sph->init_system();
+	sph->integrator=integrator;
+	sph->adaptive_step=0;
+	sph->time_step=dt;
+	sph->sys_running=1;
+
+	uint stable=1;
+	for(float elapsed=0.0f; elapsed<sim_time; elapsed+=dt)
+	{
+		sph->animation();
+
+		if(!(sph->max_vel < 10.0f))
+		{
+			stable=0;
+			break;
+		}
+	}
+
+	delete sph;
+	return stable;
+}
+
+static void bench_dt(float sim_time)
+{
+	static const float dt_list[]={0.002f, 0.003f, 0.004f, 0.005f, 0.006f, 0.008f, 0.010f, 0.012f};
+	uint num_dt=sizeof(dt_list)/sizeof(dt_list[0]);
+
+	printf("%-10s %12s\n", "integrator", "max_dt");
+
+	for(uint integrator=0; integrator<NUM_INTEGRATOR; integrator++)
+	{
+		float max_dt=0.0f;
+		for(uint i=0; i<num_dt; i++)
+		{
+			if(run_stable(integrator, dt_list[i], sim_time) == 0)
+			{
+				break;
+			}
+			max_dt=dt_list[i];
+		}
+
+		printf("%-10s %12.4f\n", integrator_name[integrator], max_dt);
+	}
+}
+
+static void bench_sleep(float sim_time)
+{
+	SPHSystem *sph[2];
+
+	for(uint i=0; i<2; i++)
+	{
+		sph[i]=new SPHSystem();
+		sph[i]->init_system();
+		sph[i]->sleeping=i;
+		sph[i]->sys_running=1;
+	}
+
+	printf("%10s %10s %14s %14s %10s\n", "sim_s", "awake", "ms_step_off", "ms_step_on", "speedup");
+
+	for(float elapsed=0.0f; elapsed<sim_time; )
+	{
+		double wall[2];
+		uint steps[2];
+
+		for(uint i=0; i<2; i++)
+		{
+			uint start_step=sph[i]->tot_step;
+			std::chrono::steady_clock::time_point start=std::chrono::steady_clock::now();
+			for(float t=0.0f; t<0.5f; t+=sph[i]->frame_time)
+			{
+				sph[i]->animation();
+			}
+			wall[i]=std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+			steps[i]=sph[i]->tot_step-start_step;
+		}
+		elapsed+=0.5f;
+
+		double ms_off=wall[0]*1000.0/steps[0];
+		double ms_on=wall[1]*1000.0/steps[1];
+		printf("%10.2f %10.3f %14.3f %14.3f %10.2f\n", elapsed, 1.0f-(float)sph[1]->num_sleep/sph[1]->num_particle, ms_off, ms_on, ms_off/ms_on);
+	}
+
+	delete sph[0];
+	delete sph[1];
+}
+
+static void init_tank(SPHSystem *sph)
+{
+	float3 pos;
+	float3 vel;
+
+	vel.x=0.0f;
+	vel.y=0.0f;
+	vel.z=0.0f;
+
+	for(pos.x=0.0f; pos.x<sph->world_size.x; pos.x+=(sph->kernel*0.5f))
+	{
+		for(pos.y=0.0f; pos.y<sph->world_size.y*0.6f; pos.y+=(sph->kernel*0.5f))
+		{
+			for(pos.z=0.0f; pos.z<sph->world_size.z; pos.z+=(sph->kernel*0.5f))
+			{
+				sph->add_particle(pos, vel);
+			}
+		}
+	}
+}
+
+static void bench_adapt(float sim_time)
+{
+	printf("%-8s %10s %10s %10s %10s %12s %12s\n", "adapt", "sim_s", "particles", "coarse", "surface", "ms_step", "wall_per_s");
+
+	for(uint adapt=0; adapt<2; adapt++)
+	{
+		SPHSystem *sph=new SPHSystem();
+		init_tank(sph);
+		sph->adaptive_res=adapt;
+		sph->sys_running=1;
+
+		for(float elapsed=0.0f; elapsed<sim_time; )
+		{
+			uint start_step=sph->tot_step;
+			std::chrono::steady_clock::time_point start=std::chrono::steady_clock::now();
+			for(float t=0.0f; t<0.5f; t+=sph->frame_time)
+			{
+				sph->animation();
+			}
+			double wall=std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+			elapsed+=0.5f;
+
+			uint surface=0;
+			for(uint i=0; i<sph->num_particle; i++)
+			{
+				surface+=sph->mem[i].surf_norm > sph->surf_norm;
+			}
+
+			printf("%-8s %10.2f %10u %10u %10u %12.3f %12.3f\n", adapt ? "on" : "off", elapsed, sph->num_particle, sph->num_coarse, surface, wall*1000.0/(sph->tot_step-start_step), wall/0.5);
+		}
+
+		delete sph;
+	}
+}
+
+static void bench_relax(float sim_time)
+{
+	const char *case_name[3]={"lattice", "miss", "hit"};
+	SPHSystem *lattice=new SPHSystem();
+	char file[64];
+
+	lattice->init_system();
+	sprintf(file, "./relax_%016llx.ckpt", lattice->relax_key());
+	delete lattice;
+	remove(file);
+
+	printf("%-8s %10s %10s %10s %10s\n", "start", "init_s", "sim_s", "steps", "max_vel");
+
+	for(uint c=0; c<3; c++)
+	{
+		SPHSystem *sph=new SPHSystem();
+
+		std::chrono::steady_clock::time_point start=std::chrono::steady_clock::now();
+		if(c == 0)
+		{
+			sph->init_system();
+		}
+		else
+		{
+			sph->init_relaxed(".");
+		}
+		double wall=std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+
+		sph->sys_running=1;
+		for(float t=0.0f; t<sim_time; t+=sph->frame_time)
+		{
+			sph->animation();
+		}
+
+		printf("%-8s %10.3f %10.2f %10u %10.4f\n", case_name[c], wall, sim_time, sph->tot_step, sph->max_vel);
+
+		delete sph;
+	}
+
+	remove(file);
+}
+
+static void bench_frame(float sim_time)
+{
+	const char *attrib_name[3]={"pos", "pos_vel", "all"};
+	const uint attrib[3]={FRAME_POS, FRAME_POS | FRAME_VEL, FRAME_POS | FRAME_VEL | FRAME_DENS};
+	const char *file[3]={"bench_pos.sphf", "bench_pos_vel.sphf", "bench_all.sphf"};
+	FrameWriter writer[3];
+	double wall[3]={0.0, 0.0, 0.0};
+	uint frames=0;
+
+	SPHSystem *sph=new SPHSystem();
+	sph->init_system();
+	sph->sys_running=1;
+
+	for(uint a=0; a<3; a++)
+	{
+		writer[a].attrib=attrib[a];
+		writer[a].open(file[a], sph->world_size, sph->kernel, sph->mass);
+	}
+
+	for(float t=0.0f; t<sim_time; t+=sph->frame_time)
+	{
+		sph->animation();
+
+		for(uint a=0; a<3; a++)
+		{
+			std::chrono::steady_clock::time_point start=std::chrono::steady_clock::now();
+			writer[a].write(sph->mem, NULL, sph->num_particle, t);
+			wall[a]+=std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+		}
+		frames++;
+	}
+
+	printf("%-8s %10s %12s %12s %12s %12s\n", "attrib", "frames", "bytes_part", "ms_frame", "raw_MB_s", "play_ms");
+	for(uint a=0; a<3; a++)
+	{
+		FrameReader reader;
+		double play=0.0;
+
+		writer[a].close();
+		if(reader.open(file[a]))
+		{
+			std::chrono::steady_clock::time_point start=std::chrono::steady_clock::now();
+			for(uint i=0; i<reader.num_frame; i++)
+			{
+				reader.seek(i);
+			}
+			play=std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+			reader.close();
+		}
+
+		printf("%-8s %10u %12.3f %12.3f %12.1f %12.3f\n", attrib_name[a], frames, writer[a].bytes_per_particle(), wall[a]*1000.0/frames,
+			(double)writer[a].tot_particle*frame_components(attrib[a])*sizeof(float)/wall[a]/1e6, play*1000.0/frames);
+		remove(file[a]);
+	}
+
+	delete sph;
+}
+
+static void bench_async(float sim_time)
+{
+	const char *mode_name[NUM_QUEUE_POLICY+1]={"block", "drop", "coalesce", "inline"};
+
+	printf("%-8s %10s %10s %10s %10s %10s %12s %12s\n", "output", "frames", "written", "skipped", "max_depth", "ms_frame", "output_ms", "latency_ms");
+
+	for(uint mode=0; mode<=NUM_QUEUE_POLICY; mode++)
+	{
+		SPHSystem *sph=new SPHSystem();
+		FrameWriter writer;
+		AsyncWriter async;
+		double output=0.0;
+		uint frames=0;
+
+		sph->init_system();
+		sph->sys_running=1;
+
+		writer.attrib=FRAME_POS | FRAME_VEL | FRAME_DENS;
+		async.writer.attrib=writer.attrib;
+		async.policy=mode;
+		if(mode == NUM_QUEUE_POLICY)
+		{
+			writer.open("bench_async.sphf", sph->world_size, sph->kernel, sph->mass);
+		}
+		else
+		{
+			async.open("bench_async.sphf", sph->world_size, sph->kernel, sph->mass);
+		}
+
+		std::chrono::steady_clock::time_point start=std::chrono::steady_clock::now();
+		for(float t=0.0f; t<sim_time; t+=sph->frame_time)
+		{
+			sph->animation();
+
+			std::chrono::steady_clock::time_point out=std::chrono::steady_clock::now();
+			if(mode == NUM_QUEUE_POLICY)
+			{
+				writer.write(sph->mem, NULL, sph->num_particle, t);
+			}
+			else
+			{
+				async.submit(sph->mem, NULL, sph->num_particle, t);
+			}
+			output+=std::chrono::duration<double>(std::chrono::steady_clock::now()-out).count();
+			frames++;
+		}
+		double wall=std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+
+		if(mode == NUM_QUEUE_POLICY)
+		{
+			writer.close();
+			printf("%-8s %10u %10u %10u %10s %10.3f %12.3f %12s\n", mode_name[mode], frames, writer.num_frame, 0, "-", wall*1000.0/frames, output*1000.0/frames, "-");
+		}
+		else
+		{
+			async.close();
+			AsyncStats st=async.get_stats();
+			printf("%-8s %10u %10u %10u %10u %10.3f %12.3f %12.3f\n", mode_name[mode], frames, st.written, st.dropped+st.coalesced, st.max_depth,
+				wall*1000.0/frames, output*1000.0/frames, st.sum_latency*1000.0/(st.written > 0 ? st.written : 1));
+		}
+
+		remove("bench_async.sphf");
+		delete sph;
+	}
+}
+
+static void bench_export(float sim_time, const char *scene)
+{
+	const char *filter_name[5]={"all", "box", "sphere", "sample", "box_sample"};
+	ExportFilter filter[5];
+	FrameWriter writer[5];
+	char file[64];
+	double select_time[5]={0.0, 0.0, 0.0, 0.0, 0.0};
+	double write_time[5]={0.0, 0.0, 0.0, 0.0, 0.0};
+	double exported[5]={0.0, 0.0, 0.0, 0.0, 0.0};
+	uint frames=0;
+
+	SPHSystem *sph=new SPHSystem();
+	if(scene == NULL || sph->load_scene(scene, NULL, 0) == 0)
+	{
+		sph->init_system();
+	}
+	sph->sys_running=1;
+
+	memset(filter, 0, sizeof(filter));
+	filter[1].region=EXPORT_BOX;
+	filter[1].lo.x=sph->world_size.x*0.2f;
+	filter[1].lo.y=0.0f;
+	filter[1].lo.z=sph->world_size.z*0.2f;
+	filter[1].hi.x=sph->world_size.x*0.4f;
+	filter[1].hi.y=sph->world_size.y*0.2f;
+	filter[1].hi.z=sph->world_size.z*0.4f;
+	filter[2].region=EXPORT_SPHERE;
+	filter[2].center.x=sph->world_size.x*0.3f;
+	filter[2].center.y=sph->world_size.y*0.1f;
+	filter[2].center.z=sph->world_size.z*0.3f;
+	filter[2].radius=sph->world_size.y*0.1f;
+	filter[3].sample=100;
+	filter[4]=filter[1];
+	filter[4].sample=10;
+
+	for(uint f=0; f<5; f++)
+	{
+		sprintf(file, "bench_%s.sphf", filter_name[f]);
+		writer[f].attrib=FRAME_POS | FRAME_VEL;
+		writer[f].open(file, sph->world_size, sph->kernel, sph->mass);
+	}
+
+	while(sph->sim_time < sim_time)
+	{
+		sph->animation();
+
+		for(uint f=0; f<5; f++)
+		{
+			const uint *index;
+			uint num;
+
+			std::chrono::steady_clock::time_point start=std::chrono::steady_clock::now();
+			index=sph->select_particle(&(filter[f]), &num);
+			std::chrono::steady_clock::time_point mid=std::chrono::steady_clock::now();
+			writer[f].write(sph->mem, index, num, sph->sim_time);
+			std::chrono::steady_clock::time_point end=std::chrono::steady_clock::now();
+
+			select_time[f]+=std::chrono::duration<double>(mid-start).count();
+			write_time[f]+=std::chrono::duration<double>(end-mid).count();
+			exported[f]+=num;
+		}
+		frames++;
+	}
+
+	frames=frames > 0 ? frames : 1;
+	printf("%-10s %10s %12s %12s %12s\n", "filter", "particles", "select_us", "write_us", "bytes_frame");
+	for(uint f=0; f<5; f++)
+	{
+		writer[f].close();
+		printf("%-10s %10.0f %12.1f %12.1f %12.0f\n", filter_name[f], exported[f]/frames, select_time[f]*1e6/frames, write_time[f]*1e6/frames, (double)writer[f].tot_bytes/frames);
+
+		sprintf(file, "bench_%s.sphf", filter_name[f]);
+		remove(file);
+	}
+
+	delete sph;
+}
+
+static void bench_profile(float sim_time)
+{
+	printf("%-8s", "solver");
+	for(uint i=0; i<NUM_PHASE; i++)
+	{
+		if(i != PHASE_EXPORT && i != PHASE_RENDER)
+		{
+			printf(" %9s", phase_name[i]);
+		}
+	}
+	printf(" %9s\n", "p95_frame");
+
+	for(uint mode=0; mode<NUM_SOLVER; mode++)
+	{
+		SPHSystem *sph=new SPHSystem();
+		sph->solver_mode=mode;
+		sph->init_system();
+		sph->sys_running=1;
+		sph->prof.enabled=1;
+		sph->prof.reset();
+
+		for(float t=0.0f; t<sim_time; t+=sph->frame_time)
+		{
+			sph->animation();
+			sph->prof.end_frame();
+		}
+
+		printf("%-8s", solver_name[mode]);
+		for(uint i=0; i<NUM_PHASE; i++)
+		{
+			if(i != PHASE_EXPORT && i != PHASE_RENDER)
+			{
+				printf(" %9.3f", sph->prof.total[i]*1000.0/sph->prof.num_frame);
+			}
+		}
+		printf(" %9.3f\n", sph->prof.percentile(PHASE_FRAME, 0.95f));
+
+		delete sph;
+	}
+}
+
+static void bench_scene(const char *file, float sim_time)
+{
+	SPHSystem *sph=new SPHSystem();
+
+	std::chrono::steady_clock::time_point start=std::chrono::steady_clock::now();
+	if(sph->load_scene(file, NULL, 0) == 0)
+	{
+		delete sph;
+		return;
+	}
+	double init=std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+	uint init_particle=sph->num_particle;
+
+	start=std::chrono::steady_clock::now();
+	sph->sys_running=1;
+	while(sph->sim_time < sim_time)
+	{
+		sph->animation();
+	}
+	double wall=std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+
+	printf("%-10s %10s %10s %10s %10s\n", "particles", "init_s", "sim_s", "wall_s", "final");
+	printf("%-10u %10.3f %10.2f %10.3f %10u\n", init_particle, init, sph->sim_time, wall, sph->num_particle);
+
+	delete sph;
+}
+
+static SPHSystem *load_text(const char *text)
+{
+	const char *file="bench_text.scene";
+	SPHSystem *sph=new SPHSystem();
+	FILE *fp;
+
+	fp=fopen(file, "w");
+	if(fp == NULL)
+	{
+		delete sph;
+		return NULL;
+	}
+	fputs(text, fp);
+	fclose(fp);
+
+	if(sph->load_scene(file, NULL, 0) == 0)
+	{
+		delete sph;
+		sph=NULL;
+	}
+	remove(file);
+
+	return sph;
+}
+
+/** Runs a scene for sim_time, then compares the density of every particle
+ ** from the cell grid with an all pairs sum, minimum image on periodic
+ ** axes. Boundary particles are off so both sums cover the same terms.
+ */
+
+static void check_hash(const char *name, const char *text, float sim_time)
+{
+	SPHSystem *sph=load_text(text);
+	float3 rel_pos;
+	float r2;
+	double dens;
+	double err;
+	double max_err=0.0;
+	uint wrong=0;
+
+	if(sph == NULL)
+	{
+		printf("%-12s cannot load\n", name);
+		return;
+	}
+
+	sph->bound_part=0;
+	sph->sys_running=1;
+	while(sph->sim_time < sim_time)
+	{
+		sph->animation();
+	}
+
+	sph->build_table();
+	sph->comp_dens_pres();
+
+	for(uint i=0; i<sph->num_particle; i++)
+	{
+		dens=sph->self_dens;
+		for(uint j=0; j<sph->num_particle; j++)
+		{
+			rel_pos.x=sph->mem[j].pos.x-sph->mem[i].pos.x;
+			rel_pos.y=sph->mem[j].pos.y-sph->mem[i].pos.y;
+			rel_pos.z=sph->mem[j].pos.z-sph->mem[i].pos.z;
+			rel_pos.x=sph->periodic.x ? rel_pos.x-sph->world_size.x*floor(rel_pos.x/sph->world_size.x+0.5f) : rel_pos.x;
+			rel_pos.y=sph->periodic.y ? rel_pos.y-sph->world_size.y*floor(rel_pos.y/sph->world_size.y+0.5f) : rel_pos.y;
+			rel_pos.z=sph->periodic.z ? rel_pos.z-sph->world_size.z*floor(rel_pos.z/sph->world_size.z+0.5f) : rel_pos.z;
+			r2=rel_pos.x*rel_pos.x+rel_pos.y*rel_pos.y+rel_pos.z*rel_pos.z;
+
+			if(r2 > INF && r2 < sph->kernel_2)
+			{
+				dens+=sph->mass*sph->w_dens.value(r2);
+			}
+		}
+
+		err=fabs(sph->mem[i].dens-dens)/dens;
+		max_err=err > max_err ? err : max_err;
+		wrong+=err > 1e-4;
+	}
+
+	printf("%-12s %6u %6u %6u %10u %10u %12.3e %s\n", name, sph->grid_size.x, sph->grid_size.y, sph->grid_size.z, sph->num_particle, wrong, max_err, wrong == 0 ? "ok" : "FAIL");
+
+	delete sph;
+}
+
+static void bench_hash(float sim_time)
+{
+	printf("%-12s %6s %6s %6s %10s %10s %12s\n", "case", "gx", "gy", "gz", "particles", "wrong", "max_rel_err");
+
+	check_hash("periodic_10", "world_size 0.39 0.64 0.39\nperiodic 1 0 1\nbox 0.0 0.0 0.0 0.4 0.3 0.4\n", sim_time);
+	check_hash("periodic_12", "world_size 0.47 0.64 0.47\nperiodic 1 0 1\nbox 0.0 0.0 0.0 0.48 0.3 0.48\n", sim_time);
+	check_hash("kernel_13", "kernel 0.05\nworld_size 0.64 0.64 0.64\nbox 0.0 0.0 0.0 0.3 0.3 0.3\n", sim_time);
+	check_hash("past_world", "box 0.0 0.0 0.0 0.7 0.2 0.7\n", sim_time);
+}
+
+/** A thin fast jet falling into a wide shallow pool, the case block time
+ ** steps are meant for: only the particles in and around the jet need the
+ ** small steps. feval counts force evaluations, mean_y is there to see that
+ ** both ways of stepping end up in about the same state.
+ */
+
+static const char *jet_scene=
+	"world_size 0.64 0.64 0.64\n"
+	"box 0.0 0.0 0.0 0.64 0.16 0.64\n"
+	"emitter 0.32 0.56 0.32 0.0 -3.0 0.0 0.03\n";
+
+static void bench_block(float sim_time)
+{
+	char text[512];
+
+	printf("%-8s %-10s %10s %10s %10s %12s %10s %12s\n", "step", "integrator", "sim_s", "particles", "substeps", "feval", "mean_y", "wall_per_s");
+
+	for(uint integrator=0; integrator<NUM_INTEGRATOR; integrator++)
+	{
+		for(uint block=0; block<2; block++)
+		{
+			sprintf(text, "%sblock_step %u\nintegrator %u\n", jet_scene, block, integrator);
+			SPHSystem *sph=load_text(text);
+			if(sph == NULL)
+			{
+				return;
+			}
+
+			sph->sys_running=1;
+			std::chrono::steady_clock::time_point start=std::chrono::steady_clock::now();
+			while(sph->sim_time < sim_time)
+			{
+				sph->animation();
+			}
+			double wall=std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+
+			double mean_y=0.0;
+			for(uint i=0; i<sph->num_particle; i++)
+			{
+				mean_y+=sph->mem[i].pos.y;
+			}
+			mean_y/=sph->num_particle;
+
+			printf("%-8s %-10s %10.2f %10u %10u %12u %10.4f %12.3f\n", block ? "block" : "global", integrator_name[integrator], sph->sim_time, sph->num_particle, sph->tot_step, sph->tot_force_eval, mean_y, wall/sph->sim_time);
+
+			delete sph;
+		}
+	}
+}
+
+int main(int argc, char **argv)
+{
+	if(argc > 1 && strcmp(argv[1], "dt") == 0)
+	{
+		bench_dt(argc > 2 ? (float)atof(argv[2]) : 1.0f);
+		return 0;
+	}
+
+	if(argc > 1 && strcmp(argv[1], "sleep") == 0)
+	{
+		bench_sleep(argc > 2 ? (float)atof(argv[2]) : 10.0f);
+		return 0;
+	}
+
+	if(argc > 1 && strcmp(argv[1], "adapt") == 0)
+	{
+		bench_adapt(argc > 2 ? (float)atof(argv[2]) : 3.0f);
+		return 0;
+	}
+
+	if(argc > 1 && strcmp(argv[1], "relax") == 0)
+	{
+		bench_relax(argc > 2 ? (float)atof(argv[2]) : 1.0f);
+		return 0;
+	}
+
+	if(argc > 1 && strcmp(argv[1], "frame") == 0)
+	{
+		bench_frame(argc > 2 ? (float)atof(argv[2]) : 2.0f);
+		return 0;
+	}
+
+	if(argc > 1 && strcmp(argv[1], "async") == 0)
+	{
+		bench_async(argc > 2 ? (float)atof(argv[2]) : 2.0f);
+		return 0;
+	}
+
+	if(argc > 1 && strcmp(argv[1], "profile") == 0)
+	{
+		bench_profile(argc > 2 ? (float)atof(argv[2]) : 1.0f);
+		return 0;
+	}
+
+	if(argc > 1 && strcmp(argv[1], "hash") == 0)
+	{
+		bench_hash(argc > 2 ? (float)atof(argv[2]) : 0.2f);
+		return 0;
+	}
+
+	if(argc > 1 && strcmp(argv[1], "block") == 0)
+	{
+		bench_block(argc > 2 ? (float)atof(argv[2]) : 2.0f);
+		return 0;
+	}
+
+	if(argc > 1 && strcmp(argv[1], "export") == 0)
+	{
+		bench_export(argc > 2 ? (float)atof(argv[2]) : 1.0f, argc > 3 ? argv[3] : NULL);
+		return 0;
+	}
+
+	if(argc > 2 && strcmp(argv[1], "scene") == 0)
+	{
+		bench_scene(argv[2], argc > 3 ? (float)atof(argv[3]) : 0.0f);
+		return 0;
+	}
+
+	bench_solver(argc > 1 ? (float)atof(argv[1]) : 2.0f);
+
+	return 0;
+}
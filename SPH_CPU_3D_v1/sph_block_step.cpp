@@ -0,0 +1,248 @@
+/** File:		sph_block_step.cpp
+ ** Author:		Dongli Zhang
+ ** Contact:	dongli.zhang0129@gmail.com
+ **
+ ** Copyright (C) Dongli Zhang 2013
+ **
+ ** This program is free software;  you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+ ** the GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program;  if not, write to the Free Software
+ ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "sph_system.h"
+#include "sph_header.h"
+
+/** Block hierarchical individual time steps for the WCSPH path.
+ **
+ ** A cycle is 2^max_level substeps of the global (finest) dt, which is only
+ ** picked at the start of a cycle. A particle on level l takes steps of
+ ** dt*2^l and starts one whenever block_count is a multiple of 2^l. Every
+ ** substep the grid and the densities are rebuilt for all particles so
+ ** inactive neighbors are seen at their drifted positions, but forces are
+ ** only evaluated for the particles starting a step. Those receive the kick
+ ** of their whole step up front, everybody drifts with the current velocity.
+ ** With the leapfrog integrator the kick is half of the particle's previous
+ ** step plus half of the new one, kept in last_step, so the velocity sits at
+ ** the middle of each particle's own step like in advection().
+ **
+ ** New levels are picked when a particle starts a step, from its own CFL and
+ ** force limits, only to coarser levels the counter is aligned to, and never
+ ** more than one level coarser than any neighbor.
+ **
+ ** Cycles run across frame boundaries, so a frame ends on the first substep
+ ** past frame_time and the overshoot is taken off the next frame.
+ */
+
+void SPHSystem::block_animation()
+{
+	float elapsed=block_carry;
+	uint cycle=1<<max_level;
+
+	wake_all();
+	adapt_refine();
+
+	frame_step=0;
+	while(elapsed < frame_time)
+	{
+		if(block_count == 0)
+		{
+			time_step=comp_time_step();
+		}
+
+		block_substep(block_count);
+		block_count=(block_count+1)%cycle;
+
+		elapsed+=time_step;
+		frame_step++;
+		tot_step++;
+	}
+
+	block_carry=elapsed-frame_time;
+}
+
+void SPHSystem::block_substep(uint count)
+{
+	Particle *p;
+
+	build_table();
+	comp_dens_pres();
+
+	num_active=0;
+	for(uint i=0; i<num_particle; i++)
+	{
+		p=&(mem[i]);
+		p->active=(count & ((1<<p->level)-1)) == 0;
+		num_active+=p->active;
+	}
+
+	block_active=1;
+	comp_force_adv(1);
+	block_active=0;
+
+	block_level(count);
+	block_advection();
+
+	tot_force_eval+=num_active;
+}
+
+void SPHSystem::block_level(uint count)
+{
+	Particle *p;
+	Particle *np;
+
+	int3 cell_pos;
+	int3 near_pos;
+	uint hash;
+
+	float3 a;
+	float v;
+	float acc;
+	float dt;
+	uint level;
+	uint near_level;
+
+	for(uint i=0; i<num_particle; i++)
+	{
+		p=&(mem[i]);
+
+		if(p->active == 0)
+		{
+			continue;
+		}
+
+		a.x=p->acc.x/p->dens+gravity.x;
+		a.y=p->acc.y/p->dens+gravity.y;
+		a.z=p->acc.z/p->dens+gravity.z;
+		v=sqrt(p->vel.x*p->vel.x+p->vel.y*p->vel.y+p->vel.z*p->vel.z);
+		acc=sqrt(a.x*a.x+a.y*a.y+a.z*a.z);
+
+		dt=max_time_step;
+		if(v > INF)
+		{
+			dt=fmin(dt, cfl_factor*kernel/v);
+		}
+		if(acc > INF)
+		{
+			dt=fmin(dt, force_factor*sqrt(kernel/acc));
+		}
+
+		level=0;
+		while(level < max_level && time_step*(2<<level) <= dt && (count & ((2<<level)-1)) == 0)
+		{
+			level++;
+		}
+
+		near_level=max_level;
+		cell_pos=calc_cell_pos(p->pos);
+		for(int x=-1; x<=1; x++)
+		{
+			for(int y=-1; y<=1; y++)
+			{
+				for(int z=-1; z<=1; z++)
+				{
+					near_pos.x=cell_pos.x+x;
+					near_pos.y=cell_pos.y+y;
+					near_pos.z=cell_pos.z+z;
+					hash=calc_cell_hash(near_pos);
+
+					if(hash == 0xffffffff)
+					{
+						continue;
+					}
+
+					for(np=cell[hash]; np != NULL; np=np->next)
+					{
+						if(np->level < near_level)
+						{
+							near_level=np->level;
+						}
+					}
+				}
+			}
+		}
+
+		if(level > near_level+1)
+		{
+			level=near_level+1;
+		}
+
+		p->level=level;
+	}
+}
+
+void SPHSystem::block_advection()
+{
+	Particle *p;
+	float3 a;
+	float step;
+	float kick;
+	float v2;
+	float a2;
+	float max_v2=0.0f;
+	float max_a2=0.0f;
+
+	uint leapfrog=(integrator == INTEGRATOR_LEAPFROG);
+
+	prof.begin(PHASE_ADVECT);
+
+	for(uint i=0; i<num_particle; i++)
+	{
+		p=&(mem[i]);
+
+		a.x=p->acc.x/p->dens+gravity.x;
+		a.y=p->acc.y/p->dens+gravity.y;
+		a.z=p->acc.z/p->dens+gravity.z;
+
+		if(p->active)
+		{
+			step=time_step*(1<<p->level);
+			kick=leapfrog ? 0.5f*(p->last_step+step) : step;
+
+			p->vel.x=p->vel.x+a.x*kick;
+			p->vel.y=p->vel.y+a.y*kick;
+			p->vel.z=p->vel.z+a.z*kick;
+
+			if(leapfrog)
+			{
+				p->ev.x=p->vel.x+a.x*step*0.5f;
+				p->ev.y=p->vel.y+a.y*step*0.5f;
+				p->ev.z=p->vel.z+a.z*step*0.5f;
+			}
+			else
+			{
+				p->ev.x=(p->ev.x+p->vel.x)/2;
+				p->ev.y=(p->ev.y+p->vel.y)/2;
+				p->ev.z=(p->ev.z+p->vel.z)/2;
+			}
+
+			p->last_step=leapfrog ? step : 0.0f;
+		}
+
+		p->pos.x=p->pos.x+p->vel.x*time_step;
+		p->pos.y=p->pos.y+p->vel.y*time_step;
+		p->pos.z=p->pos.z+p->vel.z*time_step;
+
+		bound_particle(p);
+
+		v2=p->vel.x*p->vel.x+p->vel.y*p->vel.y+p->vel.z*p->vel.z;
+		max_v2=v2 > max_v2 ? v2 : max_v2;
+
+		a2=a.x*a.x+a.y*a.y+a.z*a.z;
+		max_a2=a2 > max_a2 ? a2 : max_a2;
+	}
+
+	max_vel=sqrt(max_v2);
+	max_acc=sqrt(max_a2);
+
+	prof.end(PHASE_ADVECT);
+}
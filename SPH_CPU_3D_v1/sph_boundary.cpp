@@ -0,0 +1,339 @@
+/** File:		sph_boundary.cpp
+ ** Author:		Dongli Zhang
+ ** Contact:	dongli.zhang0129@gmail.com
+ **
+ ** Copyright (C) Dongli Zhang 2013
+ **
+ ** This program is free software;  you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+ ** the GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program;  if not, write to the Free Software
+ ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "sph_system.h"
+#include "sph_header.h"
+
+/** Boundary particles for the walls of the box, after Akinci et al. 2012.
+ **
+ ** A single layer is sampled one lattice spacing outside the box, where the
+ ** next fluid layer would be. Each boundary particle b gets the volume
+ ** V_b=1/sum_k W(x_b-x_k) over its boundary neighbors, so a dense patch of
+ ** wall does not push harder than a sparse one, and stands in for the fluid
+ ** with psi_b=lattice_density*V_b:
+ **
+ **   dens_i += sum_b psi_b W(x_i-x_b)
+ **   f_i    -= sum_b psi_b/dens_i * pres_i * grad W(x_i-x_b)
+ **
+ ** plus the viscosity term against a wall at rest. The pressure is mirrored
+ ** from the fluid particle and never pulls it onto the wall.
+ **
+ ** The walls never move, so the particles are sorted by cell once, in
+ ** init_boundary(), and bound_start[hash] indexes the static grid like
+ ** nb_start does for the neighbor list. The outside layer is binned in the
+ ** border cells, which is safe since clamping a cell coordinate never moves
+ ** it away from a cell inside the grid. Particles more than a kernel away
+ ** from the layer skip the lookup. The wall clamps in advection() stay as a
+ ** last resort.
+ **
+ ** Only WCSPH uses the layer. DFSPH and IISPH keep their own stiffness in
+ ** pres and solve against the fluid alone, and PBF moves positions, so
+ ** comp_force_adv() adds bound_force() with the pressure force only and
+ ** those solvers stop at the clamps. Obstacles are clamped the same way for
+ ** every solver.
+ **
+ ** A periodic axis has no walls, so there the layer only closes the other
+ ** axes and wraps across the seam like the fluid does. set_periodic()
+ ** samples it again.
+ */
+
+void SPHSystem::init_boundary()
+{
+	float spacing=kernel*0.5f;
+	int3 num;
+	int3 lo;
+	int3 hi;
+	int3 cell_pos;
+	int3 near_pos;
+	uint hash;
+	uint index;
+
+	float3 *pos;
+	uint *pos_hash;
+
+	float3 rel_pos;
+	float r2;
+	float sum;
+
+	num.x=(int)(world_size.x/spacing+0.5f);
+	num.y=(int)(world_size.y/spacing+0.5f);
+	num.z=(int)(world_size.z/spacing+0.5f);
+
+	lo.x=periodic.x ? 0 : -1;
+	lo.y=periodic.y ? 0 : -1;
+	lo.z=periodic.z ? 0 : -1;
+	hi.x=periodic.x ? num.x-1 : num.x+1;
+	hi.y=periodic.y ? num.y-1 : num.y+1;
+	hi.z=periodic.z ? num.z-1 : num.z+1;
+
+	bound_min.x=periodic.x ? -kernel : -spacing;
+	bound_min.y=periodic.y ? -kernel : -spacing;
+	bound_min.z=periodic.z ? -kernel : -spacing;
+	bound_max.x=periodic.x ? world_size.x+kernel : (num.x+1)*spacing;
+	bound_max.y=periodic.y ? world_size.y+kernel : (num.y+1)*spacing;
+	bound_max.z=periodic.z ? world_size.z+kernel : (num.z+1)*spacing;
+
+	num_bound=(hi.x-lo.x+1)*(hi.y-lo.y+1)*(hi.z-lo.z+1);
+	num_bound-=(periodic.x ? num.x : num.x+1)*(periodic.y ? num.y : num.y+1)*(periodic.z ? num.z : num.z+1);
+	pos=(float3 *)malloc(sizeof(float3)*num_bound);
+	pos_hash=(uint *)malloc(sizeof(uint)*num_bound);
+
+	free(bound_pos);
+	free(bound_psi);
+	free(bound_start);
+	bound_pos=(float3 *)malloc(sizeof(float3)*num_bound);
+	bound_psi=(float *)malloc(sizeof(float)*num_bound);
+	bound_start=(uint *)malloc(sizeof(uint)*(tot_cell+1));
+
+	for(uint i=0; i<=tot_cell; i++)
+	{
+		bound_start[i]=0;
+	}
+
+	index=0;
+	for(int x=lo.x; x<=hi.x; x++)
+	{
+		for(int y=lo.y; y<=hi.y; y++)
+		{
+			for(int z=lo.z; z<=hi.z; z++)
+			{
+				if(x > -1 && x < num.x+1 && y > -1 && y < num.y+1 && z > -1 && z < num.z+1)
+				{
+					continue;
+				}
+
+				pos[index].x=x*spacing;
+				pos[index].y=y*spacing;
+				pos[index].z=z*spacing;
+
+				cell_pos=bound_cell_pos(pos[index]);
+				hash=calc_cell_hash(cell_pos);
+				pos_hash[index]=hash;
+				bound_start[hash+1]++;
+
+				index++;
+			}
+		}
+	}
+
+	for(uint i=0; i<tot_cell; i++)
+	{
+		bound_start[i+1]+=bound_start[i];
+	}
+
+	for(uint i=0; i<num_bound; i++)
+	{
+		hash=pos_hash[i];
+		bound_pos[bound_start[hash]]=pos[i];
+		bound_start[hash]++;
+	}
+
+	for(uint i=tot_cell; i>0; i--)
+	{
+		bound_start[i]=bound_start[i-1];
+	}
+	bound_start[0]=0;
+
+	for(uint i=0; i<num_bound; i++)
+	{
+		cell_pos=bound_cell_pos(bound_pos[i]);
+		sum=0.0f;
+
+		for(int x=-1; x<=1; x++)
+		{
+			for(int y=-1; y<=1; y++)
+			{
+				for(int z=-1; z<=1; z++)
+				{
+					near_pos.x=cell_pos.x+x;
+					near_pos.y=cell_pos.y+y;
+					near_pos.z=cell_pos.z+z;
+					hash=calc_cell_hash(near_pos);
+
+					if(hash == 0xffffffff)
+					{
+						continue;
+					}
+
+					for(uint j=bound_start[hash]; j<bound_start[hash+1]; j++)
+					{
+						rel_pos.x=bound_pos[j].x-bound_pos[i].x;
+						rel_pos.y=bound_pos[j].y-bound_pos[i].y;
+						rel_pos.z=bound_pos[j].z-bound_pos[i].z;
+						wrap_rel(rel_pos);
+						r2=rel_pos.x*rel_pos.x+rel_pos.y*rel_pos.y+rel_pos.z*rel_pos.z;
+
+						if(r2 < kernel_2)
+						{
+							sum+=w_dens.value(r2);
+						}
+					}
+				}
+			}
+		}
+
+		bound_psi[i]=lattice_density/sum;
+	}
+
+	free(pos);
+	free(pos_hash);
+
+	printf("Boundary Particle: %u\n", num_bound);
+}
+
+int3 SPHSystem::bound_cell_pos(float3 pos)
+{
+	int3 cell_pos=calc_cell_pos(pos);
+
+	cell_pos.x=cell_pos.x < 0 ? 0 : (cell_pos.x >= (int)grid_size.x ? (int)grid_size.x-1 : cell_pos.x);
+	cell_pos.y=cell_pos.y < 0 ? 0 : (cell_pos.y >= (int)grid_size.y ? (int)grid_size.y-1 : cell_pos.y);
+	cell_pos.z=cell_pos.z < 0 ? 0 : (cell_pos.z >= (int)grid_size.z ? (int)grid_size.z-1 : cell_pos.z);
+
+	return cell_pos;
+}
+
+uint SPHSystem::bound_far(float3 pos)
+{
+	return pos.x-bound_min.x >= kernel && bound_max.x-pos.x >= kernel
+		&& pos.y-bound_min.y >= kernel && bound_max.y-pos.y >= kernel
+		&& pos.z-bound_min.z >= kernel && bound_max.z-pos.z >= kernel;
+}
+
+float SPHSystem::bound_dens(Particle *p)
+{
+	int3 cell_pos;
+	int3 near_pos;
+	uint hash;
+
+	float3 rel_pos;
+	float r2;
+	float dens=0.0f;
+
+	if(bound_far(p->pos))
+	{
+		return dens;
+	}
+
+	cell_pos=calc_cell_pos(p->pos);
+
+	for(int x=-1; x<=1; x++)
+	{
+		for(int y=-1; y<=1; y++)
+		{
+			for(int z=-1; z<=1; z++)
+			{
+				near_pos.x=cell_pos.x+x;
+				near_pos.y=cell_pos.y+y;
+				near_pos.z=cell_pos.z+z;
+				hash=calc_cell_hash(near_pos);
+
+				if(hash == 0xffffffff)
+				{
+					continue;
+				}
+
+				for(uint j=bound_start[hash]; j<bound_start[hash+1]; j++)
+				{
+					rel_pos.x=bound_pos[j].x-p->pos.x;
+					rel_pos.y=bound_pos[j].y-p->pos.y;
+					rel_pos.z=bound_pos[j].z-p->pos.z;
+					wrap_rel(rel_pos);
+					r2=rel_pos.x*rel_pos.x+rel_pos.y*rel_pos.y+rel_pos.z*rel_pos.z;
+
+					if(r2 < kernel_2)
+					{
+						dens+=bound_psi[j]*w_dens.value(r2);
+					}
+				}
+			}
+		}
+	}
+
+	return dens;
+}
+
+void SPHSystem::bound_force(Particle *p)
+{
+	int3 cell_pos;
+	int3 near_pos;
+	uint hash;
+
+	float3 rel_pos;
+	float r2;
+	float r;
+	float V;
+
+	float pres=fmax(p->pres, 0.0f);
+	float temp_force;
+
+	if(bound_far(p->pos))
+	{
+		return;
+	}
+
+	cell_pos=calc_cell_pos(p->pos);
+
+	for(int x=-1; x<=1; x++)
+	{
+		for(int y=-1; y<=1; y++)
+		{
+			for(int z=-1; z<=1; z++)
+			{
+				near_pos.x=cell_pos.x+x;
+				near_pos.y=cell_pos.y+y;
+				near_pos.z=cell_pos.z+z;
+				hash=calc_cell_hash(near_pos);
+
+				if(hash == 0xffffffff)
+				{
+					continue;
+				}
+
+				for(uint j=bound_start[hash]; j<bound_start[hash+1]; j++)
+				{
+					rel_pos.x=p->pos.x-bound_pos[j].x;
+					rel_pos.y=p->pos.y-bound_pos[j].y;
+					rel_pos.z=p->pos.z-bound_pos[j].z;
+					wrap_rel(rel_pos);
+					r2=rel_pos.x*rel_pos.x+rel_pos.y*rel_pos.y+rel_pos.z*rel_pos.z;
+
+					if(r2 >= kernel_2 || r2 <= INF)
+					{
+						continue;
+					}
+
+					r=sqrt(r2);
+					V=bound_psi[j]/p->dens;
+
+					temp_force=V * pres * w_pres.grad(r);
+					p->acc.x=p->acc.x-rel_pos.x*temp_force/r;
+					p->acc.y=p->acc.y-rel_pos.y*temp_force/r;
+					p->acc.z=p->acc.z-rel_pos.z*temp_force/r;
+
+					temp_force=V/2 * viscosity * w_visc.lplc(r);
+					p->acc.x=p->acc.x-p->ev.x*temp_force;
+					p->acc.y=p->acc.y-p->ev.y*temp_force;
+					p->acc.z=p->acc.z-p->ev.z*temp_force;
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,388 @@
+/** File:		sph_checkpoint.cpp
+ ** Author:		Dongli Zhang
+ ** Contact:	dongli.zhang0129@gmail.com
+ **
+ ** Copyright (C) Dongli Zhang 2013
+ **
+ ** This program is free software;  you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+ ** the GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program;  if not, write to the Free Software
+ ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "sph_system.h"
+#include "sph_header.h"
+#include <string.h>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+/** Checkpoint and restart.
+ **
+ ** save_checkpoint() writes <file>.tmp, flushes it to disk and renames it
+ ** over <file>, so a crash while saving leaves the previous checkpoint in
+ ** place. load_checkpoint() maps the file and copies the particles straight
+ ** from the mapping into mem, which is the only copy of the data; the page
+ ** cache is read ahead sequentially. Without mmap (Windows) the file is
+ ** read into a buffer first. Both arrays have to lie inside the file before
+ ** anything is copied, so a truncated or corrupt header is rejected rather
+ ** than read past the end of the mapping.
+ **
+ ** Obstacles are not part of the checkpoint and have to be added again
+ ** before loading.
+ */
+
+static const char checkpoint_magic[4]={'S', 'P', 'H', 'C'};
+
+static unsigned long long checkpoint_align(unsigned long long offset)
+{
+	return (offset+CHECKPOINT_ALIGN-1)/CHECKPOINT_ALIGN*CHECKPOINT_ALIGN;
+}
+
+static uint write_pad(FILE *fp, unsigned long long from, unsigned long long to)
+{
+	char zero[CHECKPOINT_ALIGN];
+
+	memset(zero, 0, sizeof(zero));
+	return to == from || fwrite(zero, 1, (size_t)(to-from), fp) == to-from;
+}
+
+uint SPHSystem::save_checkpoint(const char *file)
+{
+	TraceScope trace("checkpoint");
+	CheckpointHeader h;
+	char *tmp;
+	FILE *fp;
+	uint ok;
+
+	memset(&h, 0, sizeof(h));
+	pack_checkpoint(&h);
+
+	tmp=(char *)malloc(strlen(file)+5);
+	sprintf(tmp, "%s.tmp", file);
+
+	fp=fopen(tmp, "wb");
+	if(fp == NULL)
+	{
+		printf("Cannot write checkpoint: %s\n", tmp);
+		free(tmp);
+		return 0;
+	}
+
+	ok=fwrite(&h, sizeof(h), 1, fp) == 1
+		&& write_pad(fp, sizeof(h), h.particle_offset)
+		&& fwrite(mem, sizeof(Particle), num_particle, fp) == num_particle
+		&& write_pad(fp, h.particle_offset+(unsigned long long)num_particle*sizeof(Particle), h.cell_offset)
+		&& fwrite(cell_quiet, sizeof(uint), tot_cell, fp) == tot_cell
+		&& fflush(fp) == 0;
+
+#ifdef _WIN32
+	ok=ok && _commit(_fileno(fp)) == 0;
+#else
+	ok=ok && fsync(fileno(fp)) == 0;
+#endif
+
+	ok=(fclose(fp) == 0) && ok;
+
+#ifdef _WIN32
+	if(ok)
+	{
+		remove(file);
+	}
+#endif
+
+	if(ok == 0 || rename(tmp, file) != 0)
+	{
+		printf("Cannot write checkpoint: %s\n", file);
+		remove(tmp);
+		free(tmp);
+		return 0;
+	}
+
+	free(tmp);
+	return 1;
+}
+
+uint SPHSystem::load_checkpoint(const char *file)
+{
+	const CheckpointHeader *h;
+	const char *data;
+	unsigned long long size;
+	uint ok;
+
+#ifdef _WIN32
+	FILE *fp=fopen(file, "rb");
+	char *buf;
+
+	if(fp == NULL)
+	{
+		printf("Cannot read checkpoint: %s\n", file);
+		return 0;
+	}
+
+	fseek(fp, 0, SEEK_END);
+	size=(unsigned long long)ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+
+	buf=(char *)malloc((size_t)size);
+	ok=fread(buf, 1, (size_t)size, fp) == size;
+	fclose(fp);
+
+	if(ok == 0)
+	{
+		printf("Cannot read checkpoint: %s\n", file);
+		free(buf);
+		return 0;
+	}
+	data=buf;
+#else
+	struct stat st;
+	void *map;
+	int fd=open(file, O_RDONLY);
+
+	if(fd < 0 || fstat(fd, &st) != 0 || st.st_size == 0)
+	{
+		printf("Cannot read checkpoint: %s\n", file);
+		if(fd >= 0)
+		{
+			close(fd);
+		}
+		return 0;
+	}
+
+	size=(unsigned long long)st.st_size;
+	map=mmap(NULL, (size_t)size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if(map == MAP_FAILED)
+	{
+		printf("Cannot map checkpoint: %s\n", file);
+		return 0;
+	}
+	madvise(map, (size_t)size, MADV_SEQUENTIAL);
+	data=(const char *)map;
+#endif
+
+	h=(const CheckpointHeader *)data;
+	ok=size >= sizeof(CheckpointHeader)
+		&& memcmp(h->magic, checkpoint_magic, sizeof(checkpoint_magic)) == 0
+		&& h->version == CHECKPOINT_VERSION
+		&& h->header_size == sizeof(CheckpointHeader)
+		&& h->particle_size == sizeof(Particle)
+		&& h->file_size <= size;
+
+	if(ok == 0)
+	{
+		printf("Not a version %u checkpoint of this build: %s\n", CHECKPOINT_VERSION, file);
+	}
+	else if(h->particle_offset > size || h->num_particle > (size-h->particle_offset)/sizeof(Particle)
+		|| h->cell_offset > size || h->tot_cell > (size-h->cell_offset)/sizeof(uint))
+	{
+		printf("Checkpoint is truncated or corrupt: %s\n", file);
+		ok=0;
+	}
+	else if(h->kernel != kernel || h->mass != mass || h->cell_size != cell_size || h->tot_cell != tot_cell
+		|| h->grid_size.x != grid_size.x || h->grid_size.y != grid_size.y || h->grid_size.z != grid_size.z)
+	{
+		printf("Checkpoint kernel or grid does not match: %s\n", file);
+		ok=0;
+	}
+
+	if(ok)
+	{
+		unpack_checkpoint(h);
+
+		reserve_particle(h->num_particle);
+		memcpy(mem, data+h->particle_offset, sizeof(Particle)*h->num_particle);
+		memcpy(cell_quiet, data+h->cell_offset, sizeof(uint)*tot_cell);
+		num_particle=h->num_particle;
+
+		num_sleep=0;
+		num_coarse=0;
+		next_id=0;
+		for(uint i=0; i<num_particle; i++)
+		{
+			num_sleep+=mem[i].sleep;
+			num_coarse+=mem[i].res_level > 0;
+			next_id=mem[i].id >= next_id ? mem[i].id+1 : next_id;
+		}
+
+		build_table();
+		sample_rate=0;
+	}
+
+#ifdef _WIN32
+	free(buf);
+#else
+	munmap(map, (size_t)size);
+#endif
+
+	return ok;
+}
+
+void SPHSystem::reserve_particle(uint num)
+{
+	if(num <= max_particle)
+	{
+		return;
+	}
+
+	max_particle=num;
+	mem=(Particle *)realloc(mem, sizeof(Particle)*max_particle);
+	nb_start=(uint *)realloc(nb_start, sizeof(uint)*(max_particle+1));
+}
+
+void SPHSystem::pack_checkpoint(CheckpointHeader *h)
+{
+	memcpy(h->magic, checkpoint_magic, sizeof(checkpoint_magic));
+	h->version=CHECKPOINT_VERSION;
+	h->header_size=sizeof(CheckpointHeader);
+	h->particle_size=sizeof(Particle);
+
+	h->num_particle=num_particle;
+	h->tot_cell=tot_cell;
+	h->grid_size=grid_size;
+	h->periodic=periodic;
+	h->cell_size=cell_size;
+	h->world_size=world_size;
+	h->kernel=kernel;
+	h->mass=mass;
+
+	h->gravity=gravity;
+	h->wall_damping=wall_damping;
+	h->rest_density=rest_density;
+	h->gas_constant=gas_constant;
+	h->viscosity=viscosity;
+	h->surf_norm=surf_norm;
+	h->surf_coe=surf_coe;
+
+	h->integrator=integrator;
+	h->adaptive_step=adaptive_step;
+	h->time_step=time_step;
+	h->last_time_step=last_time_step;
+	h->frame_time=frame_time;
+	h->min_time_step=min_time_step;
+	h->max_time_step=max_time_step;
+	h->max_implicit_step=max_implicit_step;
+	h->cfl_factor=cfl_factor;
+	h->force_factor=force_factor;
+	h->visc_factor=visc_factor;
+	h->max_vel=max_vel;
+	h->max_acc=max_acc;
+
+	h->solver_mode=solver_mode;
+	h->min_iter=min_iter;
+	h->max_iter=max_iter;
+	h->max_dens_err=max_dens_err;
+	h->jacobi_omega=jacobi_omega;
+	h->pbf_iter=pbf_iter;
+	h->pbf_relax=pbf_relax;
+	h->pbf_scorr=pbf_scorr;
+	h->pbf_scorr_dq=pbf_scorr_dq;
+	h->pbf_xsph_coe=pbf_xsph_coe;
+	h->max_div_err=max_div_err;
+	h->max_div_iter=max_div_iter;
+
+	h->block_step=block_step;
+	h->max_level=max_level;
+	h->block_count=block_count;
+	h->block_carry=block_carry;
+	h->sleeping=sleeping;
+	h->sleep_vel=sleep_vel;
+	h->sleep_dens=sleep_dens;
+	h->sleep_steps=sleep_steps;
+	h->adaptive_res=adaptive_res;
+	h->adapt_max_level=adapt_max_level;
+	h->adapt_depth=adapt_depth;
+	h->adapt_interval=adapt_interval;
+	h->bound_part=bound_part;
+	h->obstacle_margin=obstacle_margin;
+
+	h->tot_step=tot_step;
+	h->tot_iter=tot_iter;
+	h->tot_force_eval=tot_force_eval;
+	h->sim_time=sim_time;
+
+	h->particle_offset=checkpoint_align(sizeof(CheckpointHeader));
+	h->cell_offset=checkpoint_align(h->particle_offset+(unsigned long long)num_particle*sizeof(Particle));
+	h->file_size=h->cell_offset+(unsigned long long)tot_cell*sizeof(uint);
+}
+
+void SPHSystem::unpack_checkpoint(const CheckpointHeader *h)
+{
+	if(h->periodic.x != periodic.x || h->periodic.y != periodic.y || h->periodic.z != periodic.z)
+	{
+		set_periodic(h->periodic.x, h->periodic.y, h->periodic.z);
+	}
+	world_size=h->world_size;
+
+	gravity=h->gravity;
+	wall_damping=h->wall_damping;
+	rest_density=h->rest_density;
+	gas_constant=h->gas_constant;
+	viscosity=h->viscosity;
+	surf_norm=h->surf_norm;
+	surf_coe=h->surf_coe;
+
+	integrator=h->integrator;
+	adaptive_step=h->adaptive_step;
+	time_step=h->time_step;
+	last_time_step=h->last_time_step;
+	frame_time=h->frame_time;
+	min_time_step=h->min_time_step;
+	max_time_step=h->max_time_step;
+	max_implicit_step=h->max_implicit_step;
+	cfl_factor=h->cfl_factor;
+	force_factor=h->force_factor;
+	visc_factor=h->visc_factor;
+	max_vel=h->max_vel;
+	max_acc=h->max_acc;
+
+	solver_mode=h->solver_mode;
+	min_iter=h->min_iter;
+	max_iter=h->max_iter;
+	max_dens_err=h->max_dens_err;
+	jacobi_omega=h->jacobi_omega;
+	pbf_iter=h->pbf_iter;
+	pbf_relax=h->pbf_relax;
+	pbf_scorr=h->pbf_scorr;
+	pbf_scorr_dq=h->pbf_scorr_dq;
+	pbf_xsph_coe=h->pbf_xsph_coe;
+	max_div_err=h->max_div_err;
+	max_div_iter=h->max_div_iter;
+
+	block_step=h->block_step;
+	max_level=h->max_level;
+	block_count=h->block_count;
+	block_carry=h->block_carry;
+	sleeping=h->sleeping;
+	sleep_vel=h->sleep_vel;
+	sleep_dens=h->sleep_dens;
+	sleep_steps=h->sleep_steps;
+	adaptive_res=h->adaptive_res;
+	adapt_max_level=h->adapt_max_level;
+	adapt_depth=h->adapt_depth;
+	adapt_interval=h->adapt_interval;
+	bound_part=h->bound_part;
+	obstacle_margin=h->obstacle_margin;
+
+	tot_step=h->tot_step;
+	tot_iter=h->tot_iter;
+	tot_force_eval=h->tot_force_eval;
+	sim_time=h->sim_time;
+}
@@ -0,0 +1,119 @@
+/** File:		sph_checkpoint.h
+ ** Author:		Dongli Zhang
+ ** Contact:	dongli.zhang0129@gmail.com
+ **
+ ** Copyright (C) Dongli Zhang 2013
+ **
+ ** This program is free software;  you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+ ** the GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program;  if not, write to the Free Software
+ ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef __SPHCHECKPOINT_H__
+#define __SPHCHECKPOINT_H__
+
+#include "sph_type.h"
+
+#define CHECKPOINT_VERSION 4
+#define CHECKPOINT_ALIGN 64
+
+/** Checkpoint file layout:
+ **
+ **   CheckpointHeader
+ **   Particle[num_particle]     at particle_offset
+ **   uint cell_quiet[tot_cell]  at cell_offset
+ **
+ ** Both arrays start on a CHECKPOINT_ALIGN boundary. The particles are
+ ** stored as they are in memory, so a checkpoint only loads into a build
+ ** with the same version, header_size and particle_size, and into a system
+ ** with the same kernel, mass and grid. The next pointers are meaningless
+ ** on disk and rebuilt on load.
+ */
+
+struct CheckpointHeader
+{
+	char magic[4];
+	uint version;
+	uint header_size;
+	uint particle_size;
+
+	uint num_particle;
+	uint tot_cell;
+	uint3 grid_size;
+	uint3 periodic;
+	float cell_size;
+	float3 world_size;
+	float kernel;
+	float mass;
+
+	float3 gravity;
+	float wall_damping;
+	float rest_density;
+	float gas_constant;
+	float viscosity;
+	float surf_norm;
+	float surf_coe;
+
+	uint integrator;
+	uint adaptive_step;
+	float time_step;
+	float last_time_step;
+	float frame_time;
+	float min_time_step;
+	float max_time_step;
+	float max_implicit_step;
+	float cfl_factor;
+	float force_factor;
+	float visc_factor;
+	float max_vel;
+	float max_acc;
+
+	uint solver_mode;
+	uint min_iter;
+	uint max_iter;
+	float max_dens_err;
+	float jacobi_omega;
+	uint pbf_iter;
+	float pbf_relax;
+	float pbf_scorr;
+	float pbf_scorr_dq;
+	float pbf_xsph_coe;
+	float max_div_err;
+	uint max_div_iter;
+
+	uint block_step;
+	uint max_level;
+	uint block_count;
+	float block_carry;
+	uint sleeping;
+	float sleep_vel;
+	float sleep_dens;
+	uint sleep_steps;
+	uint adaptive_res;
+	uint adapt_max_level;
+	uint adapt_depth;
+	uint adapt_interval;
+	uint bound_part;
+	float obstacle_margin;
+
+	uint tot_step;
+	uint tot_iter;
+	uint tot_force_eval;
+	float sim_time;
+
+	unsigned long long particle_offset;
+	unsigned long long cell_offset;
+	unsigned long long file_size;
+};
+
+#endif
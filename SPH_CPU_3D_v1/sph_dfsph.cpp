@@ -0,0 +1,256 @@
+/** File:		sph_dfsph.cpp
+ ** Author:		Dongli Zhang
+ ** Contact:	dongli.zhang0129@gmail.com
+ **
+ ** Copyright (C) Dongli Zhang 2013
+ **
+ ** This program is free software;  you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+ ** the GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program;  if not, write to the Free Software
+ ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "sph_system.h"
+#include "sph_header.h"
+
+/** Divergence-free SPH, Bender and Koschier 2015.
+ **
+ ** The density and the per-particle factor alpha are computed in a single
+ ** sweep over the neighbor list. Two solvers then share dfsph_kappa_vel():
+ ** the divergence solver drives Drho/Dt to zero on the current velocity,
+ ** the constant density solver drives the predicted density to
+ ** lattice_density on the predicted velocity. The stiffness kappa of each
+ ** iteration is kept in pres.
+ **
+ ** Walls and obstacles are only the clamps in bound_particle(), bound_part
+ ** is ignored here, see sph_boundary.cpp.
+ */
+
+void SPHSystem::dfsph_step()
+{
+	Particle *p;
+
+	build_neighbor();
+	prof.begin(PHASE_DENS);
+	dfsph_dens_alpha();
+	prof.end(PHASE_DENS);
+	comp_force_adv(0);
+
+	prof.begin(PHASE_PRESSURE);
+	if(tot_step > 0)
+	{
+		dfsph_div_solve();
+	}
+
+	for(uint i=0; i<num_particle; i++)
+	{
+		p=&(mem[i]);
+		p->pred_vel.x=p->vel.x+(p->acc.x/p->dens+gravity.x)*time_step;
+		p->pred_vel.y=p->vel.y+(p->acc.y/p->dens+gravity.y)*time_step;
+		p->pred_vel.z=p->vel.z+(p->acc.z/p->dens+gravity.z)*time_step;
+	}
+
+	dfsph_dens_solve();
+	prof.end(PHASE_PRESSURE);
+
+	for(uint i=0; i<num_particle; i++)
+	{
+		p=&(mem[i]);
+		p->acc.x=((p->pred_vel.x-p->vel.x)/time_step-gravity.x)*p->dens;
+		p->acc.y=((p->pred_vel.y-p->vel.y)/time_step-gravity.y)*p->dens;
+		p->acc.z=((p->pred_vel.z-p->vel.z)/time_step-gravity.z)*p->dens;
+	}
+
+	advection();
+}
+
+void SPHSystem::dfsph_dens_alpha()
+{
+	Particle *p;
+	Particle *np;
+
+	float3 rel_pos;
+	float3 sum_grad;
+	float sum_grad2;
+	float r2;
+	float r;
+	float grad;
+	float denom;
+
+	for(uint i=0; i<num_particle; i++)
+	{
+		p=&(mem[i]);
+
+		p->dens=self_dens;
+		p->pres=0.0f;
+		p->pres_acc.x=0.0f;
+		p->pres_acc.y=0.0f;
+		p->pres_acc.z=0.0f;
+
+		sum_grad.x=0.0f;
+		sum_grad.y=0.0f;
+		sum_grad.z=0.0f;
+		sum_grad2=0.0f;
+
+		for(uint j=nb_start[i]; j<nb_start[i+1]; j++)
+		{
+			np=&(mem[nb_list[j]]);
+
+			rel_pos.x=p->pos.x-np->pos.x;
+			rel_pos.y=p->pos.y-np->pos.y;
+			rel_pos.z=p->pos.z-np->pos.z;
+			wrap_rel(rel_pos);
+			r2=rel_pos.x*rel_pos.x+rel_pos.y*rel_pos.y+rel_pos.z*rel_pos.z;
+			r=sqrt(r2);
+
+			p->dens+=mass*w_dens.value(r2);
+
+			grad=mass*w_pres.grad(r)/r;
+			sum_grad.x+=grad*rel_pos.x;
+			sum_grad.y+=grad*rel_pos.y;
+			sum_grad.z+=grad*rel_pos.z;
+			sum_grad2+=grad*grad*r2;
+		}
+
+		denom=sum_grad.x*sum_grad.x+sum_grad.y*sum_grad.y+sum_grad.z*sum_grad.z+sum_grad2;
+		p->alpha=denom > INF ? p->dens/denom : 0.0f;
+	}
+}
+
+void SPHSystem::dfsph_div_solve()
+{
+	Particle *p;
+
+	for(uint i=0; i<num_particle; i++)
+	{
+		p=&(mem[i]);
+		p->pred_vel=p->vel;
+	}
+
+	div_iter=0;
+	do
+	{
+		div_err=dfsph_dens_adv(true);
+		dfsph_kappa_vel(1.0f/time_step);
+		div_iter++;
+	}
+	while(div_err > max_div_err && div_iter < max_div_iter);
+
+	for(uint i=0; i<num_particle; i++)
+	{
+		p=&(mem[i]);
+		p->vel=p->pred_vel;
+	}
+}
+
+void SPHSystem::dfsph_dens_solve()
+{
+	solver_iter=0;
+	do
+	{
+		solver_err=dfsph_dens_adv(false);
+		dfsph_kappa_vel(1.0f/(time_step*time_step));
+		solver_iter++;
+	}
+	while((solver_err > max_dens_err || solver_iter < min_iter) && solver_iter < max_iter);
+}
+
+float SPHSystem::dfsph_dens_adv(bool div)
+{
+	Particle *p;
+	Particle *np;
+
+	float3 rel_pos;
+	float r;
+	float grad;
+	float div_vel;
+	float tot_err=0.0f;
+
+	for(uint i=0; i<num_particle; i++)
+	{
+		p=&(mem[i]);
+		div_vel=0.0f;
+
+		for(uint j=nb_start[i]; j<nb_start[i+1]; j++)
+		{
+			np=&(mem[nb_list[j]]);
+
+			rel_pos.x=p->pos.x-np->pos.x;
+			rel_pos.y=p->pos.y-np->pos.y;
+			rel_pos.z=p->pos.z-np->pos.z;
+			wrap_rel(rel_pos);
+			r=sqrt(rel_pos.x*rel_pos.x+rel_pos.y*rel_pos.y+rel_pos.z*rel_pos.z);
+
+			grad=mass*w_pres.grad(r)/r;
+			div_vel+=grad*((p->pred_vel.x-np->pred_vel.x)*rel_pos.x
+							+(p->pred_vel.y-np->pred_vel.y)*rel_pos.y
+							+(p->pred_vel.z-np->pred_vel.z)*rel_pos.z);
+		}
+
+		if(div)
+		{
+			p->dens_adv=fmax(div_vel, 0.0f);
+			p->pres=p->dens_adv*p->alpha;
+			tot_err+=p->dens_adv*time_step;
+		}
+		else
+		{
+			p->dens_adv=fmax(p->dens+time_step*div_vel, lattice_density);
+			p->pres=(p->dens_adv-lattice_density)*p->alpha;
+			tot_err+=p->dens_adv-lattice_density;
+		}
+	}
+
+	return num_particle > 0 ? tot_err/num_particle/lattice_density : 0.0f;
+}
+
+void SPHSystem::dfsph_kappa_vel(float scale)
+{
+	Particle *p;
+	Particle *np;
+
+	float3 rel_pos;
+	float r;
+	float temp;
+
+	for(uint i=0; i<num_particle; i++)
+	{
+		p=&(mem[i]);
+
+		for(uint j=nb_start[i]; j<nb_start[i+1]; j++)
+		{
+			np=&(mem[nb_list[j]]);
+
+			rel_pos.x=p->pos.x-np->pos.x;
+			rel_pos.y=p->pos.y-np->pos.y;
+			rel_pos.z=p->pos.z-np->pos.z;
+			wrap_rel(rel_pos);
+			r=sqrt(rel_pos.x*rel_pos.x+rel_pos.y*rel_pos.y+rel_pos.z*rel_pos.z);
+
+			temp=time_step*scale*mass*(p->pres/p->dens+np->pres/np->dens)*w_pres.grad(r)/r;
+			p->pres_acc.x-=temp*rel_pos.x;
+			p->pres_acc.y-=temp*rel_pos.y;
+			p->pres_acc.z-=temp*rel_pos.z;
+		}
+	}
+
+	for(uint i=0; i<num_particle; i++)
+	{
+		p=&(mem[i]);
+		p->pred_vel.x+=p->pres_acc.x;
+		p->pred_vel.y+=p->pres_acc.y;
+		p->pred_vel.z+=p->pres_acc.z;
+		p->pres_acc.x=0.0f;
+		p->pres_acc.y=0.0f;
+		p->pres_acc.z=0.0f;
+	}
+}
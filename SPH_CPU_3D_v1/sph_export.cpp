@@ -0,0 +1,214 @@
+/** File:		sph_export.cpp
+ ** Author:		Dongli Zhang
+ ** Contact:	dongli.zhang0129@gmail.com
+ **
+ ** Copyright (C) Dongli Zhang 2013
+ **
+ ** This program is free software;  you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+ ** the GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program;  if not, write to the Free Software
+ ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "sph_system.h"
+#include "sph_header.h"
+#include <string.h>
+
+/** Filtered exports for monitoring.
+ **
+ ** A region is looked up in the cell table instead of scanning mem: only
+ ** the cells overlapping the box or the sphere's bounds are walked, plus one
+ ** cell around them since the table is from the start of the last step and
+ ** a particle moves less than a cell per step. The table is rebuilt first
+ ** if particles were added or removed since then. Every cell in the range
+ ** has its own list, so each particle is met once. The indices are sorted
+ ** so consecutive frames list the particles in the same order.
+ **
+ ** Sampling keeps a particle when a hash of its id falls in one of sample
+ ** buckets, so the same particles are picked every frame. The picked
+ ** indices are cached with their ids. The next call checks that each cached
+ ** index still holds the same id and only scans the particles appended
+ ** since, so a steady run pays for the sample and not for mem. The merges
+ ** and the cell sort of adaptive resolution move particles and trip the
+ ** check, which rescans.
+ **
+ ** select_particle() returns NULL when every particle is selected, which
+ ** FrameWriter::write() and AsyncWriter::submit() take as all of mem.
+ */
+
+static uint export_hash(uint id)
+{
+	id^=id >> 16;
+	id*=0x7feb352d;
+	id^=id >> 15;
+	id*=0x846ca68b;
+	id^=id >> 16;
+
+	return id;
+}
+
+static int compare_index(const void *a, const void *b)
+{
+	uint x=*(const uint *)a;
+	uint y=*(const uint *)b;
+
+	return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+const uint *SPHSystem::select_particle(const ExportFilter *filter, uint *num)
+{
+	if(filter->region == EXPORT_BOX || filter->region == EXPORT_SPHERE)
+	{
+		*num=select_region(filter);
+		return export_index;
+	}
+
+	if(filter->sample > 1)
+	{
+		*num=select_sample(filter->sample);
+		return sample_index;
+	}
+
+	*num=num_particle;
+	return NULL;
+}
+
+uint SPHSystem::select_region(const ExportFilter *filter)
+{
+	float3 lo;
+	float3 hi;
+	int3 cell_lo;
+	int3 cell_hi;
+	int3 cell_pos;
+	float3 rel_pos;
+	float r2=filter->radius*filter->radius;
+	uint inside;
+	uint hash;
+	uint num=0;
+	Particle *p;
+
+	if(filter->region == EXPORT_SPHERE)
+	{
+		lo.x=filter->center.x-filter->radius;
+		lo.y=filter->center.y-filter->radius;
+		lo.z=filter->center.z-filter->radius;
+		hi.x=filter->center.x+filter->radius;
+		hi.y=filter->center.y+filter->radius;
+		hi.z=filter->center.z+filter->radius;
+	}
+	else
+	{
+		lo=filter->lo;
+		hi=filter->hi;
+	}
+
+	if(table_mem != mem || table_num != num_particle)
+	{
+		build_table();
+	}
+
+	cell_lo=calc_cell_pos(lo);
+	cell_hi=calc_cell_pos(hi);
+	cell_lo.x=cell_lo.x-1 > 0 ? cell_lo.x-1 : 0;
+	cell_lo.y=cell_lo.y-1 > 0 ? cell_lo.y-1 : 0;
+	cell_lo.z=cell_lo.z-1 > 0 ? cell_lo.z-1 : 0;
+	cell_hi.x=cell_hi.x+1 < (int)grid_size.x-1 ? cell_hi.x+1 : (int)grid_size.x-1;
+	cell_hi.y=cell_hi.y+1 < (int)grid_size.y-1 ? cell_hi.y+1 : (int)grid_size.y-1;
+	cell_hi.z=cell_hi.z+1 < (int)grid_size.z-1 ? cell_hi.z+1 : (int)grid_size.z-1;
+
+	for(cell_pos.z=cell_lo.z; cell_pos.z<=cell_hi.z; cell_pos.z++)
+	{
+		for(cell_pos.y=cell_lo.y; cell_pos.y<=cell_hi.y; cell_pos.y++)
+		{
+			for(cell_pos.x=cell_lo.x; cell_pos.x<=cell_hi.x; cell_pos.x++)
+			{
+				hash=calc_cell_hash(cell_pos);
+				if(hash == 0xffffffff)
+				{
+					continue;
+				}
+
+				for(p=cell[hash]; p != NULL; p=p->next)
+				{
+					if(filter->region == EXPORT_SPHERE)
+					{
+						rel_pos.x=p->pos.x-filter->center.x;
+						rel_pos.y=p->pos.y-filter->center.y;
+						rel_pos.z=p->pos.z-filter->center.z;
+						inside=rel_pos.x*rel_pos.x+rel_pos.y*rel_pos.y+rel_pos.z*rel_pos.z <= r2;
+					}
+					else
+					{
+						inside=p->pos.x >= lo.x && p->pos.x <= hi.x
+							&& p->pos.y >= lo.y && p->pos.y <= hi.y
+							&& p->pos.z >= lo.z && p->pos.z <= hi.z;
+					}
+
+					if(inside == 0 || (filter->sample > 1 && export_hash(p->id)%filter->sample != 0))
+					{
+						continue;
+					}
+
+					if(num == max_export)
+					{
+						max_export=max_export > 0 ? max_export*2 : 1024;
+						export_index=(uint *)realloc(export_index, sizeof(uint)*max_export);
+					}
+					export_index[num]=(uint)(p-mem);
+					num++;
+				}
+			}
+		}
+	}
+
+	qsort(export_index, num, sizeof(uint), compare_index);
+
+	return num;
+}
+
+uint SPHSystem::select_sample(uint sample)
+{
+	uint valid=sample == sample_rate && sample_scan <= num_particle;
+
+	for(uint i=0; i<num_sample && valid; i++)
+	{
+		valid=sample_index[i] < num_particle && mem[sample_index[i]].id == sample_id[i];
+	}
+
+	if(valid == 0)
+	{
+		num_sample=0;
+		sample_scan=0;
+		sample_rate=sample;
+	}
+
+	for(uint i=sample_scan; i<num_particle; i++)
+	{
+		if(export_hash(mem[i].id)%sample != 0)
+		{
+			continue;
+		}
+
+		if(num_sample == max_sample)
+		{
+			max_sample=max_sample > 0 ? max_sample*2 : 1024;
+			sample_index=(uint *)realloc(sample_index, sizeof(uint)*max_sample);
+			sample_id=(uint *)realloc(sample_id, sizeof(uint)*max_sample);
+		}
+		sample_index[num_sample]=i;
+		sample_id[num_sample]=mem[i].id;
+		num_sample++;
+	}
+	sample_scan=num_particle;
+
+	return num_sample;
+}
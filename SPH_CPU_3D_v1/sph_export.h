@@ -0,0 +1,47 @@
+/** File:		sph_export.h
+ ** Author:		Dongli Zhang
+ ** Contact:	dongli.zhang0129@gmail.com
+ **
+ ** Copyright (C) Dongli Zhang 2013
+ **
+ ** This program is free software;  you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+ ** the GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program;  if not, write to the Free Software
+ ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef __SPHEXPORT_H__
+#define __SPHEXPORT_H__
+
+#include "sph_type.h"
+
+enum ExportRegion
+{
+	EXPORT_ALL=0,
+	EXPORT_BOX=1,
+	EXPORT_SPHERE=2
+};
+
+/** Which particles an export writes: the ones inside the box lo..hi or the
+ ** sphere at center, and of those one in every sample by id. sample 0 or 1
+ ** keeps them all. */
+struct ExportFilter
+{
+	uint region;
+	float3 lo;
+	float3 hi;
+	float3 center;
+	float radius;
+	uint sample;
+};
+
+#endif
@@ -0,0 +1,871 @@
+/** File:		sph_frame.cpp
+ ** Author:		Dongli Zhang
+ ** Contact:	dongli.zhang0129@gmail.com
+ **
+ ** Copyright (C) Dongli Zhang 2013
+ **
+ ** This program is free software;  you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+ ** the GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program;  if not, write to the Free Software
+ ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "sph_frame.h"
+#include "sph_system.h"
+#include "sph_header.h"
+#include <string.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#endif
+
+/** Compressed frame sequences.
+ **
+ ** The selected components (pos xyz, vel xyz, dens) are quantized and
+ ** stored one component after the other. Each value is replaced by its
+ ** difference to the prediction and zigzag mapped to an unsigned integer z.
+ ** The bit length of z is coded with an adaptive binary range coder, in the
+ ** style of LZMA, as a 6 bit tree conditioned on the component and on the
+ ** bit length of the value before; the bits of z below its leading one
+ ** follow uncoded. The models start fresh every frame.
+ **
+ ** A frame is a key frame every key_interval frames and whenever the
+ ** number of particles changes, since merging and splitting move particles
+ ** in mem. Seeking reads the index and decodes at most key_interval frames
+ ** from the key frame on, or just the next frame when playing forward.
+ **
+ ** The reader maps the file and decodes straight from the mapping, with the
+ ** next prefetch frames requested ahead of time. Without mmap (Windows) each
+ ** frame is read into a buffer first.
+ */
+
+#define NUM_COMPONENT 7
+#define LEN_SYMBOL 64
+#define LEN_CONTEXT 33
+
+#define RC_TOP (1u<<24)
+#define RC_BITS 11
+#define RC_MOVE 5
+
+static const char frame_magic[4]={'S', 'P', 'H', 'F'};
+
+struct RangeEncoder
+{
+	unsigned long long low;
+	uint range;
+	unsigned char cache;
+	unsigned long long cache_size;
+	unsigned char *out;
+	size_t size;
+};
+
+struct RangeDecoder
+{
+	const unsigned char *in;
+	const unsigned char *end;
+	uint range;
+	uint code;
+};
+
+static void rc_shift_low(RangeEncoder *rc)
+{
+	if((uint)rc->low < 0xFF000000u || (rc->low>>32) != 0)
+	{
+		unsigned char carry=(unsigned char)(rc->low>>32);
+		unsigned char temp=rc->cache;
+
+		do
+		{
+			rc->out[rc->size++]=(unsigned char)(temp+carry);
+			temp=0xFF;
+		}
+		while(--rc->cache_size != 0);
+
+		rc->cache=(unsigned char)(rc->low>>24);
+	}
+
+	rc->cache_size++;
+	rc->low=(rc->low & 0x00FFFFFFu)<<8;
+}
+
+static void rc_encode_bit(RangeEncoder *rc, unsigned short *prob, uint bit)
+{
+	uint bound=(rc->range>>RC_BITS)*(*prob);
+
+	if(bit == 0)
+	{
+		rc->range=bound;
+		*prob+=((1<<RC_BITS)-*prob)>>RC_MOVE;
+	}
+	else
+	{
+		rc->low+=bound;
+		rc->range-=bound;
+		*prob-=*prob>>RC_MOVE;
+	}
+
+	while(rc->range < RC_TOP)
+	{
+		rc->range<<=8;
+		rc_shift_low(rc);
+	}
+}
+
+static void rc_encode_direct(RangeEncoder *rc, uint value, uint count)
+{
+	while(count > 0)
+	{
+		count--;
+		rc->range>>=1;
+		if((value>>count) & 1)
+		{
+			rc->low+=rc->range;
+		}
+
+		while(rc->range < RC_TOP)
+		{
+			rc->range<<=8;
+			rc_shift_low(rc);
+		}
+	}
+}
+
+static unsigned char rc_next(RangeDecoder *rc)
+{
+	return rc->in < rc->end ? *(rc->in++) : 0;
+}
+
+static uint rc_decode_bit(RangeDecoder *rc, unsigned short *prob)
+{
+	uint bound=(rc->range>>RC_BITS)*(*prob);
+	uint bit;
+
+	if(rc->code < bound)
+	{
+		rc->range=bound;
+		*prob+=((1<<RC_BITS)-*prob)>>RC_MOVE;
+		bit=0;
+	}
+	else
+	{
+		rc->code-=bound;
+		rc->range-=bound;
+		*prob-=*prob>>RC_MOVE;
+		bit=1;
+	}
+
+	while(rc->range < RC_TOP)
+	{
+		rc->range<<=8;
+		rc->code=(rc->code<<8) | rc_next(rc);
+	}
+
+	return bit;
+}
+
+static uint rc_decode_direct(RangeDecoder *rc, uint count)
+{
+	uint value=0;
+
+	while(count > 0)
+	{
+		count--;
+		rc->range>>=1;
+		value<<=1;
+		if(rc->code >= rc->range)
+		{
+			rc->code-=rc->range;
+			value|=1;
+		}
+
+		while(rc->range < RC_TOP)
+		{
+			rc->range<<=8;
+			rc->code=(rc->code<<8) | rc_next(rc);
+		}
+	}
+
+	return value;
+}
+
+static void reset_model(unsigned short *prob)
+{
+	for(uint i=0; i<NUM_COMPONENT*LEN_CONTEXT*LEN_SYMBOL; i++)
+	{
+		prob[i]=1<<(RC_BITS-1);
+	}
+}
+
+static uint bit_length(uint z)
+{
+	uint len=0;
+
+	while(len < 32 && (z>>len) != 0)
+	{
+		len++;
+	}
+
+	return len;
+}
+
+/** value is a whole component, pred the same component of the frame before
+ ** or NULL for a key frame. */
+static void encode_component(RangeEncoder *rc, unsigned short *prob, const int *value, const int *pred, uint num)
+{
+	uint diff;
+	uint z;
+	uint len;
+	uint ctx=0;
+	uint node;
+
+	for(uint i=0; i<num; i++)
+	{
+		diff=(uint)value[i]-(uint)(pred != NULL ? pred[i] : (i > 0 ? value[i-1] : 0));
+		z=(diff<<1)^(uint)((int)diff>>31);
+		len=bit_length(z);
+
+		node=1;
+		for(int b=5; b>=0; b--)
+		{
+			uint bit=(len>>b) & 1;
+			rc_encode_bit(rc, &(prob[ctx*LEN_SYMBOL+node]), bit);
+			node=(node<<1) | bit;
+		}
+
+		if(len > 1)
+		{
+			rc_encode_direct(rc, z, len-1);
+		}
+
+		ctx=len;
+	}
+}
+
+/** Decodes in place: value holds the frame before unless it is a key frame.
+ ** A length above 32 can't come from encode_component(), the file is corrupt. */
+static uint decode_component(RangeDecoder *rc, unsigned short *prob, int *value, uint key, uint num)
+{
+	uint z;
+	uint len;
+	uint ctx=0;
+	uint node;
+	uint diff;
+
+	for(uint i=0; i<num; i++)
+	{
+		node=1;
+		for(int b=0; b<6; b++)
+		{
+			node=(node<<1) | rc_decode_bit(rc, &(prob[ctx*LEN_SYMBOL+node]));
+		}
+		len=node-LEN_SYMBOL;
+
+		if(len > 32)
+		{
+			return 0;
+		}
+
+		z=len;
+		if(len > 1)
+		{
+			z=(1u<<(len-1)) | rc_decode_direct(rc, len-1);
+		}
+
+		diff=(z>>1)^(0u-(z & 1));
+		value[i]=(int)((uint)(key ? (i > 0 ? value[i-1] : 0) : value[i])+diff);
+		ctx=len;
+	}
+
+	return 1;
+}
+
+static int frame_seek(FILE *fp, unsigned long long offset)
+{
+#ifdef _WIN32
+	return _fseeki64(fp, (__int64)offset, SEEK_SET);
+#else
+	return fseeko(fp, (off_t)offset, SEEK_SET);
+#endif
+}
+
+#ifdef _WIN32
+static unsigned long long frame_file_size(FILE *fp)
+{
+	_fseeki64(fp, 0, SEEK_END);
+	return (unsigned long long)_ftelli64(fp);
+}
+#endif
+
+static int quantize_value(float value, float quant)
+{
+	return (int)floor(value/quant+0.5f);
+}
+
+uint frame_components(uint attrib)
+{
+	return ((attrib & FRAME_POS) ? 3 : 0)+((attrib & FRAME_VEL) ? 3 : 0)+((attrib & FRAME_DENS) ? 1 : 0);
+}
+
+FrameWriter::FrameWriter()
+{
+	attrib=FRAME_POS;
+	pos_quant=0.0001f;
+	vel_quant=0.001f;
+	dens_quant=0.1f;
+	key_interval=30;
+
+	num_frame=0;
+	tot_bytes=0;
+	tot_particle=0;
+
+	fp=NULL;
+	index=NULL;
+	max_frame=0;
+	last_key=0;
+
+	memset(&cur, 0, sizeof(cur));
+	memset(&last, 0, sizeof(last));
+
+	buf=NULL;
+	max_buf=0;
+}
+
+FrameWriter::~FrameWriter()
+{
+	close();
+
+	free(index);
+	free(cur.value);
+	free(last.value);
+	free(buf);
+}
+
+uint FrameWriter::open(const char *file, float3 world_size, float kernel, float mass)
+{
+	close();
+
+	if(frame_components(attrib) == 0 || key_interval == 0)
+	{
+		printf("No frame attributes selected\n");
+		return 0;
+	}
+
+	fp=fopen(file, "wb");
+	if(fp == NULL)
+	{
+		printf("Cannot write frames: %s\n", file);
+		return 0;
+	}
+
+	memset(&head, 0, sizeof(head));
+	memcpy(head.magic, frame_magic, sizeof(frame_magic));
+	head.version=FRAME_VERSION;
+	head.header_size=sizeof(FrameFileHeader);
+	head.attrib=attrib;
+	head.world_size=world_size;
+	head.kernel=kernel;
+	head.mass=mass;
+	head.pos_quant=pos_quant;
+	head.vel_quant=vel_quant;
+	head.dens_quant=dens_quant;
+	head.key_interval=key_interval;
+
+	num_frame=0;
+	tot_bytes=0;
+	tot_particle=0;
+	last.num_particle=0;
+
+	if(fwrite(&head, sizeof(head), 1, fp) != 1)
+	{
+		printf("Cannot write frames: %s\n", file);
+		fclose(fp);
+		fp=NULL;
+		return 0;
+	}
+
+	return 1;
+}
+
+/** index, when not NULL, lists the particles of mem to write, so a filtered
+ ** export never copies them. */
+uint FrameWriter::write(const Particle *mem, const uint *index, uint num_particle, float time)
+{
+	quantize(mem, index, num_particle, time, &cur);
+	return encode(&cur);
+}
+
+void FrameWriter::quantize(const Particle *mem, const uint *index, uint num_particle, float time, FrameBuffer *frame)
+{
+	uint comps=frame_components(head.attrib);
+	const Particle *p;
+	int *value;
+	uint c;
+
+	if(comps*num_particle > frame->max_value)
+	{
+		frame->max_value=comps*num_particle;
+		frame->value=(int *)realloc(frame->value, sizeof(int)*frame->max_value);
+	}
+	frame->num_particle=num_particle;
+	frame->time=time;
+	value=frame->value;
+
+	for(uint i=0; i<num_particle; i++)
+	{
+		p=index != NULL ? &(mem[index[i]]) : &(mem[i]);
+		c=0;
+
+		if(head.attrib & FRAME_POS)
+		{
+			value[c*num_particle+i]=quantize_value(p->pos.x, head.pos_quant);
+			value[(c+1)*num_particle+i]=quantize_value(p->pos.y, head.pos_quant);
+			value[(c+2)*num_particle+i]=quantize_value(p->pos.z, head.pos_quant);
+			c+=3;
+		}
+
+		if(head.attrib & FRAME_VEL)
+		{
+			value[c*num_particle+i]=quantize_value(p->vel.x, head.vel_quant);
+			value[(c+1)*num_particle+i]=quantize_value(p->vel.y, head.vel_quant);
+			value[(c+2)*num_particle+i]=quantize_value(p->vel.z, head.vel_quant);
+			c+=3;
+		}
+
+		if(head.attrib & FRAME_DENS)
+		{
+			value[c*num_particle+i]=quantize_value(p->dens, head.dens_quant);
+		}
+	}
+}
+
+/** Codes a quantized frame and swaps it with the last one, which the caller
+ ** gets back to fill next. */
+uint FrameWriter::encode(FrameBuffer *frame)
+{
+	unsigned short prob[NUM_COMPONENT*LEN_CONTEXT*LEN_SYMBOL];
+	RangeEncoder rc;
+	uint comps=frame_components(head.attrib);
+	uint num_particle=frame->num_particle;
+	uint key;
+	FrameBuffer swap;
+
+	if(fp == NULL)
+	{
+		return 0;
+	}
+
+	if((size_t)comps*num_particle*10+64 > max_buf)
+	{
+		max_buf=(size_t)comps*num_particle*10+64;
+		buf=(unsigned char *)realloc(buf, max_buf);
+	}
+
+	if(num_frame == max_frame)
+	{
+		max_frame=max_frame == 0 ? 256 : max_frame*2;
+		index=(FrameIndex *)realloc(index, sizeof(FrameIndex)*max_frame);
+	}
+
+	key=num_frame == 0 || num_frame-last_key >= head.key_interval || num_particle != last.num_particle;
+	if(key)
+	{
+		last_key=num_frame;
+	}
+
+	reset_model(prob);
+	rc.low=0;
+	rc.range=0xFFFFFFFFu;
+	rc.cache=0;
+	rc.cache_size=1;
+	rc.out=buf;
+	rc.size=0;
+
+	for(uint c=0; c<comps; c++)
+	{
+		encode_component(&rc, prob+c*LEN_CONTEXT*LEN_SYMBOL, frame->value+c*num_particle, key ? NULL : last.value+c*num_particle, num_particle);
+	}
+
+	for(uint i=0; i<5; i++)
+	{
+		rc_shift_low(&rc);
+	}
+
+	index[num_frame].offset=head.header_size+tot_bytes;
+	index[num_frame].size=(uint)rc.size;
+	index[num_frame].num_particle=num_particle;
+	index[num_frame].key_frame=last_key;
+	index[num_frame].time=frame->time;
+
+	if(fwrite(buf, 1, rc.size, fp) != rc.size)
+	{
+		printf("Cannot write frame %u\n", num_frame);
+		return 0;
+	}
+
+	swap=*frame;
+	*frame=last;
+	last=swap;
+
+	num_frame++;
+	tot_bytes+=rc.size;
+	tot_particle+=num_particle;
+
+	return 1;
+}
+
+uint FrameWriter::close()
+{
+	FrameFooter foot;
+	uint ok;
+
+	if(fp == NULL)
+	{
+		return 0;
+	}
+
+	memset(&foot, 0, sizeof(foot));
+	foot.index_offset=head.header_size+tot_bytes;
+	foot.num_frame=num_frame;
+	memcpy(foot.magic, frame_magic, sizeof(frame_magic));
+
+	ok=(num_frame == 0 || fwrite(index, sizeof(FrameIndex), num_frame, fp) == num_frame)
+		&& fwrite(&foot, sizeof(foot), 1, fp) == 1;
+	ok=(fclose(fp) == 0) && ok;
+	fp=NULL;
+
+	printf("Frames: %u, %.3f bytes per particle per frame (%u raw)\n", num_frame, bytes_per_particle(), frame_components(head.attrib)*(uint)sizeof(float));
+
+	return ok;
+}
+
+float FrameWriter::bytes_per_particle()
+{
+	return tot_particle > 0 ? (float)((double)tot_bytes/tot_particle) : 0.0f;
+}
+
+FrameReader::FrameReader()
+{
+	memset(&head, 0, sizeof(head));
+	index=NULL;
+	num_frame=0;
+	prefetch=8;
+
+	frame=0;
+	num_particle=0;
+	time=0.0f;
+	pos=NULL;
+	vel=NULL;
+	dens=NULL;
+
+	data=NULL;
+	size=0;
+	cur=NULL;
+	cur_frame=0xffffffff;
+	max_value=0;
+
+	fp=NULL;
+	buf=NULL;
+	max_buf=0;
+}
+
+FrameReader::~FrameReader()
+{
+	close();
+}
+
+uint FrameReader::open(const char *file)
+{
+	FrameFooter foot;
+
+	close();
+
+#ifdef _WIN32
+	fp=fopen(file, "rb");
+	if(fp == NULL)
+	{
+		printf("Cannot read frames: %s\n", file);
+		return 0;
+	}
+	size=frame_file_size(fp);
+#else
+	struct stat st;
+	void *map;
+	int fd=::open(file, O_RDONLY);
+
+	if(fd < 0 || fstat(fd, &st) != 0 || st.st_size == 0)
+	{
+		printf("Cannot read frames: %s\n", file);
+		if(fd >= 0)
+		{
+			::close(fd);
+		}
+		return 0;
+	}
+
+	size=(unsigned long long)st.st_size;
+	map=mmap(NULL, (size_t)size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+
+	if(map == MAP_FAILED)
+	{
+		printf("Cannot map frames: %s\n", file);
+		size=0;
+		return 0;
+	}
+	data=(const unsigned char *)map;
+#endif
+
+	if(size < sizeof(head)+sizeof(foot)
+		|| read_at(0, &head, sizeof(head)) == 0 || read_at(size-sizeof(foot), &foot, sizeof(foot)) == 0
+		|| memcmp(head.magic, frame_magic, sizeof(frame_magic)) != 0 || memcmp(foot.magic, frame_magic, sizeof(frame_magic)) != 0
+		|| head.version != FRAME_VERSION || head.header_size != sizeof(FrameFileHeader)
+		|| foot.index_offset+(unsigned long long)foot.num_frame*sizeof(FrameIndex)+sizeof(foot) != size)
+	{
+		printf("Not a version %u frame file: %s\n", FRAME_VERSION, file);
+		close();
+		return 0;
+	}
+
+	num_frame=foot.num_frame;
+	index=(FrameIndex *)malloc(sizeof(FrameIndex)*(num_frame > 0 ? num_frame : 1));
+	if(read_at(foot.index_offset, index, sizeof(FrameIndex)*num_frame) == 0)
+	{
+		printf("Cannot read frame index: %s\n", file);
+		close();
+		return 0;
+	}
+
+	for(uint i=0; i<num_frame; i++)
+	{
+		if(index[i].offset+index[i].size > foot.index_offset || index[i].key_frame > i)
+		{
+			printf("Corrupt frame index: %s\n", file);
+			close();
+			return 0;
+		}
+	}
+
+	prefetch_after(0);
+
+	return 1;
+}
+
+uint FrameReader::seek(uint frame)
+{
+	uint start;
+	uint c;
+
+	if(index == NULL || frame >= num_frame)
+	{
+		return 0;
+	}
+
+	start=index[frame].key_frame;
+	if(cur_frame != 0xffffffff && cur_frame <= frame && cur_frame >= start)
+	{
+		start=cur_frame+1;
+	}
+
+	for(uint k=start; k<=frame; k++)
+	{
+		if(decode(k) == 0)
+		{
+			cur_frame=0xffffffff;
+			return 0;
+		}
+		cur_frame=k;
+	}
+	prefetch_after(frame);
+
+	this->frame=frame;
+	num_particle=index[frame].num_particle;
+	time=index[frame].time;
+
+	c=0;
+	if(head.attrib & FRAME_POS)
+	{
+		for(uint i=0; i<num_particle; i++)
+		{
+			pos[i].x=cur[c*num_particle+i]*head.pos_quant;
+			pos[i].y=cur[(c+1)*num_particle+i]*head.pos_quant;
+			pos[i].z=cur[(c+2)*num_particle+i]*head.pos_quant;
+		}
+		c+=3;
+	}
+
+	if(head.attrib & FRAME_VEL)
+	{
+		for(uint i=0; i<num_particle; i++)
+		{
+			vel[i].x=cur[c*num_particle+i]*head.vel_quant;
+			vel[i].y=cur[(c+1)*num_particle+i]*head.vel_quant;
+			vel[i].z=cur[(c+2)*num_particle+i]*head.vel_quant;
+		}
+		c+=3;
+	}
+
+	if(head.attrib & FRAME_DENS)
+	{
+		for(uint i=0; i<num_particle; i++)
+		{
+			dens[i]=cur[c*num_particle+i]*head.dens_quant;
+		}
+	}
+
+	return 1;
+}
+
+uint FrameReader::read_at(unsigned long long offset, void *dst, size_t count)
+{
+	if(offset+count > size)
+	{
+		return 0;
+	}
+
+	if(data != NULL)
+	{
+		memcpy(dst, data+offset, count);
+		return 1;
+	}
+
+	return frame_seek(fp, offset) == 0 && fread(dst, 1, count, fp) == count;
+}
+
+uint FrameReader::decode(uint frame)
+{
+	unsigned short prob[NUM_COMPONENT*LEN_CONTEXT*LEN_SYMBOL];
+	RangeDecoder rc;
+	uint comps=frame_components(head.attrib);
+	uint num=index[frame].num_particle;
+	uint key=index[frame].key_frame == frame;
+	uint bytes=index[frame].size;
+
+	if(key == 0 && (frame == 0 || index[frame-1].num_particle != num))
+	{
+		printf("Frame %u is a delta on a different particle count\n", frame);
+		return 0;
+	}
+
+	if(comps*num > max_value)
+	{
+		max_value=comps*num;
+		cur=(int *)realloc(cur, sizeof(int)*max_value);
+		pos=(float3 *)realloc(pos, sizeof(float3)*num);
+		vel=(float3 *)realloc(vel, sizeof(float3)*num);
+		dens=(float *)realloc(dens, sizeof(float)*num);
+	}
+
+	if(data != NULL)
+	{
+		rc.in=data+index[frame].offset;
+	}
+	else
+	{
+		if(bytes > max_buf)
+		{
+			max_buf=bytes;
+			buf=(unsigned char *)realloc(buf, max_buf);
+		}
+
+		if(read_at(index[frame].offset, buf, bytes) == 0)
+		{
+			printf("Cannot read frame %u\n", frame);
+			return 0;
+		}
+		rc.in=buf;
+	}
+
+	rc.end=rc.in+bytes;
+	rc.range=0xFFFFFFFFu;
+	rc.code=0;
+	for(uint i=0; i<5; i++)
+	{
+		rc.code=(rc.code<<8) | rc_next(&rc);
+	}
+
+	reset_model(prob);
+	for(uint c=0; c<comps; c++)
+	{
+		if(decode_component(&rc, prob+c*LEN_CONTEXT*LEN_SYMBOL, cur+c*num, key, num) == 0)
+		{
+			printf("Frame %u is corrupt\n", frame);
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+/** Asks for the pages of the next prefetch frames, so playing forward only
+ ** waits on the disk when it is slower than decoding. */
+void FrameReader::prefetch_after(uint frame)
+{
+#ifndef _WIN32
+	unsigned long long start;
+	unsigned long long end;
+	unsigned long long page=(unsigned long long)sysconf(_SC_PAGESIZE);
+	uint last;
+
+	if(data == NULL || prefetch == 0 || frame+1 >= num_frame)
+	{
+		return;
+	}
+
+	last=frame+prefetch < num_frame ? frame+prefetch : num_frame-1;
+	start=index[frame+1].offset/page*page;
+	end=index[last].offset+index[last].size;
+
+	madvise((void *)(data+start), (size_t)(end-start), MADV_WILLNEED);
+#endif
+}
+
+void FrameReader::close()
+{
+#ifndef _WIN32
+	if(data != NULL)
+	{
+		munmap((void *)data, (size_t)size);
+	}
+#endif
+
+	if(fp != NULL)
+	{
+		fclose(fp);
+	}
+
+	free(index);
+	free(cur);
+	free(buf);
+	free(pos);
+	free(vel);
+	free(dens);
+
+	data=NULL;
+	size=0;
+	fp=NULL;
+	index=NULL;
+	cur=NULL;
+	buf=NULL;
+	pos=NULL;
+	vel=NULL;
+	dens=NULL;
+
+	num_frame=0;
+	num_particle=0;
+	cur_frame=0xffffffff;
+	max_value=0;
+	max_buf=0;
+}
@@ -0,0 +1,167 @@
+/** File:		sph_frame.h
+ ** Author:		Dongli Zhang
+ ** Contact:	dongli.zhang0129@gmail.com
+ **
+ ** Copyright (C) Dongli Zhang 2013
+ **
+ ** This program is free software;  you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+ ** the GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program;  if not, write to the Free Software
+ ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef __SPHFRAME_H__
+#define __SPHFRAME_H__
+
+#include "sph_type.h"
+#include <stdio.h>
+
+class Particle;
+
+#define FRAME_VERSION 1
+
+#define FRAME_POS 1
+#define FRAME_VEL 2
+#define FRAME_DENS 4
+
+/** Frame file layout:
+ **
+ **   FrameFileHeader
+ **   frame data, one range coded block per frame
+ **   FrameIndex[num_frame]      at index_offset
+ **   FrameFooter                last 16 bytes of the file
+ **
+ ** Every attribute component is quantized to an integer with the step in
+ ** the header. A key frame predicts each value from the previous particle,
+ ** the other frames from the same particle in the frame before. The index
+ ** gives the offset of every frame and of the key frame it depends on.
+ */
+
+struct FrameFileHeader
+{
+	char magic[4];
+	uint version;
+	uint header_size;
+	uint attrib;
+
+	float3 world_size;
+	float kernel;
+	float mass;
+
+	float pos_quant;
+	float vel_quant;
+	float dens_quant;
+	uint key_interval;
+};
+
+struct FrameIndex
+{
+	unsigned long long offset;
+	uint size;
+	uint num_particle;
+	uint key_frame;
+	float time;
+};
+
+struct FrameFooter
+{
+	unsigned long long index_offset;
+	uint num_frame;
+	char magic[4];
+};
+
+struct FrameBuffer
+{
+	int *value;
+	uint max_value;
+	uint num_particle;
+	float time;
+};
+
+class FrameWriter
+{
+public:
+	uint attrib;
+	float pos_quant;
+	float vel_quant;
+	float dens_quant;
+	uint key_interval;
+
+	uint num_frame;
+	unsigned long long tot_bytes;
+	unsigned long long tot_particle;
+
+public:
+	FrameWriter();
+	~FrameWriter();
+	uint open(const char *file, float3 world_size, float kernel, float mass);
+	uint write(const Particle *mem, const uint *index, uint num_particle, float time);
+	void quantize(const Particle *mem, const uint *index, uint num_particle, float time, FrameBuffer *frame);
+	uint encode(FrameBuffer *frame);
+	uint close();
+	float bytes_per_particle();
+
+private:
+	FILE *fp;
+	FrameFileHeader head;
+	FrameIndex *index;
+	uint max_frame;
+	uint last_key;
+
+	FrameBuffer cur;
+	FrameBuffer last;
+
+	unsigned char *buf;
+	size_t max_buf;
+};
+
+class FrameReader
+{
+public:
+	FrameFileHeader head;
+	FrameIndex *index;
+	uint num_frame;
+	uint prefetch;
+
+	uint frame;
+	uint num_particle;
+	float time;
+	float3 *pos;
+	float3 *vel;
+	float *dens;
+
+public:
+	FrameReader();
+	~FrameReader();
+	uint open(const char *file);
+	uint seek(uint frame);
+	void close();
+
+private:
+	const unsigned char *data;
+	unsigned long long size;
+	int *cur;
+	uint cur_frame;
+	uint max_value;
+
+	FILE *fp;
+	unsigned char *buf;
+	size_t max_buf;
+
+	uint read_at(unsigned long long offset, void *dst, size_t count);
+	uint decode(uint frame);
+	void prefetch_after(uint frame);
+};
+
+uint frame_components(uint attrib);
+
+#endif
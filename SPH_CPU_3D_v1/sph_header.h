@@ -1,34 +1,34 @@
-/** File:		sph_header.h
- ** Author:		Dongli Zhang
- ** Contact:	dongli.zhang0129@gmail.com
- **
- ** Copyright (C) Dongli Zhang 2013
- **
- ** This program is free software;  you can redistribute it and/or modify
- ** it under the terms of the GNU General Public License as published by
- ** the Free Software Foundation; either version 2 of the License, or
- ** (at your option) any later version.
- **
- ** This program is distributed in the hope that it will be useful,
- ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
- ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
- ** the GNU General Public License for more details.
- **
- ** You should have received a copy of the GNU General Public License
- ** along with this program;  if not, write to the Free Software 
- ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
- */
-
-#ifndef __SPHHEADER_H__
-#define __SPHHEADER_H__
-
-#include <stdio.h>
-#include <stdlib.h>
-#include <math.h>
-#include <time.h>
-
-#define PI 3.141592f
-#define INF 1E-12f
-#define BOUNDARY 0.0001f
-
-#endif
+/** File:		sph_header.h
+ ** Author:		Dongli Zhang
+ ** Contact:	dongli.zhang0129@gmail.com
+ **
+ ** Copyright (C) Dongli Zhang 2013
+ **
+ ** This program is free software;  you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+ ** the GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program;  if not, write to the Free Software 
+ ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef __SPHHEADER_H__
+#define __SPHHEADER_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+
+#define PI 3.141592f
+#define INF 1E-12f
+#define BOUNDARY 0.0001f
+
+#endif
@@ -0,0 +1,242 @@
+/** File:		sph_iisph.cpp
+ ** Author:		Dongli Zhang
+ ** Contact:	dongli.zhang0129@gmail.com
+ **
+ ** Copyright (C) Dongli Zhang 2013
+ **
+ ** This program is free software;  you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+ ** the GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program;  if not, write to the Free Software
+ ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "sph_system.h"
+#include "sph_header.h"
+
+/** Implicit incompressible SPH, Ihmsen et al. 2014.
+ **
+ ** The pressure Poisson equation A p = rho0 - rho_adv is solved with relaxed
+ ** Jacobi iterations written in terms of pressure accelerations, so every
+ ** sweep is a plain gather over the neighbor list and the particle loops
+ ** run in parallel when OpenMP is enabled. The diagonal a_ii is kept in
+ ** alpha and the source term in dens_adv. Pressure is warm started from
+ ** half of the previous step's value. Like DFSPH it ignores bound_part.
+ */
+
+void SPHSystem::iisph_step()
+{
+	build_neighbor();
+	prof.begin(PHASE_DENS);
+	iisph_dens_diag();
+	prof.end(PHASE_DENS);
+	comp_force_adv(0);
+
+	prof.begin(PHASE_PRESSURE);
+	iisph_source();
+
+	solver_iter=0;
+	do
+	{
+		iisph_pres_acc();
+		solver_err=iisph_relax();
+		solver_iter++;
+	}
+	while((solver_err > max_dens_err || solver_iter < min_iter) && solver_iter < max_iter);
+
+	iisph_pres_acc();
+	prof.end(PHASE_PRESSURE);
+
+	#pragma omp parallel for
+	for(int i=0; i<(int)num_particle; i++)
+	{
+		Particle *p=&(mem[i]);
+		p->acc.x+=p->pres_acc.x*p->dens;
+		p->acc.y+=p->pres_acc.y*p->dens;
+		p->acc.z+=p->pres_acc.z*p->dens;
+	}
+
+	advection();
+}
+
+void SPHSystem::iisph_dens_diag()
+{
+	float dt2=time_step*time_step;
+
+	#pragma omp parallel for
+	for(int i=0; i<(int)num_particle; i++)
+	{
+		Particle *p=&(mem[i]);
+		Particle *np;
+
+		float3 rel_pos;
+		float3 sum_grad;
+		float sum_grad2=0.0f;
+		float r2;
+		float r;
+		float grad;
+
+		sum_grad.x=0.0f;
+		sum_grad.y=0.0f;
+		sum_grad.z=0.0f;
+
+		p->dens=self_dens;
+
+		for(uint j=nb_start[i]; j<nb_start[i+1]; j++)
+		{
+			np=&(mem[nb_list[j]]);
+
+			rel_pos.x=p->pos.x-np->pos.x;
+			rel_pos.y=p->pos.y-np->pos.y;
+			rel_pos.z=p->pos.z-np->pos.z;
+			wrap_rel(rel_pos);
+			r2=rel_pos.x*rel_pos.x+rel_pos.y*rel_pos.y+rel_pos.z*rel_pos.z;
+			r=sqrt(r2);
+
+			p->dens+=mass*w_dens.value(r2);
+
+			grad=mass*w_pres.grad(r)/r;
+			sum_grad.x+=grad*rel_pos.x;
+			sum_grad.y+=grad*rel_pos.y;
+			sum_grad.z+=grad*rel_pos.z;
+			sum_grad2+=grad*grad*r2;
+		}
+
+		p->alpha=-dt2/(p->dens*p->dens)*(sum_grad.x*sum_grad.x+sum_grad.y*sum_grad.y+sum_grad.z*sum_grad.z+sum_grad2);
+		p->pres=p->pres*0.5f;
+	}
+}
+
+void SPHSystem::iisph_source()
+{
+	#pragma omp parallel for
+	for(int i=0; i<(int)num_particle; i++)
+	{
+		Particle *p=&(mem[i]);
+		p->pred_vel.x=p->vel.x+(p->acc.x/p->dens+gravity.x)*time_step;
+		p->pred_vel.y=p->vel.y+(p->acc.y/p->dens+gravity.y)*time_step;
+		p->pred_vel.z=p->vel.z+(p->acc.z/p->dens+gravity.z)*time_step;
+	}
+
+	#pragma omp parallel for
+	for(int i=0; i<(int)num_particle; i++)
+	{
+		Particle *p=&(mem[i]);
+		Particle *np;
+
+		float3 rel_pos;
+		float r;
+		float div_vel=0.0f;
+
+		for(uint j=nb_start[i]; j<nb_start[i+1]; j++)
+		{
+			np=&(mem[nb_list[j]]);
+
+			rel_pos.x=p->pos.x-np->pos.x;
+			rel_pos.y=p->pos.y-np->pos.y;
+			rel_pos.z=p->pos.z-np->pos.z;
+			wrap_rel(rel_pos);
+			r=sqrt(rel_pos.x*rel_pos.x+rel_pos.y*rel_pos.y+rel_pos.z*rel_pos.z);
+
+			div_vel+=mass*w_pres.grad(r)/r*((p->pred_vel.x-np->pred_vel.x)*rel_pos.x
+											+(p->pred_vel.y-np->pred_vel.y)*rel_pos.y
+											+(p->pred_vel.z-np->pred_vel.z)*rel_pos.z);
+		}
+
+		p->dens_adv=lattice_density-(p->dens+time_step*div_vel);
+	}
+}
+
+void SPHSystem::iisph_pres_acc()
+{
+	#pragma omp parallel for
+	for(int i=0; i<(int)num_particle; i++)
+	{
+		Particle *p=&(mem[i]);
+		Particle *np;
+
+		float3 rel_pos;
+		float r;
+		float temp;
+		float pi=p->pres/(p->dens*p->dens);
+
+		p->pres_acc.x=0.0f;
+		p->pres_acc.y=0.0f;
+		p->pres_acc.z=0.0f;
+
+		for(uint j=nb_start[i]; j<nb_start[i+1]; j++)
+		{
+			np=&(mem[nb_list[j]]);
+
+			rel_pos.x=p->pos.x-np->pos.x;
+			rel_pos.y=p->pos.y-np->pos.y;
+			rel_pos.z=p->pos.z-np->pos.z;
+			wrap_rel(rel_pos);
+			r=sqrt(rel_pos.x*rel_pos.x+rel_pos.y*rel_pos.y+rel_pos.z*rel_pos.z);
+
+			temp=-mass*(pi+np->pres/(np->dens*np->dens))*w_pres.grad(r)/r;
+			p->pres_acc.x+=temp*rel_pos.x;
+			p->pres_acc.y+=temp*rel_pos.y;
+			p->pres_acc.z+=temp*rel_pos.z;
+		}
+	}
+}
+
+float SPHSystem::iisph_relax()
+{
+	float dt2=time_step*time_step;
+	float tot_err=0.0f;
+
+	#pragma omp parallel for reduction(+:tot_err)
+	for(int i=0; i<(int)num_particle; i++)
+	{
+		Particle *p=&(mem[i]);
+		Particle *np;
+
+		float3 rel_pos;
+		float r;
+		float grad;
+		float ap=0.0f;
+
+		for(uint j=nb_start[i]; j<nb_start[i+1]; j++)
+		{
+			np=&(mem[nb_list[j]]);
+
+			rel_pos.x=p->pos.x-np->pos.x;
+			rel_pos.y=p->pos.y-np->pos.y;
+			rel_pos.z=p->pos.z-np->pos.z;
+			wrap_rel(rel_pos);
+			r=sqrt(rel_pos.x*rel_pos.x+rel_pos.y*rel_pos.y+rel_pos.z*rel_pos.z);
+
+			grad=mass*w_pres.grad(r)/r;
+			ap+=grad*((p->pres_acc.x-np->pres_acc.x)*rel_pos.x
+						+(p->pres_acc.y-np->pres_acc.y)*rel_pos.y
+						+(p->pres_acc.z-np->pres_acc.z)*rel_pos.z);
+		}
+		ap=ap*dt2;
+
+		if(fabs(p->alpha) > INF)
+		{
+			p->pres=fmax(p->pres+jacobi_omega*(p->dens_adv-ap)/p->alpha, 0.0f);
+		}
+		else
+		{
+			p->pres=0.0f;
+		}
+
+		if(p->pres > 0.0f)
+		{
+			tot_err+=ap-p->dens_adv;
+		}
+	}
+
+	return num_particle > 0 ? tot_err/num_particle/lattice_density : 0.0f;
+}
@@ -1,374 +1,725 @@
-/** File:		sph_main.cpp
- ** Author:		Dongli Zhang
- ** Contact:	dongli.zhang0129@gmail.com
- **
- ** Copyright (C) Dongli Zhang 2013
- **
- ** This program is free software;  you can redistribute it and/or modify
- ** it under the terms of the GNU General Public License as published by
- ** the Free Software Foundation; either version 2 of the License, or
- ** (at your option) any later version.
- **
- ** This program is distributed in the hope that it will be useful,
- ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
- ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
- ** the GNU General Public License for more details.
- **
- ** You should have received a copy of the GNU General Public License
- ** along with this program;  if not, write to the Free Software 
- ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
- */
-
-#include "sph_header.h"
-#include "sph_data.h"
-#include "sph_timer.h"
-#include "sph_system.h"
-#include <GL\glew.h>
-#include <GL\glut.h>
-
-#pragma comment(lib, "glew32.lib") 
-
-SPHSystem *sph;
-
-Timer *sph_timer;
-char *window_title;
-
-GLuint v;
-GLuint f;
-GLuint p;
-
-void set_shaders()
-{
-	char *vs=NULL;
-	char *fs=NULL;
-
-	vs=(char *)malloc(sizeof(char)*10000);
-	fs=(char *)malloc(sizeof(char)*10000);
-	memset(vs, 0, sizeof(char)*10000);
-	memset(fs, 0, sizeof(char)*10000);
-
-	FILE *fp;
-	char c;
-	int count;
-
-	fp=fopen("shader/shader.vs", "r");
-	count=0;
-	while((c=fgetc(fp)) != EOF)
-	{
-		vs[count]=c;
-		count++;
-	}
-	fclose(fp);
-
-	fp=fopen("shader/shader.fs", "r");
-	count=0;
-	while((c=fgetc(fp)) != EOF)
-	{
-		fs[count]=c;
-		count++;
-	}
-	fclose(fp);
-
-	v=glCreateShader(GL_VERTEX_SHADER);
-	f=glCreateShader(GL_FRAGMENT_SHADER);
-
-	const char *vv;
-	const char *ff;
-	vv=vs;
-	ff=fs;
-
-	glShaderSource(v, 1, &vv, NULL);
-	glShaderSource(f, 1, &ff, NULL);
-
-	int success;
-
-	glCompileShader(v);
-	glGetShaderiv(v, GL_COMPILE_STATUS, &success);
-	if(!success)
-	{
-		char info_log[5000];
-		glGetShaderInfoLog(v, 5000, NULL, info_log);
-		printf("Error in vertex shader compilation!\n");
-		printf("Info Log: %s\n", info_log);
-	}
-
-	glCompileShader(f);
-	glGetShaderiv(f, GL_COMPILE_STATUS, &success);
-	if(!success)
-	{
-		char info_log[5000];
-		glGetShaderInfoLog(f, 5000, NULL, info_log);
-		printf("Error in fragment shader compilation!\n");
-		printf("Info Log: %s\n", info_log);
-	}
-
-	p=glCreateProgram();
-	glAttachShader(p, v);
-	glAttachShader(p, f);
-	glLinkProgram(p);
-	glUseProgram(p);
-
-	free(vs);
-	free(fs);
-}
-
-void draw_box(float ox, float oy, float oz, float width, float height, float length)
-{
-    glLineWidth(1.0f);
-	glColor3f(1.0f, 0.0f, 0.0f);
-
-    glBegin(GL_LINES);   
-		
-        glVertex3f(ox, oy, oz);
-        glVertex3f(ox+width, oy, oz);
-
-        glVertex3f(ox, oy, oz);
-        glVertex3f(ox, oy+height, oz);
-
-        glVertex3f(ox, oy, oz);
-        glVertex3f(ox, oy, oz+length);
-
-        glVertex3f(ox+width, oy, oz);
-        glVertex3f(ox+width, oy+height, oz);
-
-        glVertex3f(ox+width, oy+height, oz);
-        glVertex3f(ox, oy+height, oz);
-
-        glVertex3f(ox, oy+height, oz+length);
-        glVertex3f(ox, oy, oz+length);
-
-        glVertex3f(ox, oy+height, oz+length);
-        glVertex3f(ox, oy+height, oz);
-
-        glVertex3f(ox+width, oy, oz);
-        glVertex3f(ox+width, oy, oz+length);
-
-        glVertex3f(ox, oy, oz+length);
-        glVertex3f(ox+width, oy, oz+length);
-
-        glVertex3f(ox+width, oy+height, oz);
-        glVertex3f(ox+width, oy+height, oz+length);
-
-        glVertex3f(ox+width, oy+height, oz+length);
-        glVertex3f(ox+width, oy, oz+length);
-
-        glVertex3f(ox, oy+height, oz+length);
-        glVertex3f(ox+width, oy+height, oz+length);
-
-    glEnd();
-}
-
-void init_sph_system()
-{
-	real_world_origin.x=-10.0f;
-	real_world_origin.y=-10.0f;
-	real_world_origin.z=-10.0f;
-
-	real_world_side.x=20.0f;
-	real_world_side.y=20.0f;
-	real_world_side.z=20.0f;
-
-	sph=new SPHSystem();
-	sph->init_system();
-
-	sph_timer=new Timer();
-	window_title=(char *)malloc(sizeof(char)*50);
-}
-
-void init()
-{
-	glewInit();
-
-	glViewport(0, 0, window_width, window_height);
-	glMatrixMode(GL_PROJECTION);
-	glLoadIdentity();
-
-	gluPerspective(45.0, (float)window_width/window_height, 10.0f, 100.0);
-
-	glMatrixMode(GL_MODELVIEW);
-	glLoadIdentity();
-	glTranslatef(0.0f, 0.0f, -3.0f);
-}
-
-void init_ratio()
-{
-	sim_ratio.x=real_world_side.x/sph->world_size.x;
-	sim_ratio.y=real_world_side.y/sph->world_size.y;
-	sim_ratio.z=real_world_side.z/sph->world_size.z;
-}
-
-void render_particles()
-{
-	glPointSize(1.0f);
-	glColor3f(0.2f, 0.2f, 1.0f);
-
-	for(uint i=0; i<sph->num_particle; i++)
-	{
-		glBegin(GL_POINTS);
-			glVertex3f(sph->mem[i].pos.x*sim_ratio.x+real_world_origin.x, 
-						sph->mem[i].pos.y*sim_ratio.y+real_world_origin.y,
-						sph->mem[i].pos.z*sim_ratio.z+real_world_origin.z);
-		glEnd();
-	}
-}
-
-void display_func()
-{
-	glEnable(GL_POINT_SMOOTH);
-	glEnable(GL_DEPTH_TEST);
-	glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-    glPushMatrix();
-
-	if(buttonState == 1)
-	{
-		xRot+=(xRotLength-xRot)*0.1f;
-		yRot+=(yRotLength-yRot)*0.1f;
-	}
-
-	glTranslatef(xTrans, yTrans, zTrans);
-    glRotatef(xRot, 1.0f, 0.0f, 0.0f);
-    glRotatef(yRot, 0.0f, 1.0f, 0.0f);
-
-	sph->animation();
-
-	glUseProgram(p);
-	render_particles();
-
-	glUseProgram(0);
-	draw_box(real_world_origin.x, real_world_origin.y, real_world_origin.z, real_world_side.x, real_world_side.y, real_world_side.z);
-
-	glPopMatrix();
-
-    glutSwapBuffers();
-	
-	sph_timer->update();
-	memset(window_title, 0, 50);
-	sprintf(window_title, "SPH System 3D. FPS: %f", sph_timer->get_fps());
-	glutSetWindowTitle(window_title);
-}
-
-void idle_func()
-{
-	glutPostRedisplay();
-}
-
-void reshape_func(GLint width, GLint height)
-{
-	window_width=width;
-	window_height=height;
-
-	glViewport(0, 0, width, height);
-	glMatrixMode(GL_PROJECTION);
-	glLoadIdentity();
-
-	gluPerspective(45.0, (float)width/height, 0.001, 100.0);
-
-	glMatrixMode(GL_MODELVIEW);
-	glLoadIdentity();
-	glTranslatef(0.0f, 0.0f, -3.0f);
-}
-
-void keyboard_func(unsigned char key, int x, int y)
-{
-	if(key == ' ')
-	{
-		sph->sys_running=1-sph->sys_running;
-	}
-
-	if(key == 'w')
-	{
-		zTrans += 0.3f;
-	}
-
-	if(key == 's')
-	{
-		zTrans -= 0.3f;
-	}
-
-	if(key == 'a')
-	{
-		xTrans -= 0.3f;
-	}
-
-	if(key == 'd')
-	{
-		xTrans += 0.3f;
-	}
-
-	if(key == 'q')
-	{
-		yTrans -= 0.3f;
-	}
-
-	if(key == 'e')
-	{
-		yTrans += 0.3f;
-	}
-
-	glutPostRedisplay();
-}
-
-void mouse_func(int button, int state, int x, int y)
-{
-	if (state == GLUT_DOWN)
-	{
-        buttonState = 1;
-	}
-    else if (state == GLUT_UP)
-	{
-        buttonState = 0;
-	}
-
-    ox = x; oy = y;
-
-    glutPostRedisplay();
-}
-
-void motion_func(int x, int y)
-{
-    float dx, dy;
-    dx = (float)(x - ox);
-    dy = (float)(y - oy);
-
-	if (buttonState == 1) 
-	{
-		xRotLength += dy / 5.0f;
-		yRotLength += dx / 5.0f;
-	}
-
-	ox = x; oy = y;
-
-	glutPostRedisplay();
-}
-
-int main(int argc, char **argv)
-{
-    glutInit(&argc, argv);
-    glutInitDisplayMode(GLUT_RGB | GLUT_DOUBLE);
-    glutInitWindowPosition(0, 0);
-    glutInitWindowSize(window_width, window_height);
-    glutCreateWindow("SPH Fluid 3D");
-
-	init_sph_system();
-	init();
-	init_ratio();
-	set_shaders();
-	glEnable(GL_VERTEX_PROGRAM_POINT_SIZE_NV);
-	glEnable(GL_POINT_SPRITE_ARB);
-	glTexEnvi(GL_POINT_SPRITE_ARB, GL_COORD_REPLACE_ARB, GL_TRUE);
-	glDepthMask(GL_TRUE);
-	glEnable(GL_DEPTH_TEST);
-
-    glutDisplayFunc(display_func);
-	glutReshapeFunc(reshape_func);
-	glutKeyboardFunc(keyboard_func);
-	glutMouseFunc(mouse_func);
-	glutMotionFunc(motion_func);
-	glutIdleFunc(idle_func);
-
-    glutMainLoop();
-
-    return 0;
-}
+/** File:		sph_main.cpp
+ ** Author:		Dongli Zhang
+ ** Contact:	dongli.zhang0129@gmail.com
+ **
+ ** Copyright (C) Dongli Zhang 2013
+ **
+ ** This program is free software;  you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+ ** the GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program;  if not, write to the Free Software 
+ ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+#include "sph_header.h"
+#include "sph_data.h"
+#include "sph_timer.h"
+#include "sph_system.h"
+#include "sph_async.h"
+#include <string.h>
+#include <GL\glew.h>
+#include <GL\glut.h>
+
+#pragma comment(lib, "glew32.lib") 
+
+SPHSystem *sph;
+
+char *window_title;
+
+AsyncWriter *frame_writer=NULL;
+uint frame_attrib=FRAME_POS;
+uint frame_policy=QUEUE_BLOCK;
+uint record_every=1;
+ExportFilter frame_filter;
+uint frame_count=0;
+const char *trace_file="sph_trace.json";
+
+FrameReader *replay=NULL;
+uint replay_frame=0;
+
+GLuint v;
+GLuint f;
+GLuint p;
+
+void set_shaders()
+{
+	char *vs=NULL;
+	char *fs=NULL;
+
+	vs=(char *)malloc(sizeof(char)*10000);
+	fs=(char *)malloc(sizeof(char)*10000);
+	memset(vs, 0, sizeof(char)*10000);
+	memset(fs, 0, sizeof(char)*10000);
+
+	FILE *fp;
+	char c;
+	int count;
+
+	fp=fopen("shader/shader.vs", "r");
+	count=0;
+	while((c=fgetc(fp)) != EOF)
+	{
+		vs[count]=c;
+		count++;
+	}
+	fclose(fp);
+
+	fp=fopen("shader/shader.fs", "r");
+	count=0;
+	while((c=fgetc(fp)) != EOF)
+	{
+		fs[count]=c;
+		count++;
+	}
+	fclose(fp);
+
+	v=glCreateShader(GL_VERTEX_SHADER);
+	f=glCreateShader(GL_FRAGMENT_SHADER);
+
+	const char *vv;
+	const char *ff;
+	vv=vs;
+	ff=fs;
+
+	glShaderSource(v, 1, &vv, NULL);
+	glShaderSource(f, 1, &ff, NULL);
+
+	int success;
+
+	glCompileShader(v);
+	glGetShaderiv(v, GL_COMPILE_STATUS, &success);
+	if(!success)
+	{
+		char info_log[5000];
+		glGetShaderInfoLog(v, 5000, NULL, info_log);
+		printf("Error in vertex shader compilation!\n");
+		printf("Info Log: %s\n", info_log);
+	}
+
+	glCompileShader(f);
+	glGetShaderiv(f, GL_COMPILE_STATUS, &success);
+	if(!success)
+	{
+		char info_log[5000];
+		glGetShaderInfoLog(f, 5000, NULL, info_log);
+		printf("Error in fragment shader compilation!\n");
+		printf("Info Log: %s\n", info_log);
+	}
+
+	p=glCreateProgram();
+	glAttachShader(p, v);
+	glAttachShader(p, f);
+	glLinkProgram(p);
+	glUseProgram(p);
+
+	free(vs);
+	free(fs);
+}
+
+void draw_box(float ox, float oy, float oz, float width, float height, float length)
+{
+    glLineWidth(1.0f);
+	glColor3f(1.0f, 0.0f, 0.0f);
+
+    glBegin(GL_LINES);   
+		
+        glVertex3f(ox, oy, oz);
+        glVertex3f(ox+width, oy, oz);
+
+        glVertex3f(ox, oy, oz);
+        glVertex3f(ox, oy+height, oz);
+
+        glVertex3f(ox, oy, oz);
+        glVertex3f(ox, oy, oz+length);
+
+        glVertex3f(ox+width, oy, oz);
+        glVertex3f(ox+width, oy+height, oz);
+
+        glVertex3f(ox+width, oy+height, oz);
+        glVertex3f(ox, oy+height, oz);
+
+        glVertex3f(ox, oy+height, oz+length);
+        glVertex3f(ox, oy, oz+length);
+
+        glVertex3f(ox, oy+height, oz+length);
+        glVertex3f(ox, oy+height, oz);
+
+        glVertex3f(ox+width, oy, oz);
+        glVertex3f(ox+width, oy, oz+length);
+
+        glVertex3f(ox, oy, oz+length);
+        glVertex3f(ox+width, oy, oz+length);
+
+        glVertex3f(ox+width, oy+height, oz);
+        glVertex3f(ox+width, oy+height, oz+length);
+
+        glVertex3f(ox+width, oy+height, oz+length);
+        glVertex3f(ox+width, oy, oz+length);
+
+        glVertex3f(ox, oy+height, oz+length);
+        glVertex3f(ox+width, oy+height, oz+length);
+
+    glEnd();
+}
+
+void start_recording(const char *file)
+{
+	frame_writer=new AsyncWriter();
+	frame_writer->writer.attrib=frame_attrib;
+	frame_writer->policy=frame_policy;
+	frame_count=0;
+	if(frame_writer->open(file, sph->world_size, sph->kernel, sph->mass))
+	{
+		printf("Recording: %s\n", file);
+	}
+	else
+	{
+		delete frame_writer;
+		frame_writer=NULL;
+	}
+}
+
+void init_sph_system(int argc, char **argv)
+{
+	real_world_origin.x=-10.0f;
+	real_world_origin.y=-10.0f;
+	real_world_origin.z=-10.0f;
+
+	real_world_side.x=20.0f;
+	real_world_side.y=20.0f;
+	real_world_side.z=20.0f;
+
+	char *checkpoint=NULL;
+	char *scene=NULL;
+	char *obstacle[MAX_OBSTACLE];
+	uint num_obstacle=0;
+	uint loaded=0;
+	uint relax=0;
+	size_t len;
+
+	sph=new SPHSystem();
+	for(int i=1; i<argc; i++)
+	{
+		if(strcmp(argv[i], "-relax") == 0)
+		{
+			relax=1;
+			continue;
+		}
+
+		if(strcmp(argv[i], "-every") == 0 && i+1 < argc)
+		{
+			record_every=(uint)atoi(argv[++i]);
+			record_every=record_every > 0 ? record_every : 1;
+			continue;
+		}
+
+		if(strcmp(argv[i], "-attrib") == 0 && i+1 < argc)
+		{
+			i++;
+			frame_attrib=(strchr(argv[i], 'p') ? FRAME_POS : 0) | (strchr(argv[i], 'v') ? FRAME_VEL : 0) | (strchr(argv[i], 'd') ? FRAME_DENS : 0);
+			continue;
+		}
+
+		if(strcmp(argv[i], "-roi") == 0 && i+6 < argc)
+		{
+			frame_filter.region=EXPORT_BOX;
+			frame_filter.lo.x=(float)atof(argv[i+1]);
+			frame_filter.lo.y=(float)atof(argv[i+2]);
+			frame_filter.lo.z=(float)atof(argv[i+3]);
+			frame_filter.hi.x=(float)atof(argv[i+4]);
+			frame_filter.hi.y=(float)atof(argv[i+5]);
+			frame_filter.hi.z=(float)atof(argv[i+6]);
+			i+=6;
+			continue;
+		}
+
+		if(strcmp(argv[i], "-probe") == 0 && i+4 < argc)
+		{
+			frame_filter.region=EXPORT_SPHERE;
+			frame_filter.center.x=(float)atof(argv[i+1]);
+			frame_filter.center.y=(float)atof(argv[i+2]);
+			frame_filter.center.z=(float)atof(argv[i+3]);
+			frame_filter.radius=(float)atof(argv[i+4]);
+			i+=4;
+			continue;
+		}
+
+		if(strcmp(argv[i], "-csv") == 0 && i+1 < argc)
+		{
+			sph->prof.open_csv(argv[++i]);
+			continue;
+		}
+
+		if(strcmp(argv[i], "-trace") == 0 && i+1 < argc)
+		{
+			trace_file=argv[++i];
+			trace_enabled=1;
+			trace_thread("main");
+			continue;
+		}
+
+		if(strcmp(argv[i], "-sample") == 0 && i+1 < argc)
+		{
+			frame_filter.sample=(uint)atoi(argv[++i]);
+			continue;
+		}
+
+		if(strcmp(argv[i], "-policy") == 0 && i+1 < argc)
+		{
+			i++;
+			frame_policy=strcmp(argv[i], "drop") == 0 ? QUEUE_DROP : (strcmp(argv[i], "coalesce") == 0 ? QUEUE_COALESCE : QUEUE_BLOCK);
+			continue;
+		}
+
+		len=strlen(argv[i]);
+		if(len > 5 && strcmp(argv[i]+len-5, ".ckpt") == 0)
+		{
+			checkpoint=argv[i];
+			continue;
+		}
+
+		if(len > 6 && strcmp(argv[i]+len-6, ".scene") == 0)
+		{
+			scene=argv[i];
+			continue;
+		}
+
+		if(len > 5 && strcmp(argv[i]+len-5, ".sphf") == 0)
+		{
+			replay=new FrameReader();
+			if(replay->open(argv[i]) == 0 || (replay->head.attrib & FRAME_POS) == 0 || replay->seek(0) == 0)
+			{
+				printf("Cannot replay: %s\n", argv[i]);
+				delete replay;
+				replay=NULL;
+			}
+			continue;
+		}
+
+		if(num_obstacle < MAX_OBSTACLE)
+		{
+			obstacle[num_obstacle]=argv[i];
+			num_obstacle++;
+		}
+	}
+
+	if(replay != NULL)
+	{
+		printf("Replay: %u frames\n", replay->num_frame);
+	}
+	else
+	{
+		if(scene != NULL)
+		{
+			loaded=sph->load_scene(scene, obstacle, num_obstacle);
+			if(loaded == 0)
+			{
+				exit(1);
+			}
+
+			if(relax)
+			{
+				sph->relax_cached(".");
+			}
+		}
+		else
+		{
+			for(uint i=0; i<num_obstacle; i++)
+			{
+				sph->add_obstacle(obstacle[i], sph->kernel*0.125f);
+			}
+		}
+
+		if((checkpoint == NULL || sph->load_checkpoint(checkpoint) == 0) && loaded == 0)
+		{
+			if(relax)
+			{
+				sph->init_relaxed(".");
+			}
+			else
+			{
+				sph->init_system();
+			}
+		}
+
+		if(loaded && sph->output.frame_file[0] != '\0')
+		{
+			frame_attrib=sph->output.frame_attrib;
+			frame_filter=sph->output.frame_filter;
+			start_recording(sph->output.frame_file);
+			record_every=sph->output.frame_every;
+		}
+	}
+
+	sph->prof.enabled=1;
+	sph->prof.reset();
+	window_title=(char *)malloc(sizeof(char)*512);
+}
+
+void init()
+{
+	glewInit();
+
+	glViewport(0, 0, window_width, window_height);
+	glMatrixMode(GL_PROJECTION);
+	glLoadIdentity();
+
+	gluPerspective(45.0, (float)window_width/window_height, 10.0f, 100.0);
+
+	glMatrixMode(GL_MODELVIEW);
+	glLoadIdentity();
+	glTranslatef(0.0f, 0.0f, -3.0f);
+}
+
+void init_ratio()
+{
+	float3 world_size=replay != NULL ? replay->head.world_size : sph->world_size;
+
+	sim_ratio.x=real_world_side.x/world_size.x;
+	sim_ratio.y=real_world_side.y/world_size.y;
+	sim_ratio.z=real_world_side.z/world_size.z;
+}
+
+void render_replay()
+{
+	glPointSize(1.0f);
+	glColor3f(0.2f, 0.2f, 1.0f);
+
+	for(uint i=0; i<replay->num_particle; i++)
+	{
+		glBegin(GL_POINTS);
+			glVertex3f(replay->pos[i].x*sim_ratio.x+real_world_origin.x, 
+						replay->pos[i].y*sim_ratio.y+real_world_origin.y,
+						replay->pos[i].z*sim_ratio.z+real_world_origin.z);
+		glEnd();
+	}
+}
+
+void render_particles()
+{
+	glPointSize(1.0f);
+	glColor3f(0.2f, 0.2f, 1.0f);
+
+	for(uint i=0; i<sph->num_particle; i++)
+	{
+		glBegin(GL_POINTS);
+			glVertex3f(sph->mem[i].pos.x*sim_ratio.x+real_world_origin.x, 
+						sph->mem[i].pos.y*sim_ratio.y+real_world_origin.y,
+						sph->mem[i].pos.z*sim_ratio.z+real_world_origin.z);
+		glEnd();
+	}
+}
+
+void display_func()
+{
+	glEnable(GL_POINT_SMOOTH);
+	glEnable(GL_DEPTH_TEST);
+	glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    glPushMatrix();
+
+	if(buttonState == 1)
+	{
+		xRot+=(xRotLength-xRot)*0.1f;
+		yRot+=(yRotLength-yRot)*0.1f;
+	}
+
+	glTranslatef(xTrans, yTrans, zTrans);
+    glRotatef(xRot, 1.0f, 0.0f, 0.0f);
+    glRotatef(yRot, 0.0f, 1.0f, 0.0f);
+
+	if(replay != NULL)
+	{
+		if(sph->sys_running && replay_frame+1 < replay->num_frame)
+		{
+			replay_frame++;
+		}
+		replay->seek(replay_frame);
+	}
+	else
+	{
+		sph->animation();
+	}
+
+	if(frame_writer != NULL && sph->sys_running && replay == NULL)
+	{
+		if(frame_count%record_every == 0)
+		{
+			uint num;
+			sph->prof.begin(PHASE_EXPORT);
+			const uint *index=sph->select_particle(&frame_filter, &num);
+			frame_writer->submit(sph->mem, index, num, sph->sim_time);
+			sph->prof.end(PHASE_EXPORT);
+		}
+		frame_count++;
+	}
+
+	sph->prof.begin(PHASE_RENDER);
+	glUseProgram(p);
+	if(replay != NULL)
+	{
+		render_replay();
+	}
+	else
+	{
+		render_particles();
+	}
+
+	glUseProgram(0);
+	draw_box(real_world_origin.x, real_world_origin.y, real_world_origin.z, real_world_side.x, real_world_side.y, real_world_side.z);
+
+	glPopMatrix();
+
+    glutSwapBuffers();
+	sph->prof.end(PHASE_RENDER);
+	sph->prof.end_frame();
+
+	memset(window_title, 0, 512);
+	if(replay != NULL)
+	{
+		sprintf(window_title, "SPH System 3D. FPS: %f Replay: %u/%u Time: %.3f", sph->prof.get_fps(), replay->frame+1, replay->num_frame, replay->time);
+	}
+	else
+	{
+		sprintf(window_title, "SPH System 3D. FPS: %f Steps: %u Iter: %u Sleep: %u ", sph->prof.get_fps(), sph->frame_step, sph->solver_iter, sph->num_sleep);
+		if(frame_writer != NULL)
+		{
+			AsyncStats st=frame_writer->get_stats();
+			sprintf(window_title+strlen(window_title), "Queue: %u/%u Latency: %.1f ms ", st.depth, frame_writer->queue_size, st.sum_latency*1000.0/(st.written > 0 ? st.written : 1));
+		}
+		sph->prof.title(window_title+strlen(window_title), 512-(uint)strlen(window_title));
+	}
+	glutSetWindowTitle(window_title);
+}
+
+void idle_func()
+{
+	glutPostRedisplay();
+}
+
+void reshape_func(GLint width, GLint height)
+{
+	window_width=width;
+	window_height=height;
+
+	glViewport(0, 0, width, height);
+	glMatrixMode(GL_PROJECTION);
+	glLoadIdentity();
+
+	gluPerspective(45.0, (float)width/height, 0.001, 100.0);
+
+	glMatrixMode(GL_MODELVIEW);
+	glLoadIdentity();
+	glTranslatef(0.0f, 0.0f, -3.0f);
+}
+
+void keyboard_func(unsigned char key, int x, int y)
+{
+	if(key == ' ')
+	{
+		sph->sys_running=1-sph->sys_running;
+	}
+
+	if(key == 'm')
+	{
+		sph->solver_mode=(sph->solver_mode+1)%NUM_SOLVER;
+		printf("Solver Mode: %u\n", sph->solver_mode);
+	}
+
+	if(key == 'b')
+	{
+		sph->block_step=1-sph->block_step;
+		printf("Block Step: %u\n", sph->block_step);
+	}
+
+	if(key == 'z')
+	{
+		sph->sleeping=1-sph->sleeping;
+		printf("Sleeping: %u\n", sph->sleeping);
+	}
+
+	if(key == 'r')
+	{
+		sph->adaptive_res=1-sph->adaptive_res;
+		printf("Adaptive Resolution: %u\n", sph->adaptive_res);
+	}
+
+	if(key == 'k')
+	{
+		sph->bound_part=1-sph->bound_part;
+		printf("Boundary Particles: %u%s\n", sph->bound_part, sph->solver_mode == SOLVER_WCSPH ? "" : ", WCSPH only");
+	}
+
+	if(key == 'p')
+	{
+		sph->set_periodic(1-sph->periodic.x, 0, 1-sph->periodic.z);
+		printf("Periodic: %u %u %u\n", sph->periodic.x, sph->periodic.y, sph->periodic.z);
+	}
+
+	if(key == 't')
+	{
+		sph->prof.print();
+	}
+
+	if(key == 'j')
+	{
+		if(trace_enabled.load(std::memory_order_relaxed) == 0)
+		{
+			trace_enabled=1;
+			trace_thread("main");
+			printf("Tracing, press j again to write %s\n", trace_file);
+		}
+		else
+		{
+			trace_dump(trace_file);
+		}
+	}
+
+	if(key == 'c')
+	{
+		if(sph->save_checkpoint("sph.ckpt"))
+		{
+			printf("Checkpoint: sph.ckpt\n");
+		}
+	}
+
+	if(key == 'v')
+	{
+		if(sph->load_checkpoint("sph.ckpt"))
+		{
+			printf("Restart: sph.ckpt\n");
+		}
+	}
+
+	if(replay != NULL && (key == ',' || key == '.'))
+	{
+		sph->sys_running=0;
+		replay_frame=key == ',' ? (replay_frame > 0 ? replay_frame-1 : 0) : (replay_frame+1 < replay->num_frame ? replay_frame+1 : replay_frame);
+	}
+
+	if(replay != NULL && (key == '[' || key == ']'))
+	{
+		uint jump=replay->num_frame/10 > 0 ? replay->num_frame/10 : 1;
+		replay_frame=key == '[' ? (replay_frame > jump ? replay_frame-jump : 0) : (replay_frame+jump < replay->num_frame ? replay_frame+jump : replay->num_frame-1);
+	}
+
+	if(key == 'o')
+	{
+		if(frame_writer == NULL)
+		{
+			start_recording("sph.sphf");
+		}
+		else
+		{
+			delete frame_writer;
+			frame_writer=NULL;
+		}
+	}
+
+	if(key == 'w')
+	{
+		zTrans += 0.3f;
+	}
+
+	if(key == 's')
+	{
+		zTrans -= 0.3f;
+	}
+
+	if(key == 'a')
+	{
+		xTrans -= 0.3f;
+	}
+
+	if(key == 'd')
+	{
+		xTrans += 0.3f;
+	}
+
+	if(key == 'q')
+	{
+		yTrans -= 0.3f;
+	}
+
+	if(key == 'e')
+	{
+		yTrans += 0.3f;
+	}
+
+	glutPostRedisplay();
+}
+
+void mouse_func(int button, int state, int x, int y)
+{
+	if (state == GLUT_DOWN)
+	{
+        buttonState = 1;
+	}
+    else if (state == GLUT_UP)
+	{
+        buttonState = 0;
+	}
+
+    ox = x; oy = y;
+
+    glutPostRedisplay();
+}
+
+void motion_func(int x, int y)
+{
+    float dx, dy;
+    dx = (float)(x - ox);
+    dy = (float)(y - oy);
+
+	if (buttonState == 1) 
+	{
+		xRotLength += dy / 5.0f;
+		yRotLength += dx / 5.0f;
+	}
+
+	ox = x; oy = y;
+
+	glutPostRedisplay();
+}
+
+int main(int argc, char **argv)
+{
+    glutInit(&argc, argv);
+    glutInitDisplayMode(GLUT_RGB | GLUT_DOUBLE);
+    glutInitWindowPosition(0, 0);
+    glutInitWindowSize(window_width, window_height);
+    glutCreateWindow("SPH Fluid 3D");
+
+	init_sph_system(argc, argv);
+	init();
+	init_ratio();
+	set_shaders();
+	glEnable(GL_VERTEX_PROGRAM_POINT_SIZE_NV);
+	glEnable(GL_POINT_SPRITE_ARB);
+	glTexEnvi(GL_POINT_SPRITE_ARB, GL_COORD_REPLACE_ARB, GL_TRUE);
+	glDepthMask(GL_TRUE);
+	glEnable(GL_DEPTH_TEST);
+
+    glutDisplayFunc(display_func);
+	glutReshapeFunc(reshape_func);
+	glutKeyboardFunc(keyboard_func);
+	glutMouseFunc(mouse_func);
+	glutMotionFunc(motion_func);
+	glutIdleFunc(idle_func);
+
+    glutMainLoop();
+
+    return 0;
+}
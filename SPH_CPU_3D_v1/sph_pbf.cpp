@@ -0,0 +1,307 @@
+/** File:		sph_pbf.cpp
+ ** Author:		Dongli Zhang
+ ** Contact:	dongli.zhang0129@gmail.com
+ **
+ ** Copyright (C) Dongli Zhang 2013
+ **
+ ** This program is free software;  you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+ ** the GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program;  if not, write to the Free Software
+ ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "sph_system.h"
+#include "sph_header.h"
+
+/** Position based fluids, Macklin and Muller 2013.
+ **
+ ** Positions are predicted first and written to pos, with the start of step
+ ** position kept in pred_pos, so build_table() and build_neighbor() run on
+ ** the predicted state unchanged. pbf_iter Jacobi sweeps then project the
+ ** density constraints, the velocity is recovered from the displacement and
+ ** smoothed with XSPH. The lambda of each sweep is kept in pres and
+ ** 1/(|grad C|^2+eps) in alpha.
+ **
+ ** pbf_relax and pbf_scorr are dimensionless: eps is pbf_relax times the
+ ** |grad C|^2 of a filled prototype particle, pbf_grad2 from init_pbf(), and
+ ** the tensile correction is applied as an extra constraint error scaled by
+ ** alpha so it stays in the units of lambda whatever kernel and mass are.
+ */
+
+void SPHSystem::init_pbf()
+{
+	float3 sum_grad;
+	float sum_grad2=0.0f;
+	float spacing=kernel*0.5f;
+	int range=(int)ceil(kernel/spacing);
+
+	sum_grad.x=0.0f;
+	sum_grad.y=0.0f;
+	sum_grad.z=0.0f;
+
+	for(int x=-range; x<=range; x++)
+	{
+		for(int y=-range; y<=range; y++)
+		{
+			for(int z=-range; z<=range; z++)
+			{
+				float3 rel_pos;
+				rel_pos.x=x*spacing;
+				rel_pos.y=y*spacing;
+				rel_pos.z=z*spacing;
+
+				float r2=rel_pos.x*rel_pos.x+rel_pos.y*rel_pos.y+rel_pos.z*rel_pos.z;
+				if(r2 <= INF || r2 >= kernel_2)
+				{
+					continue;
+				}
+
+				float r=sqrt(r2);
+				float grad=w_pres.grad(r)/r;
+
+				sum_grad.x+=grad*rel_pos.x;
+				sum_grad.y+=grad*rel_pos.y;
+				sum_grad.z+=grad*rel_pos.z;
+				sum_grad2+=grad*grad*r2;
+			}
+		}
+	}
+
+	pbf_grad2=mass*mass/(lattice_density*lattice_density)*(sum_grad.x*sum_grad.x+sum_grad.y*sum_grad.y+sum_grad.z*sum_grad.z+sum_grad2);
+}
+
+void SPHSystem::pbf_step()
+{
+	Particle *p;
+	float3 move;
+
+	for(uint i=0; i<num_particle; i++)
+	{
+		p=&(mem[i]);
+
+		p->vel.x+=gravity.x*time_step;
+		p->vel.y+=gravity.y*time_step;
+		p->vel.z+=gravity.z*time_step;
+
+		p->pred_pos=p->pos;
+		p->pos.x+=p->vel.x*time_step;
+		p->pos.y+=p->vel.y*time_step;
+		p->pos.z+=p->vel.z*time_step;
+		pbf_clamp(p->pos);
+	}
+
+	build_table();
+	build_neighbor();
+
+	float w_corr=w_dens.value(pbf_scorr_dq*pbf_scorr_dq*kernel_2);
+
+	prof.begin(PHASE_PRESSURE);
+	solver_err=0.0f;
+	for(solver_iter=0; solver_iter<pbf_iter; solver_iter++)
+	{
+		solver_err=pbf_lambda();
+		pbf_project(w_corr);
+	}
+	prof.end(PHASE_PRESSURE);
+
+	float max_v2=0.0f;
+	for(uint i=0; i<num_particle; i++)
+	{
+		p=&(mem[i]);
+		move.x=p->pos.x-p->pred_pos.x;
+		move.y=p->pos.y-p->pred_pos.y;
+		move.z=p->pos.z-p->pred_pos.z;
+		wrap_rel(move);
+
+		p->vel.x=move.x/time_step;
+		p->vel.y=move.y/time_step;
+		p->vel.z=move.z/time_step;
+	}
+
+	pbf_xsph();
+
+	for(uint i=0; i<num_particle; i++)
+	{
+		p=&(mem[i]);
+		p->ev=p->vel;
+
+		float v2=p->vel.x*p->vel.x+p->vel.y*p->vel.y+p->vel.z*p->vel.z;
+		max_v2=v2 > max_v2 ? v2 : max_v2;
+	}
+
+	max_vel=sqrt(max_v2);
+	max_acc=0.0f;
+}
+
+void SPHSystem::pbf_clamp(float3 &pos)
+{
+	obstacle_clamp(pos, NULL);
+
+	clamp_pos(pos);
+}
+
+float SPHSystem::pbf_lambda()
+{
+	Particle *p;
+	Particle *np;
+
+	float3 rel_pos;
+	float3 sum_grad;
+	float sum_grad2;
+	float r2;
+	float r;
+	float grad;
+	float err;
+	float tot_err=0.0f;
+	float inv_rest=1.0f/lattice_density;
+	float eps=pbf_relax*pbf_grad2;
+
+	for(uint i=0; i<num_particle; i++)
+	{
+		p=&(mem[i]);
+
+		p->dens=self_dens;
+		sum_grad.x=0.0f;
+		sum_grad.y=0.0f;
+		sum_grad.z=0.0f;
+		sum_grad2=0.0f;
+
+		for(uint j=nb_start[i]; j<nb_start[i+1]; j++)
+		{
+			np=&(mem[nb_list[j]]);
+
+			rel_pos.x=p->pos.x-np->pos.x;
+			rel_pos.y=p->pos.y-np->pos.y;
+			rel_pos.z=p->pos.z-np->pos.z;
+			wrap_rel(rel_pos);
+			r2=rel_pos.x*rel_pos.x+rel_pos.y*rel_pos.y+rel_pos.z*rel_pos.z;
+
+			if(r2 <= INF || r2 >= kernel_2)
+			{
+				continue;
+			}
+
+			r=sqrt(r2);
+			p->dens+=mass*w_dens.value(r2);
+
+			grad=mass*inv_rest*w_pres.grad(r)/r;
+			sum_grad.x+=grad*rel_pos.x;
+			sum_grad.y+=grad*rel_pos.y;
+			sum_grad.z+=grad*rel_pos.z;
+			sum_grad2+=grad*grad*r2;
+		}
+
+		err=fmax(p->dens*inv_rest-1.0f, 0.0f);
+		tot_err+=err;
+
+		sum_grad2+=sum_grad.x*sum_grad.x+sum_grad.y*sum_grad.y+sum_grad.z*sum_grad.z;
+		p->alpha=1.0f/(sum_grad2+eps);
+		p->pres=-err*p->alpha;
+	}
+
+	return num_particle > 0 ? tot_err/num_particle : 0.0f;
+}
+
+void SPHSystem::pbf_project(float w_corr)
+{
+	Particle *p;
+	Particle *np;
+
+	float3 rel_pos;
+	float r2;
+	float r;
+	float s_corr;
+	float temp;
+	float inv_rest=1.0f/lattice_density;
+
+	for(uint i=0; i<num_particle; i++)
+	{
+		p=&(mem[i]);
+
+		p->pres_acc.x=0.0f;
+		p->pres_acc.y=0.0f;
+		p->pres_acc.z=0.0f;
+
+		for(uint j=nb_start[i]; j<nb_start[i+1]; j++)
+		{
+			np=&(mem[nb_list[j]]);
+
+			rel_pos.x=p->pos.x-np->pos.x;
+			rel_pos.y=p->pos.y-np->pos.y;
+			rel_pos.z=p->pos.z-np->pos.z;
+			wrap_rel(rel_pos);
+			r2=rel_pos.x*rel_pos.x+rel_pos.y*rel_pos.y+rel_pos.z*rel_pos.z;
+
+			if(r2 <= INF || r2 >= kernel_2)
+			{
+				continue;
+			}
+
+			r=sqrt(r2);
+			s_corr=w_dens.value(r2)/w_corr;
+			s_corr=-pbf_scorr*s_corr*s_corr*s_corr*s_corr*0.5f*(p->alpha+np->alpha);
+
+			temp=mass*inv_rest*(p->pres+np->pres+s_corr)*w_pres.grad(r)/r;
+			p->pres_acc.x+=temp*rel_pos.x;
+			p->pres_acc.y+=temp*rel_pos.y;
+			p->pres_acc.z+=temp*rel_pos.z;
+		}
+	}
+
+	for(uint i=0; i<num_particle; i++)
+	{
+		p=&(mem[i]);
+		p->pos.x+=p->pres_acc.x;
+		p->pos.y+=p->pres_acc.y;
+		p->pos.z+=p->pres_acc.z;
+		pbf_clamp(p->pos);
+	}
+}
+
+void SPHSystem::pbf_xsph()
+{
+	Particle *p;
+	Particle *np;
+
+	float3 rel_pos;
+	float r2;
+	float temp;
+
+	for(uint i=0; i<num_particle; i++)
+	{
+		p=&(mem[i]);
+
+		p->pred_vel=p->vel;
+
+		for(uint j=nb_start[i]; j<nb_start[i+1]; j++)
+		{
+			np=&(mem[nb_list[j]]);
+
+			rel_pos.x=p->pos.x-np->pos.x;
+			rel_pos.y=p->pos.y-np->pos.y;
+			rel_pos.z=p->pos.z-np->pos.z;
+			wrap_rel(rel_pos);
+			r2=rel_pos.x*rel_pos.x+rel_pos.y*rel_pos.y+rel_pos.z*rel_pos.z;
+
+			temp=pbf_xsph_coe*mass/np->dens*w_dens.value(r2);
+			p->pred_vel.x+=temp*(np->vel.x-p->vel.x);
+			p->pred_vel.y+=temp*(np->vel.y-p->vel.y);
+			p->pred_vel.z+=temp*(np->vel.z-p->vel.z);
+		}
+	}
+
+	for(uint i=0; i<num_particle; i++)
+	{
+		p=&(mem[i]);
+		p->vel=p->pred_vel;
+	}
+}
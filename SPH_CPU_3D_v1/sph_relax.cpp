@@ -0,0 +1,260 @@
+/** File:		sph_relax.cpp
+ ** Author:		Dongli Zhang
+ ** Contact:	dongli.zhang0129@gmail.com
+ **
+ ** Copyright (C) Dongli Zhang 2013
+ **
+ ** This program is free software;  you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+ ** the GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program;  if not, write to the Free Software
+ ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "sph_system.h"
+#include "sph_header.h"
+#include <string.h>
+
+/** Cached relaxed initial states.
+ **
+ ** init_relaxed() drops the usual lattice with init_system() and hands it to
+ ** relax_cached(), which also takes the fill of a scene. That hashes the
+ ** positions (FNV-1a, 64 bit) together with everything the rest state
+ ** depends on: the
+ ** physical parameters, the walls, periodic axes and obstacles, and the
+ ** relaxation settings. The key names a checkpoint in the cache directory.
+ **
+ ** On a miss relax_system() runs WCSPH with every velocity damped by
+ ** exp(-dt/relax_tau) per step, which takes the collapse without the
+ ** sloshing. It stops when the RMS velocity is below relax_vel, when its
+ ** mean over relax_window is within 5% of the previous window (the pressure
+ ** noise of WCSPH keeps a floor of a few cm/s that damping does not remove),
+ ** or after relax_time.
+ ** The state is saved with zero velocities and step counters.
+ ** On a hit the checkpoint is loaded and the current solver settings are
+ ** put back, so only the particles come from the cache. Either way each
+ ** particle gets its starting velocity back by id, so a scene shape thrown
+ ** in with a velocity settles first and then moves off.
+ */
+
+static unsigned long long relax_hash(unsigned long long key, const void *data, size_t size)
+{
+	const unsigned char *byte=(const unsigned char *)data;
+
+	for(size_t i=0; i<size; i++)
+	{
+		key=(key^byte[i])*1099511628211ULL;
+	}
+
+	return key;
+}
+
+uint SPHSystem::init_relaxed(const char *cache_dir)
+{
+	init_system();
+
+	return relax_cached(cache_dir);
+}
+
+uint SPHSystem::relax_cached(const char *cache_dir)
+{
+	CheckpointHeader user;
+	unsigned long long key;
+	char *file;
+	float3 *vel;
+	FILE *fp;
+	uint num_id=next_id;
+	uint hit=0;
+
+	key=relax_key();
+
+	vel=(float3 *)malloc(sizeof(float3)*(num_id+1));
+	for(uint i=0; i<num_particle; i++)
+	{
+		vel[mem[i].id]=mem[i].vel;
+		mem[i].vel.x=0.0f;
+		mem[i].vel.y=0.0f;
+		mem[i].vel.z=0.0f;
+		mem[i].ev=mem[i].vel;
+	}
+
+	file=(char *)malloc(strlen(cache_dir)+32);
+	sprintf(file, "%s/relax_%016llx.ckpt", cache_dir, key);
+
+	memset(&user, 0, sizeof(user));
+	pack_checkpoint(&user);
+
+	fp=fopen(file, "rb");
+	if(fp != NULL)
+	{
+		fclose(fp);
+		hit=load_checkpoint(file);
+	}
+
+	if(hit)
+	{
+		unpack_checkpoint(&user);
+		printf("Relaxed State: %s\n", file);
+	}
+	else
+	{
+		relax_system();
+		save_checkpoint(file);
+		printf("Relaxed State: %s (new)\n", file);
+	}
+
+	for(uint i=0; i<num_particle; i++)
+	{
+		if(mem[i].id < num_id)
+		{
+			mem[i].vel=vel[mem[i].id];
+			mem[i].ev=mem[i].vel;
+		}
+	}
+
+	free(vel);
+	free(file);
+	return hit;
+}
+
+unsigned long long SPHSystem::relax_key()
+{
+	unsigned long long key=14695981039346656037ULL;
+	uint version=CHECKPOINT_VERSION;
+	uint particle_size=sizeof(Particle);
+
+	key=relax_hash(key, &version, sizeof(version));
+	key=relax_hash(key, &particle_size, sizeof(particle_size));
+
+	for(uint i=0; i<num_particle; i++)
+	{
+		key=relax_hash(key, &(mem[i].pos), sizeof(float3));
+	}
+
+	key=relax_hash(key, &world_size, sizeof(world_size));
+	key=relax_hash(key, &periodic, sizeof(periodic));
+	key=relax_hash(key, &kernel, sizeof(kernel));
+	key=relax_hash(key, &mass, sizeof(mass));
+	key=relax_hash(key, &gravity, sizeof(gravity));
+	key=relax_hash(key, &wall_damping, sizeof(wall_damping));
+	key=relax_hash(key, &rest_density, sizeof(rest_density));
+	key=relax_hash(key, &gas_constant, sizeof(gas_constant));
+	key=relax_hash(key, &viscosity, sizeof(viscosity));
+	key=relax_hash(key, &surf_norm, sizeof(surf_norm));
+	key=relax_hash(key, &surf_coe, sizeof(surf_coe));
+	key=relax_hash(key, &bound_part, sizeof(bound_part));
+	key=relax_hash(key, &obstacle_margin, sizeof(obstacle_margin));
+
+	for(uint i=0; i<num_obstacle; i++)
+	{
+		SDFVolume *sdf=obstacle[i];
+		key=relax_hash(key, &(sdf->res), sizeof(sdf->res));
+		key=relax_hash(key, &(sdf->origin), sizeof(sdf->origin));
+		key=relax_hash(key, &(sdf->voxel), sizeof(sdf->voxel));
+		key=relax_hash(key, sdf->dist, sizeof(float)*sdf->res.x*sdf->res.y*sdf->res.z);
+	}
+
+	key=relax_hash(key, &relax_tau, sizeof(relax_tau));
+	key=relax_hash(key, &relax_vel, sizeof(relax_vel));
+	key=relax_hash(key, &relax_window, sizeof(relax_window));
+	key=relax_hash(key, &relax_time, sizeof(relax_time));
+
+	return key;
+}
+
+void SPHSystem::relax_system()
+{
+	CheckpointHeader user;
+	Particle *p;
+	float elapsed=0.0f;
+	float damp;
+	float v2;
+	float rms=0.0f;
+	float window_rms=0.0f;
+	float window_time=0.0f;
+	float last_rms=0.0f;
+	uint steps=0;
+
+	memset(&user, 0, sizeof(user));
+	pack_checkpoint(&user);
+
+	solver_mode=SOLVER_WCSPH;
+	integrator=INTEGRATOR_EULER;
+	block_step=0;
+	sleeping=0;
+	adaptive_res=0;
+
+	while(elapsed < relax_time)
+	{
+		time_step=comp_time_step();
+		step();
+
+		damp=exp(-time_step/relax_tau);
+		v2=0.0f;
+		for(uint i=0; i<num_particle; i++)
+		{
+			p=&(mem[i]);
+			p->vel.x*=damp;
+			p->vel.y*=damp;
+			p->vel.z*=damp;
+			p->ev.x*=damp;
+			p->ev.y*=damp;
+			p->ev.z*=damp;
+			v2+=p->vel.x*p->vel.x+p->vel.y*p->vel.y+p->vel.z*p->vel.z;
+		}
+
+		elapsed+=time_step;
+		steps++;
+
+		rms=num_particle > 0 ? sqrt(v2/num_particle) : 0.0f;
+		if(rms < relax_vel)
+		{
+			break;
+		}
+
+		window_rms+=rms*time_step;
+		window_time+=time_step;
+		if(window_time >= relax_window)
+		{
+			window_rms/=window_time;
+			if(last_rms > 0.0f && fabs(window_rms-last_rms) < 0.05f*last_rms)
+			{
+				break;
+			}
+			last_rms=window_rms;
+			window_rms=0.0f;
+			window_time=0.0f;
+		}
+	}
+
+	unpack_checkpoint(&user);
+
+	for(uint i=0; i<num_particle; i++)
+	{
+		p=&(mem[i]);
+		p->vel.x=0.0f;
+		p->vel.y=0.0f;
+		p->vel.z=0.0f;
+		p->ev=p->vel;
+		p->acc=p->vel;
+		p->level=0;
+		p->active=1;
+		p->last_step=0.0f;
+		p->sleep=0;
+	}
+
+	for(uint i=0; i<tot_cell; i++)
+	{
+		cell_quiet[i]=0;
+	}
+
+	printf("Relaxed: %u steps, %f s, rms velocity %f\n", steps, elapsed, rms);
+}
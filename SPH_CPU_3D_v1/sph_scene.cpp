@@ -0,0 +1,757 @@
+/** File:		sph_scene.cpp
+ ** Author:		Dongli Zhang
+ ** Contact:	dongli.zhang0129@gmail.com
+ **
+ ** Copyright (C) Dongli Zhang 2013
+ **
+ ** This program is free software;  you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+ ** the GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program;  if not, write to the Free Software
+ ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "sph_system.h"
+#include "sph_header.h"
+#include "sph_frame.h"
+#include <string.h>
+
+/** Scene files, one statement per line, # starts a comment:
+ **
+ **   <parameter> <value>                  any of the members in scene_param()
+ **   box x0 y0 z0 x1 y1 z1 [vx vy vz]      fluid block
+ **   sphere cx cy cz r [vx vy vz]          fluid ball
+ **   emitter px py pz vx vy vz r [t0 t1]   disc of radius r shooting along v
+ **   obstacle file.obj [voxel]             SDF obstacle, see add_obstacle()
+ **   output file.sphf [every] [pvd]        frame file, every n-th frame
+ **   roi box x0 y0 z0 x1 y1 z1             only write the particles in a box
+ **   roi sphere cx cy cz r                 or in a sphere
+ **   sample n                              and of those one in n by id
+ **   checkpoint file.ckpt every            checkpoint every n frames
+ **   end_time seconds                      simulated time to stop at
+ **
+ ** The whole file is read before anything is built, so statements may come
+ ** in any order. init_params() then runs once with the final parameters,
+ ** the obstacles are voxelized and the shapes are filled on the usual
+ ** kernel*0.5 lattice. A point already inside an earlier shape, outside the
+ ** world or within obstacle_margin of an obstacle is skipped.
+ **
+ ** Filling is two passes over the x planes of a shape: the first counts the
+ ** points of every plane, which gives each plane its offset into mem, and
+ ** the second writes them. Both run one plane per thread, so the particles
+ ** come out in the same order as a serial fill and mem grows only once per
+ ** shape.
+ */
+
+enum ParamType
+{
+	PARAM_FLOAT=0,
+	PARAM_UINT=1,
+	PARAM_FLOAT3=2,
+	PARAM_UINT3=3,
+	PARAM_SOLVER=4,
+	PARAM_INTEGRATOR=5
+};
+
+struct SceneParam
+{
+	const char *name;
+	uint type;
+	void *value;
+};
+
+struct SceneValue
+{
+	void *value;
+	uint size;
+	float3 data;
+	float3 prev;
+};
+
+static const char *scene_solver[NUM_SOLVER]=
+{
+	"wcsph",
+	"dfsph",
+	"iisph",
+	"pbf"
+};
+
+static const char *scene_integrator[NUM_INTEGRATOR]=
+{
+	"euler",
+	"leapfrog"
+};
+
+void *SPHSystem::scene_param(const char *name, uint *type)
+{
+	SceneParam param[]=
+	{
+		{"kernel", PARAM_FLOAT, &kernel},
+		{"mass", PARAM_FLOAT, &mass},
+		{"world_size", PARAM_FLOAT3, &world_size},
+		{"gravity", PARAM_FLOAT3, &gravity},
+		{"wall_damping", PARAM_FLOAT, &wall_damping},
+		{"rest_density", PARAM_FLOAT, &rest_density},
+		{"gas_constant", PARAM_FLOAT, &gas_constant},
+		{"viscosity", PARAM_FLOAT, &viscosity},
+		{"time_step", PARAM_FLOAT, &time_step},
+		{"surf_norm", PARAM_FLOAT, &surf_norm},
+		{"surf_coe", PARAM_FLOAT, &surf_coe},
+		{"integrator", PARAM_INTEGRATOR, &integrator},
+		{"adaptive_step", PARAM_UINT, &adaptive_step},
+		{"frame_time", PARAM_FLOAT, &frame_time},
+		{"min_time_step", PARAM_FLOAT, &min_time_step},
+		{"max_time_step", PARAM_FLOAT, &max_time_step},
+		{"max_implicit_step", PARAM_FLOAT, &max_implicit_step},
+		{"cfl_factor", PARAM_FLOAT, &cfl_factor},
+		{"force_factor", PARAM_FLOAT, &force_factor},
+		{"visc_factor", PARAM_FLOAT, &visc_factor},
+		{"solver_mode", PARAM_SOLVER, &solver_mode},
+		{"max_dens_err", PARAM_FLOAT, &max_dens_err},
+		{"min_iter", PARAM_UINT, &min_iter},
+		{"max_iter", PARAM_UINT, &max_iter},
+		{"jacobi_omega", PARAM_FLOAT, &jacobi_omega},
+		{"pbf_iter", PARAM_UINT, &pbf_iter},
+		{"pbf_relax", PARAM_FLOAT, &pbf_relax},
+		{"pbf_scorr", PARAM_FLOAT, &pbf_scorr},
+		{"pbf_scorr_dq", PARAM_FLOAT, &pbf_scorr_dq},
+		{"pbf_xsph_coe", PARAM_FLOAT, &pbf_xsph_coe},
+		{"max_div_err", PARAM_FLOAT, &max_div_err},
+		{"max_div_iter", PARAM_UINT, &max_div_iter},
+		{"block_step", PARAM_UINT, &block_step},
+		{"max_level", PARAM_UINT, &max_level},
+		{"sleeping", PARAM_UINT, &sleeping},
+		{"sleep_vel", PARAM_FLOAT, &sleep_vel},
+		{"sleep_dens", PARAM_FLOAT, &sleep_dens},
+		{"sleep_steps", PARAM_UINT, &sleep_steps},
+		{"adaptive_res", PARAM_UINT, &adaptive_res},
+		{"adapt_max_level", PARAM_UINT, &adapt_max_level},
+		{"adapt_depth", PARAM_UINT, &adapt_depth},
+		{"adapt_interval", PARAM_UINT, &adapt_interval},
+		{"obstacle_margin", PARAM_FLOAT, &obstacle_margin},
+		{"bound_part", PARAM_UINT, &bound_part},
+		{"periodic", PARAM_UINT3, &periodic},
+		{"relax_tau", PARAM_FLOAT, &relax_tau},
+		{"relax_vel", PARAM_FLOAT, &relax_vel},
+		{"relax_window", PARAM_FLOAT, &relax_window},
+		{"relax_time", PARAM_FLOAT, &relax_time}
+	};
+
+	for(uint i=0; i<sizeof(param)/sizeof(param[0]); i++)
+	{
+		if(strcmp(name, param[i].name) == 0)
+		{
+			*type=param[i].type;
+			return param[i].value;
+		}
+	}
+
+	return NULL;
+}
+
+static uint scene_name(const char *value, const char **name, uint num, uint *result)
+{
+	for(uint i=0; i<num; i++)
+	{
+		if(strcmp(value, name[i]) == 0)
+		{
+			*result=i;
+			return 1;
+		}
+	}
+
+	return sscanf(value, "%u", result) == 1 && *result < num;
+}
+
+static uint scene_set(void *value, uint type, const char *arg)
+{
+	char word[64];
+	float3 *f3;
+	uint3 *u3;
+
+	switch(type)
+	{
+	case PARAM_FLOAT:
+		return sscanf(arg, "%f", (float *)value) == 1;
+	case PARAM_UINT:
+		return sscanf(arg, "%u", (uint *)value) == 1;
+	case PARAM_FLOAT3:
+		f3=(float3 *)value;
+		return sscanf(arg, "%f %f %f", &(f3->x), &(f3->y), &(f3->z)) == 3;
+	case PARAM_UINT3:
+		u3=(uint3 *)value;
+		return sscanf(arg, "%u %u %u", &(u3->x), &(u3->y), &(u3->z)) == 3;
+	case PARAM_SOLVER:
+		return sscanf(arg, "%63s", word) == 1 && scene_name(word, scene_solver, NUM_SOLVER, (uint *)value);
+	case PARAM_INTEGRATOR:
+		return sscanf(arg, "%63s", word) == 1 && scene_name(word, scene_integrator, NUM_INTEGRATOR, (uint *)value);
+	}
+
+	return 0;
+}
+
+/** A parameter line is parsed into a SceneValue, not into the member, so a
+ ** bad line further down leaves the system as it was. The values are only
+ ** swapped in once the whole file has parsed, and swapped back if building
+ ** the scene fails after that.
+ */
+
+static uint scene_store(SceneValue *list, uint *num, void *value, uint type, const float3 *data)
+{
+	uint i=0;
+
+	while(i < *num && list[i].value != value)
+	{
+		i++;
+	}
+
+	if(i == MAX_SCENE_PARAM)
+	{
+		return 0;
+	}
+
+	list[i].value=value;
+	list[i].size=(type == PARAM_FLOAT3 || type == PARAM_UINT3) ? sizeof(float3) : sizeof(uint);
+	memcpy(&(list[i].data), data, list[i].size);
+	*num=i == *num ? i+1 : *num;
+
+	return 1;
+}
+
+static void scene_swap(SceneValue *list, uint num, uint undo)
+{
+	for(uint i=0; i<num; i++)
+	{
+		if(undo)
+		{
+			memcpy(list[i].value, &(list[i].prev), list[i].size);
+		}
+		else
+		{
+			memcpy(&(list[i].prev), list[i].value, list[i].size);
+			memcpy(list[i].value, &(list[i].data), list[i].size);
+		}
+	}
+}
+
+/** extra are obstacle meshes given outside the scene, on the command line.
+ ** They are voxelized with the scene kernel next to the scene's own, so the
+ ** fill steers clear of them as well. On failure nothing is kept: the
+ ** parameters, periodic axes, obstacles, emitters and output are those from
+ ** before the call.
+ */
+
+uint SPHSystem::load_scene(const char *file, char **extra, uint num_extra)
+{
+	FILE *fp;
+	char line[512];
+	char key[64];
+	char path[SCENE_PATH];
+	char attrib[8];
+	char *arg;
+	int len;
+	uint line_no=0;
+	uint ok=1;
+
+	SceneShape shape[MAX_SCENE_SHAPE];
+	uint num_shape=0;
+	SceneShape *s;
+	Emitter jet[MAX_EMITTER];
+	uint num_jet=0;
+	Emitter *e;
+	SceneOutput out;
+	char mesh[MAX_OBSTACLE][SCENE_PATH];
+	float voxel[MAX_OBSTACLE];
+	uint num_mesh=0;
+	SceneValue param[MAX_SCENE_PARAM];
+	uint num_param=0;
+	uint margin_set=0;
+	uint type;
+	void *value;
+	float3 data;
+	uint3 axis;
+	float3 prev_world;
+	float prev_margin;
+	uint3 prev_periodic;
+	uint prev_any;
+	int count;
+
+	if(num_particle > 0 || num_obstacle > 0)
+	{
+		printf("Scene needs an empty system: %s\n", file);
+		return 0;
+	}
+
+	fp=fopen(file, "r");
+	if(fp == NULL)
+	{
+		printf("Cannot open scene %s\n", file);
+		return 0;
+	}
+
+	memset(&out, 0, sizeof(out));
+	path[0]='\0';
+
+	while(ok && fgets(line, sizeof(line), fp) != NULL)
+	{
+		line_no++;
+
+		arg=strchr(line, '#');
+		if(arg != NULL)
+		{
+			*arg='\0';
+		}
+
+		if(sscanf(line, "%63s%n", key, &len) != 1)
+		{
+			continue;
+		}
+		arg=line+len;
+
+		if(strcmp(key, "box") == 0 || strcmp(key, "sphere") == 0)
+		{
+			if(num_shape == MAX_SCENE_SHAPE)
+			{
+				printf("scene:%u: more than %u shapes\n", line_no, MAX_SCENE_SHAPE);
+				ok=0;
+				break;
+			}
+
+			s=&(shape[num_shape]);
+			memset(s, 0, sizeof(SceneShape));
+
+			if(key[0] == 'b')
+			{
+				s->type=SHAPE_BOX;
+				count=sscanf(arg, "%f %f %f %f %f %f %f %f %f", &(s->lo.x), &(s->lo.y), &(s->lo.z), &(s->hi.x), &(s->hi.y), &(s->hi.z), &(s->vel.x), &(s->vel.y), &(s->vel.z));
+				ok=count == 6 || count == 9;
+			}
+			else
+			{
+				s->type=SHAPE_SPHERE;
+				count=sscanf(arg, "%f %f %f %f %f %f %f", &(s->center.x), &(s->center.y), &(s->center.z), &(s->radius), &(s->vel.x), &(s->vel.y), &(s->vel.z));
+				ok=(count == 4 || count == 7) && s->radius > 0.0f;
+
+				s->lo.x=s->center.x-s->radius;
+				s->lo.y=s->center.y-s->radius;
+				s->lo.z=s->center.z-s->radius;
+				s->hi.x=s->center.x+s->radius;
+				s->hi.y=s->center.y+s->radius;
+				s->hi.z=s->center.z+s->radius;
+			}
+
+			num_shape++;
+		}
+		else if(strcmp(key, "emitter") == 0)
+		{
+			if(num_jet == MAX_EMITTER)
+			{
+				printf("scene:%u: more than %u emitters\n", line_no, MAX_EMITTER);
+				ok=0;
+				break;
+			}
+
+			e=&(jet[num_jet]);
+			e->start=0.0f;
+			e->stop=0.0f;
+			count=sscanf(arg, "%f %f %f %f %f %f %f %f %f", &(e->pos.x), &(e->pos.y), &(e->pos.z), &(e->vel.x), &(e->vel.y), &(e->vel.z), &(e->radius), &(e->start), &(e->stop));
+			ok=count >= 7 && count != 8 && e->radius > 0.0f;
+
+			num_jet++;
+		}
+		else if(strcmp(key, "obstacle") == 0)
+		{
+			if(num_mesh == MAX_OBSTACLE)
+			{
+				printf("scene:%u: more than %u obstacles\n", line_no, MAX_OBSTACLE);
+				ok=0;
+				break;
+			}
+
+			voxel[num_mesh]=0.0f;
+			count=sscanf(arg, "%255s %f", mesh[num_mesh], &(voxel[num_mesh]));
+			ok=count >= 1;
+
+			num_mesh++;
+		}
+		else if(strcmp(key, "output") == 0)
+		{
+			out.frame_every=1;
+			out.frame_attrib=FRAME_POS;
+			attrib[0]='\0';
+			count=sscanf(arg, "%255s %u %7s", path, &(out.frame_every), attrib);
+			ok=count >= 1 && out.frame_every > 0;
+			strcpy(out.frame_file, path);
+
+			if(attrib[0] != '\0')
+			{
+				out.frame_attrib=(strchr(attrib, 'p') ? FRAME_POS : 0) | (strchr(attrib, 'v') ? FRAME_VEL : 0) | (strchr(attrib, 'd') ? FRAME_DENS : 0);
+				ok=ok && out.frame_attrib != 0;
+			}
+		}
+		else if(strcmp(key, "roi") == 0)
+		{
+			ExportFilter *f=&(out.frame_filter);
+			char region[16];
+
+			if(sscanf(arg, "%15s%n", region, &len) != 1)
+			{
+				ok=0;
+			}
+			else if(strcmp(region, "box") == 0)
+			{
+				f->region=EXPORT_BOX;
+				ok=sscanf(arg+len, "%f %f %f %f %f %f", &(f->lo.x), &(f->lo.y), &(f->lo.z), &(f->hi.x), &(f->hi.y), &(f->hi.z)) == 6;
+			}
+			else if(strcmp(region, "sphere") == 0)
+			{
+				f->region=EXPORT_SPHERE;
+				ok=sscanf(arg+len, "%f %f %f %f", &(f->center.x), &(f->center.y), &(f->center.z), &(f->radius)) == 4;
+			}
+			else
+			{
+				ok=0;
+			}
+		}
+		else if(strcmp(key, "sample") == 0)
+		{
+			ok=sscanf(arg, "%u", &(out.frame_filter.sample)) == 1;
+		}
+		else if(strcmp(key, "checkpoint") == 0)
+		{
+			count=sscanf(arg, "%255s %u", path, &(out.checkpoint_every));
+			ok=count == 2 && out.checkpoint_every > 0;
+			strcpy(out.checkpoint_file, path);
+		}
+		else if(strcmp(key, "end_time") == 0)
+		{
+			ok=sscanf(arg, "%f", &(out.end_time)) == 1;
+		}
+		else
+		{
+			value=scene_param(key, &type);
+			if(value == NULL)
+			{
+				printf("scene:%u: unknown statement %s\n", line_no, key);
+				ok=0;
+				break;
+			}
+
+			ok=scene_set(&data, type, arg) && scene_store(param, &num_param, value, type, &data);
+			margin_set=margin_set || value == &obstacle_margin;
+		}
+
+		if(ok == 0)
+		{
+			printf("scene:%u: bad arguments for %s\n", line_no, key);
+		}
+	}
+
+	fclose(fp);
+
+	if(ok == 0)
+	{
+		return 0;
+	}
+
+	prev_world=world_size;
+	prev_margin=obstacle_margin;
+	prev_periodic=periodic;
+	prev_any=any_periodic;
+
+	scene_swap(param, num_param, 0);
+
+	if(margin_set == 0)
+	{
+		obstacle_margin=kernel*0.25f;
+	}
+
+	axis=periodic;
+	periodic.x=0;
+	periodic.y=0;
+	periodic.z=0;
+	any_periodic=0;
+
+	init_params();
+
+	if(axis.x || axis.y || axis.z)
+	{
+		set_periodic(axis.x, axis.y, axis.z);
+		ok=any_periodic;
+	}
+
+	for(uint i=0; ok && i<num_mesh; i++)
+	{
+		ok=add_obstacle(mesh[i], voxel[i] > 0.0f ? voxel[i] : kernel*0.125f);
+	}
+
+	for(uint i=0; ok && i<num_extra; i++)
+	{
+		ok=add_obstacle(extra[i], kernel*0.125f);
+	}
+
+	if(ok == 0)
+	{
+		for(uint i=0; i<num_obstacle; i++)
+		{
+			delete obstacle[i];
+		}
+		num_obstacle=0;
+
+		scene_swap(param, num_param, 1);
+		world_size=prev_world;
+		obstacle_margin=prev_margin;
+		periodic=prev_periodic;
+		any_periodic=prev_any;
+		init_params();
+
+		printf("Cannot build scene %s\n", file);
+		return 0;
+	}
+
+	for(uint i=0; i<num_shape; i++)
+	{
+		fill_shape(shape, i);
+	}
+
+	memcpy(emitter, jet, sizeof(Emitter)*num_jet);
+	num_emitter=num_jet;
+	for(uint i=0; i<num_emitter; i++)
+	{
+		emitter[i].carry=kernel*0.5f;
+	}
+
+	output=out;
+	sim_time=0.0f;
+
+	printf("Scene: %s, %u shapes, %u emitters, %u obstacles\n", file, num_shape, num_emitter, num_obstacle);
+	printf("Init Particle: %u\n", num_particle);
+
+	return 1;
+}
+
+uint SPHSystem::scene_inside(const SceneShape *shape, float3 pos)
+{
+	float3 rel_pos;
+
+	if(shape->type == SHAPE_BOX)
+	{
+		return pos.x >= shape->lo.x && pos.x < shape->hi.x
+			&& pos.y >= shape->lo.y && pos.y < shape->hi.y
+			&& pos.z >= shape->lo.z && pos.z < shape->hi.z;
+	}
+
+	rel_pos.x=pos.x-shape->center.x;
+	rel_pos.y=pos.y-shape->center.y;
+	rel_pos.z=pos.z-shape->center.z;
+
+	return rel_pos.x*rel_pos.x+rel_pos.y*rel_pos.y+rel_pos.z*rel_pos.z < shape->radius*shape->radius;
+}
+
+uint SPHSystem::fill_shape(const SceneShape *shape, uint index)
+{
+	const SceneShape *s=&(shape[index]);
+	float spacing=kernel*0.5f;
+	int3 num;
+	uint *plane;
+	uint base=num_particle;
+	uint total;
+
+	num.x=(int)ceil((s->hi.x-s->lo.x)/spacing);
+	num.y=(int)ceil((s->hi.y-s->lo.y)/spacing);
+	num.z=(int)ceil((s->hi.z-s->lo.z)/spacing);
+
+	if(num.x <= 0 || num.y <= 0 || num.z <= 0)
+	{
+		return 0;
+	}
+
+	plane=(uint *)malloc(sizeof(uint)*(num.x+1));
+	plane[0]=0;
+
+	for(uint pass=0; pass<2; pass++)
+	{
+		#pragma omp parallel for schedule(dynamic)
+		for(int x=0; x<num.x; x++)
+		{
+			float3 pos;
+			uint count=0;
+			uint inside;
+
+			pos.x=s->lo.x+x*spacing;
+			for(int y=0; y<num.y; y++)
+			{
+				pos.y=s->lo.y+y*spacing;
+				for(int z=0; z<num.z; z++)
+				{
+					pos.z=s->lo.z+z*spacing;
+
+					if(pos.x < 0.0f || pos.x >= world_size.x-BOUNDARY || pos.y < 0.0f || pos.y >= world_size.y-BOUNDARY || pos.z < 0.0f || pos.z >= world_size.z-BOUNDARY)
+					{
+						continue;
+					}
+
+					if(scene_inside(s, pos) == 0)
+					{
+						continue;
+					}
+
+					inside=0;
+					for(uint i=0; i<index && inside == 0; i++)
+					{
+						inside=scene_inside(&(shape[i]), pos);
+					}
+
+					if(inside || obstacle_dist(pos) < obstacle_margin)
+					{
+						continue;
+					}
+
+					if(pass == 1)
+					{
+						uint id=base+plane[x]+count;
+						init_particle(&(mem[id]), next_id+plane[x]+count, pos, s->vel);
+					}
+					count++;
+				}
+			}
+
+			if(pass == 0)
+			{
+				plane[x+1]=count;
+			}
+		}
+
+		if(pass == 0)
+		{
+			for(int x=0; x<num.x; x++)
+			{
+				plane[x+1]+=plane[x];
+			}
+
+			reserve_particle(base+plane[num.x]);
+		}
+	}
+
+	total=plane[num.x];
+	num_particle+=total;
+	next_id+=total;
+	free(plane);
+
+	return total;
+}
+
+/** An emitter is a disc at pos facing along vel. Once the fluid it let out
+ ** has moved on by a lattice spacing, the next layer goes in behind it, so
+ ** the stream keeps the rest spacing whatever the frame time. carry is the
+ ** distance travelled since the last layer, and a layer placed late is
+ ** moved downstream by the remainder. mem grows by doubling, the table is
+ ** rebuilt at the start of the next step anyway.
+ */
+
+void SPHSystem::emit(float dt)
+{
+	Emitter *e;
+	float speed;
+	float spacing=kernel*0.5f;
+
+	for(uint i=0; i<num_emitter; i++)
+	{
+		e=&(emitter[i]);
+
+		if(sim_time < e->start || (e->stop > e->start && sim_time > e->stop))
+		{
+			continue;
+		}
+
+		speed=sqrt(e->vel.x*e->vel.x+e->vel.y*e->vel.y+e->vel.z*e->vel.z);
+		if(speed <= INF)
+		{
+			continue;
+		}
+
+		e->carry+=speed*dt;
+		while(e->carry >= spacing)
+		{
+			e->carry-=spacing;
+			emit_layer(e, e->carry);
+		}
+	}
+}
+
+void SPHSystem::emit_layer(Emitter *e, float offset)
+{
+	float spacing=kernel*0.5f;
+	float speed=sqrt(e->vel.x*e->vel.x+e->vel.y*e->vel.y+e->vel.z*e->vel.z);
+	int range=(int)(e->radius/spacing);
+	float3 dir;
+	float3 u;
+	float3 w;
+	float3 pos;
+	float len;
+
+	dir.x=e->vel.x/speed;
+	dir.y=e->vel.y/speed;
+	dir.z=e->vel.z/speed;
+
+	if(fabs(dir.x) < 0.9f)
+	{
+		u.x=0.0f;
+		u.y=dir.z;
+		u.z=-dir.y;
+	}
+	else
+	{
+		u.x=-dir.z;
+		u.y=0.0f;
+		u.z=dir.x;
+	}
+	len=sqrt(u.x*u.x+u.y*u.y+u.z*u.z);
+	u.x/=len;
+	u.y/=len;
+	u.z/=len;
+
+	w.x=dir.y*u.z-dir.z*u.y;
+	w.y=dir.z*u.x-dir.x*u.z;
+	w.z=dir.x*u.y-dir.y*u.x;
+
+	for(int a=-range; a<=range; a++)
+	{
+		for(int b=-range; b<=range; b++)
+		{
+			if((a*a+b*b)*spacing*spacing > e->radius*e->radius)
+			{
+				continue;
+			}
+
+			pos.x=e->pos.x+dir.x*offset+(u.x*a+w.x*b)*spacing;
+			pos.y=e->pos.y+dir.y*offset+(u.y*a+w.y*b)*spacing;
+			pos.z=e->pos.z+dir.z*offset+(u.z*a+w.z*b)*spacing;
+
+			if(pos.x < 0.0f || pos.x >= world_size.x-BOUNDARY || pos.y < 0.0f || pos.y >= world_size.y-BOUNDARY || pos.z < 0.0f || pos.z >= world_size.z-BOUNDARY)
+			{
+				continue;
+			}
+
+			if(obstacle_dist(pos) < obstacle_margin)
+			{
+				continue;
+			}
+
+			if(num_particle == max_particle)
+			{
+				reserve_particle(max_particle*2);
+			}
+
+			add_particle(pos, e->vel);
+		}
+	}
+}
@@ -0,0 +1,70 @@
+/** File:		sph_scene.h
+ ** Author:		Dongli Zhang
+ ** Contact:	dongli.zhang0129@gmail.com
+ **
+ ** Copyright (C) Dongli Zhang 2013
+ **
+ ** This program is free software;  you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+ ** the GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program;  if not, write to the Free Software
+ ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef __SPHSCENE_H__
+#define __SPHSCENE_H__
+
+#include "sph_type.h"
+#include "sph_export.h"
+
+#define MAX_SCENE_SHAPE 64
+#define MAX_SCENE_PARAM 64
+#define MAX_EMITTER 16
+#define SCENE_PATH 256
+
+enum ShapeType
+{
+	SHAPE_BOX=0,
+	SHAPE_SPHERE=1
+};
+
+struct SceneShape
+{
+	uint type;
+	float3 lo;
+	float3 hi;
+	float3 center;
+	float radius;
+	float3 vel;
+};
+
+struct Emitter
+{
+	float3 pos;
+	float3 vel;
+	float radius;
+	float start;
+	float stop;
+	float carry;
+};
+
+struct SceneOutput
+{
+	char frame_file[SCENE_PATH];
+	uint frame_every;
+	uint frame_attrib;
+	ExportFilter frame_filter;
+	char checkpoint_file[SCENE_PATH];
+	uint checkpoint_every;
+	float end_time;
+};
+
+#endif
@@ -0,0 +1,571 @@
+/** File:		sph_sdf.cpp
+ ** Author:		Dongli Zhang
+ ** Contact:	dongli.zhang0129@gmail.com
+ **
+ ** Copyright (C) Dongli Zhang 2013
+ **
+ ** This program is free software;  you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+ ** the GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program;  if not, write to the Free Software 
+ ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "sph_sdf.h"
+#include "sph_header.h"
+#include <string.h>
+#include <sys/stat.h>
+
+/** Static obstacles as signed distance volumes.
+ **
+ ** A triangle mesh (Wavefront OBJ, v and f lines, polygons fanned into
+ ** triangles) is voxelized once on a grid padded by two voxels around its
+ ** bounding box. The distance at each node is the exact distance to the
+ ** nearest triangle, negative inside, with the sign taken from the parity
+ ** of crossings along a ray in +x so the mesh has to be closed. The volume
+ ** is cached next to the mesh as <mesh>.sdf and reused while the mesh time
+ ** and the voxel size match, so a run only pays for trilinear lookups.
+ */
+
+static const char sdf_magic[4]={'S', 'D', 'F', '1'};
+
+static float3 sub3(float3 a, float3 b)
+{
+	float3 c;
+	c.x=a.x-b.x;
+	c.y=a.y-b.y;
+	c.z=a.z-b.z;
+	return c;
+}
+
+static float dot3(float3 a, float3 b)
+{
+	return a.x*b.x+a.y*b.y+a.z*b.z;
+}
+
+static float3 mad3(float3 a, float3 b, float s)
+{
+	float3 c;
+	c.x=a.x+b.x*s;
+	c.y=a.y+b.y*s;
+	c.z=a.z+b.z*s;
+	return c;
+}
+
+/** Squared distance from p to the triangle abc, Ericson 2005 5.1.5. */
+static float tri_dist2(float3 p, float3 a, float3 b, float3 c)
+{
+	float3 ab=sub3(b, a);
+	float3 ac=sub3(c, a);
+	float3 ap=sub3(p, a);
+	float3 q;
+
+	float d1=dot3(ab, ap);
+	float d2=dot3(ac, ap);
+	if(d1 <= 0.0f && d2 <= 0.0f)
+	{
+		return dot3(ap, ap);
+	}
+
+	float3 bp=sub3(p, b);
+	float d3=dot3(ab, bp);
+	float d4=dot3(ac, bp);
+	if(d3 >= 0.0f && d4 <= d3)
+	{
+		return dot3(bp, bp);
+	}
+
+	float vc=d1*d4-d3*d2;
+	if(vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+	{
+		q=sub3(p, mad3(a, ab, d1/(d1-d3)));
+		return dot3(q, q);
+	}
+
+	float3 cp=sub3(p, c);
+	float d5=dot3(ab, cp);
+	float d6=dot3(ac, cp);
+	if(d6 >= 0.0f && d5 <= d6)
+	{
+		return dot3(cp, cp);
+	}
+
+	float vb=d5*d2-d1*d6;
+	if(vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+	{
+		q=sub3(p, mad3(a, ac, d2/(d2-d6)));
+		return dot3(q, q);
+	}
+
+	float va=d3*d6-d5*d4;
+	if(va <= 0.0f && (d4-d3) >= 0.0f && (d5-d6) >= 0.0f)
+	{
+		q=sub3(p, mad3(b, sub3(c, b), (d4-d3)/((d4-d3)+(d5-d6))));
+		return dot3(q, q);
+	}
+
+	float denom=1.0f/(va+vb+vc);
+	q=sub3(p, mad3(mad3(a, ab, vb*denom), ac, vc*denom));
+	return dot3(q, q);
+}
+
+static int cmp_float(const void *a, const void *b)
+{
+	float fa=*(const float *)a;
+	float fb=*(const float *)b;
+	return (fa > fb)-(fa < fb);
+}
+
+static long long file_time(const char *file)
+{
+	struct stat info;
+
+	if(stat(file, &info) != 0)
+	{
+		return -1;
+	}
+
+	return (long long)info.st_mtime;
+}
+
+SDFVolume::SDFVolume()
+{
+	res.x=0;
+	res.y=0;
+	res.z=0;
+	origin.x=0.0f;
+	origin.y=0.0f;
+	origin.z=0.0f;
+	voxel=0.0f;
+	dist=NULL;
+}
+
+SDFVolume::~SDFVolume()
+{
+	free(dist);
+}
+
+uint SDFVolume::build(const char *mesh_file, float voxel_size)
+{
+	char cache_file[512];
+	long long mesh_time;
+	float3 *vert;
+	uint3 *tri;
+	uint num_tri;
+
+	mesh_time=file_time(mesh_file);
+	if(mesh_time < 0)
+	{
+		printf("SDF: cannot open %s\n", mesh_file);
+		return 0;
+	}
+
+	sprintf(cache_file, "%.500s.sdf", mesh_file);
+	if(load(cache_file, mesh_time, voxel_size))
+	{
+		printf("SDF: %s loaded from cache (%u x %u x %u)\n", mesh_file, res.x, res.y, res.z);
+		return 1;
+	}
+
+	if(load_mesh(mesh_file, &vert, &tri, &num_tri) == 0)
+	{
+		return 0;
+	}
+
+	voxelize(vert, tri, num_tri, voxel_size);
+	free(vert);
+	free(tri);
+
+	printf("SDF: %s voxelized (%u triangles, %u x %u x %u)\n", mesh_file, num_tri, res.x, res.y, res.z);
+
+	if(save(cache_file, mesh_time) == 0)
+	{
+		printf("SDF: cannot write %s\n", cache_file);
+	}
+
+	return 1;
+}
+
+uint SDFVolume::load_mesh(const char *file, float3 **vert, uint3 **tri, uint *num_tri)
+{
+	FILE *fp;
+	char line[512];
+	char *token;
+	uint num_vert=0;
+	uint cap_vert=1024;
+	uint cap_tri=1024;
+	int index[3];
+	uint count;
+	int id;
+
+	fp=fopen(file, "r");
+	if(fp == NULL)
+	{
+		printf("SDF: cannot open %s\n", file);
+		return 0;
+	}
+
+	*vert=(float3 *)malloc(sizeof(float3)*cap_vert);
+	*tri=(uint3 *)malloc(sizeof(uint3)*cap_tri);
+	*num_tri=0;
+
+	while(fgets(line, sizeof(line), fp) != NULL)
+	{
+		if(line[0] == 'v' && line[1] == ' ')
+		{
+			if(num_vert == cap_vert)
+			{
+				cap_vert*=2;
+				*vert=(float3 *)realloc(*vert, sizeof(float3)*cap_vert);
+			}
+
+			float3 *v=&((*vert)[num_vert]);
+			if(sscanf(line+2, "%f %f %f", &(v->x), &(v->y), &(v->z)) == 3)
+			{
+				num_vert++;
+			}
+		}
+		else if(line[0] == 'f' && line[1] == ' ')
+		{
+			count=0;
+			for(token=strtok(line+2, " \t\r\n"); token != NULL; token=strtok(NULL, " \t\r\n"))
+			{
+				id=atoi(token);
+				id=id < 0 ? (int)num_vert+id : id-1;
+
+				if(id < 0 || id >= (int)num_vert)
+				{
+					continue;
+				}
+
+				index[count < 2 ? count : 2]=id;
+				count++;
+
+				if(count < 3)
+				{
+					continue;
+				}
+
+				if(*num_tri == cap_tri)
+				{
+					cap_tri*=2;
+					*tri=(uint3 *)realloc(*tri, sizeof(uint3)*cap_tri);
+				}
+
+				(*tri)[*num_tri].x=index[0];
+				(*tri)[*num_tri].y=index[1];
+				(*tri)[*num_tri].z=index[2];
+				(*num_tri)++;
+
+				index[1]=index[2];
+			}
+		}
+	}
+
+	fclose(fp);
+
+	if(*num_tri == 0)
+	{
+		printf("SDF: no triangles in %s\n", file);
+		free(*vert);
+		free(*tri);
+		return 0;
+	}
+
+	return 1;
+}
+
+void SDFVolume::voxelize(float3 *vert, uint3 *tri, uint num_tri, float voxel_size)
+{
+	float3 min_pos;
+	float3 max_pos;
+	float3 p;
+	float3 a;
+	float3 b;
+	float3 c;
+	float pad=voxel_size*2.0f;
+	float d2;
+	float min_d2;
+	uint index;
+
+	min_pos=vert[tri[0].x];
+	max_pos=min_pos;
+	for(uint t=0; t<num_tri; t++)
+	{
+		uint id[3]={tri[t].x, tri[t].y, tri[t].z};
+		for(uint k=0; k<3; k++)
+		{
+			min_pos.x=fmin(min_pos.x, vert[id[k]].x);
+			min_pos.y=fmin(min_pos.y, vert[id[k]].y);
+			min_pos.z=fmin(min_pos.z, vert[id[k]].z);
+			max_pos.x=fmax(max_pos.x, vert[id[k]].x);
+			max_pos.y=fmax(max_pos.y, vert[id[k]].y);
+			max_pos.z=fmax(max_pos.z, vert[id[k]].z);
+		}
+	}
+
+	voxel=voxel_size;
+	origin.x=min_pos.x-pad;
+	origin.y=min_pos.y-pad;
+	origin.z=min_pos.z-pad;
+	res.x=(uint)ceil((max_pos.x-min_pos.x+2.0f*pad)/voxel)+1;
+	res.y=(uint)ceil((max_pos.y-min_pos.y+2.0f*pad)/voxel)+1;
+	res.z=(uint)ceil((max_pos.z-min_pos.z+2.0f*pad)/voxel)+1;
+
+	free(dist);
+	dist=(float *)malloc(sizeof(float)*res.x*res.y*res.z);
+
+	for(uint z=0; z<res.z; z++)
+	{
+		for(uint y=0; y<res.y; y++)
+		{
+			for(uint x=0; x<res.x; x++)
+			{
+				p.x=origin.x+x*voxel;
+				p.y=origin.y+y*voxel;
+				p.z=origin.z+z*voxel;
+
+				min_d2=1e30f;
+				for(uint t=0; t<num_tri; t++)
+				{
+					d2=tri_dist2(p, vert[tri[t].x], vert[tri[t].y], vert[tri[t].z]);
+					min_d2=d2 < min_d2 ? d2 : min_d2;
+				}
+
+				dist[(z*res.y+y)*res.x+x]=sqrt(min_d2);
+			}
+		}
+	}
+
+	float *cross=(float *)malloc(sizeof(float)*num_tri);
+	uint num_cross;
+	float py;
+	float pz;
+	float det;
+	float u;
+	float v;
+	float w;
+
+	for(uint z=0; z<res.z; z++)
+	{
+		for(uint y=0; y<res.y; y++)
+		{
+			py=origin.y+y*voxel+voxel*1e-4f;
+			pz=origin.z+z*voxel+voxel*1.7e-4f;
+
+			num_cross=0;
+			for(uint t=0; t<num_tri; t++)
+			{
+				a=vert[tri[t].x];
+				b=vert[tri[t].y];
+				c=vert[tri[t].z];
+
+				det=(b.y-a.y)*(c.z-a.z)-(c.y-a.y)*(b.z-a.z);
+				if(fabs(det) < INF)
+				{
+					continue;
+				}
+
+				u=((py-a.y)*(c.z-a.z)-(c.y-a.y)*(pz-a.z))/det;
+				v=((b.y-a.y)*(pz-a.z)-(py-a.y)*(b.z-a.z))/det;
+				w=1.0f-u-v;
+
+				if(u < 0.0f || v < 0.0f || w < 0.0f)
+				{
+					continue;
+				}
+
+				cross[num_cross]=a.x+u*(b.x-a.x)+v*(c.x-a.x);
+				num_cross++;
+			}
+
+			qsort(cross, num_cross, sizeof(float), cmp_float);
+
+			index=0;
+			for(uint x=0; x<res.x; x++)
+			{
+				p.x=origin.x+x*voxel;
+				while(index < num_cross && cross[index] < p.x)
+				{
+					index++;
+				}
+
+				if(index%2 == 1)
+				{
+					dist[(z*res.y+y)*res.x+x]=-dist[(z*res.y+y)*res.x+x];
+				}
+			}
+		}
+	}
+
+	free(cross);
+}
+
+uint SDFVolume::save(const char *file, long long mesh_time)
+{
+	FILE *fp=fopen(file, "wb");
+	uint num=res.x*res.y*res.z;
+	uint ok;
+
+	if(fp == NULL)
+	{
+		return 0;
+	}
+
+	ok=fwrite(sdf_magic, sizeof(sdf_magic), 1, fp) == 1
+		&& fwrite(&mesh_time, sizeof(mesh_time), 1, fp) == 1
+		&& fwrite(&voxel, sizeof(voxel), 1, fp) == 1
+		&& fwrite(&res, sizeof(res), 1, fp) == 1
+		&& fwrite(&origin, sizeof(origin), 1, fp) == 1
+		&& fwrite(dist, sizeof(float), num, fp) == num;
+
+	fclose(fp);
+	return ok;
+}
+
+/** The cache is only trusted as far as it agrees with itself: every axis
+ ** needs two samples for sample() to interpolate, and the grid has to fill
+ ** the rest of the file exactly. Anything else is rebuilt from the mesh. */
+uint SDFVolume::load(const char *file, long long mesh_time, float voxel_size)
+{
+	FILE *fp=fopen(file, "rb");
+	char magic[4];
+	long long cache_time;
+	float cache_voxel;
+	uint3 cache_res;
+	float3 cache_origin;
+	unsigned long long num;
+	long start;
+	long end;
+
+	if(fp == NULL)
+	{
+		return 0;
+	}
+
+	if(fread(magic, sizeof(magic), 1, fp) != 1 || memcmp(magic, sdf_magic, sizeof(magic)) != 0
+		|| fread(&cache_time, sizeof(cache_time), 1, fp) != 1 || cache_time != mesh_time
+		|| fread(&cache_voxel, sizeof(cache_voxel), 1, fp) != 1 || cache_voxel != voxel_size
+		|| fread(&cache_res, sizeof(cache_res), 1, fp) != 1 || fread(&cache_origin, sizeof(cache_origin), 1, fp) != 1)
+	{
+		fclose(fp);
+		return 0;
+	}
+
+	num=(unsigned long long)cache_res.x*cache_res.y*cache_res.z;
+	start=ftell(fp);
+	fseek(fp, 0, SEEK_END);
+	end=ftell(fp);
+	fseek(fp, start, SEEK_SET);
+
+	if(cache_res.x < 2 || cache_res.y < 2 || cache_res.z < 2 || start < 0 || end < start || num*sizeof(float) != (unsigned long long)(end-start))
+	{
+		printf("SDF: %s is corrupt, rebuilding\n", file);
+		fclose(fp);
+		return 0;
+	}
+
+	free(dist);
+	dist=(float *)malloc(sizeof(float)*num);
+
+	if(fread(dist, sizeof(float), num, fp) != num)
+	{
+		fclose(fp);
+		free(dist);
+		dist=NULL;
+		return 0;
+	}
+
+	fclose(fp);
+	res=cache_res;
+	origin=cache_origin;
+	voxel=cache_voxel;
+	return 1;
+}
+
+float SDFVolume::sample(float3 pos, float3 *grad)
+{
+	float3 u;
+	float3 out;
+	float out_len;
+	int x;
+	int y;
+	int z;
+	float fx;
+	float fy;
+	float fz;
+
+	out.x=(pos.x-origin.x)/voxel;
+	out.y=(pos.y-origin.y)/voxel;
+	out.z=(pos.z-origin.z)/voxel;
+
+	u.x=fmin(fmax(out.x, 0.0f), (float)(res.x-1));
+	u.y=fmin(fmax(out.y, 0.0f), (float)(res.y-1));
+	u.z=fmin(fmax(out.z, 0.0f), (float)(res.z-1));
+
+	x=(int)u.x < (int)res.x-2 ? (int)u.x : (int)res.x-2;
+	y=(int)u.y < (int)res.y-2 ? (int)u.y : (int)res.y-2;
+	z=(int)u.z < (int)res.z-2 ? (int)u.z : (int)res.z-2;
+	fx=u.x-x;
+	fy=u.y-y;
+	fz=u.z-z;
+
+	const float *d=&(dist[(z*res.y+y)*res.x+x]);
+	uint sy=res.x;
+	uint sz=res.x*res.y;
+
+	float d000=d[0];
+	float d100=d[1];
+	float d010=d[sy];
+	float d110=d[sy+1];
+	float d001=d[sz];
+	float d101=d[sz+1];
+	float d011=d[sz+sy];
+	float d111=d[sz+sy+1];
+
+	float d00=d000+(d100-d000)*fx;
+	float d10=d010+(d110-d010)*fx;
+	float d01=d001+(d101-d001)*fx;
+	float d11=d011+(d111-d011)*fx;
+	float d0=d00+(d10-d00)*fy;
+	float d1=d01+(d11-d01)*fy;
+	float value=d0+(d1-d0)*fz;
+
+	if(grad != NULL)
+	{
+		float gx0=(d100-d000)+((d110-d010)-(d100-d000))*fy;
+		float gx1=(d101-d001)+((d111-d011)-(d101-d001))*fy;
+		float gy0=(d10-d00);
+		float gy1=(d11-d01);
+
+		grad->x=(gx0+(gx1-gx0)*fz)/voxel;
+		grad->y=(gy0+(gy1-gy0)*fz)/voxel;
+		grad->z=(d1-d0)/voxel;
+	}
+
+	out.x=(out.x-u.x)*voxel;
+	out.y=(out.y-u.y)*voxel;
+	out.z=(out.z-u.z)*voxel;
+	out_len=sqrt(out.x*out.x+out.y*out.y+out.z*out.z);
+
+	if(out_len > 0.0f)
+	{
+		if(grad != NULL)
+		{
+			grad->x=out.x/out_len;
+			grad->y=out.y/out_len;
+			grad->z=out.z/out_len;
+		}
+		value+=out_len;
+	}
+
+	return value;
+}
@@ -0,0 +1,48 @@
+/** File:		sph_sdf.h
+ ** Author:		Dongli Zhang
+ ** Contact:	dongli.zhang0129@gmail.com
+ **
+ ** Copyright (C) Dongli Zhang 2013
+ **
+ ** This program is free software;  you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+ ** the GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program;  if not, write to the Free Software 
+ ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef __SPHSDF_H__
+#define __SPHSDF_H__
+
+#include "sph_type.h"
+
+class SDFVolume
+{
+public:
+	uint3 res;
+	float3 origin;
+	float voxel;
+	float *dist;
+
+public:
+	SDFVolume();
+	~SDFVolume();
+	uint build(const char *mesh_file, float voxel_size);
+	uint save(const char *file, long long mesh_time);
+	uint load(const char *file, long long mesh_time, float voxel_size);
+	float sample(float3 pos, float3 *grad);
+
+private:
+	uint load_mesh(const char *file, float3 **vert, uint3 **tri, uint *num_tri);
+	void voxelize(float3 *vert, uint3 *tri, uint num_tri, float voxel_size);
+};
+
+#endif
@@ -0,0 +1,151 @@
+/** File:		sph_sleep.cpp
+ ** Author:		Dongli Zhang
+ ** Contact:	dongli.zhang0129@gmail.com
+ **
+ ** Copyright (C) Dongli Zhang 2013
+ **
+ ** This program is free software;  you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+ ** the GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program;  if not, write to the Free Software
+ ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "sph_system.h"
+#include "sph_header.h"
+
+/** Sleeping cells for the WCSPH path.
+ **
+ ** A cell is quiet for a step when every particle in it moves slower than
+ ** sleep_vel and changed its density by less than sleep_dens relative to
+ ** the previous step; cell_quiet counts consecutive quiet steps. A cell
+ ** sleeps once it and all its 26 neighbors have been quiet for sleep_steps,
+ ** so a sleeping particle is never within a kernel of a moving one. Sleeping
+ ** particles keep their position, density and pressure, are skipped by
+ ** comp_dens_pres(), comp_force_adv() and advection(), and still act as
+ ** neighbors. Any change in a neighbor cell resets its counter and wakes
+ ** the cell on the next step.
+ */
+
+void SPHSystem::sleep_update()
+{
+	Particle *p;
+
+	int3 cell_pos;
+	int3 near_pos;
+	uint hash;
+	uint quiet;
+	uint sleep;
+	float v2;
+	float max_v2=sleep_vel*sleep_vel;
+
+	if(sleeping == 0 || solver_mode != SOLVER_WCSPH || block_step || adaptive_res)
+	{
+		wake_all();
+		return;
+	}
+
+	for(uint i=0; i<tot_cell; i++)
+	{
+		quiet=1;
+
+		for(p=cell[i]; p != NULL; p=p->next)
+		{
+			v2=p->vel.x*p->vel.x+p->vel.y*p->vel.y+p->vel.z*p->vel.z;
+
+			if(v2 > max_v2 || fabs(p->dens-p->last_dens) > sleep_dens*p->last_dens)
+			{
+				quiet=0;
+			}
+
+			p->last_dens=p->dens;
+		}
+
+		if(quiet == 0)
+		{
+			cell_quiet[i]=0;
+		}
+		else if(cell_quiet[i] < sleep_steps)
+		{
+			cell_quiet[i]++;
+		}
+	}
+
+	num_sleep=0;
+	for(uint i=0; i<tot_cell; i++)
+	{
+		if(cell[i] == NULL)
+		{
+			continue;
+		}
+
+		sleep=1;
+		cell_pos=calc_cell_pos(cell[i]->pos);
+
+		for(int x=-1; x<=1 && sleep; x++)
+		{
+			for(int y=-1; y<=1 && sleep; y++)
+			{
+				for(int z=-1; z<=1 && sleep; z++)
+				{
+					near_pos.x=cell_pos.x+x;
+					near_pos.y=cell_pos.y+y;
+					near_pos.z=cell_pos.z+z;
+					hash=calc_cell_hash(near_pos);
+
+					if(hash == 0xffffffff)
+					{
+						continue;
+					}
+
+					if(cell_quiet[hash] < sleep_steps)
+					{
+						sleep=0;
+					}
+				}
+			}
+		}
+
+		for(p=cell[i]; p != NULL; p=p->next)
+		{
+			if(sleep && p->sleep == 0)
+			{
+				p->vel.x=0.0f;
+				p->vel.y=0.0f;
+				p->vel.z=0.0f;
+				p->ev=p->vel;
+			}
+
+			p->sleep=sleep;
+			num_sleep+=sleep;
+		}
+	}
+}
+
+void SPHSystem::wake_all()
+{
+	if(num_sleep == 0)
+	{
+		return;
+	}
+
+	for(uint i=0; i<num_particle; i++)
+	{
+		mem[i].sleep=0;
+	}
+
+	for(uint i=0; i<tot_cell; i++)
+	{
+		cell_quiet[i]=0;
+	}
+
+	num_sleep=0;
+}
@@ -1,429 +1,1090 @@
-/** File:		sph_system.cpp
- ** Author:		Dongli Zhang
- ** Contact:	dongli.zhang0129@gmail.com
- **
- ** Copyright (C) Dongli Zhang 2013
- **
- ** This program is free software;  you can redistribute it and/or modify
- ** it under the terms of the GNU General Public License as published by
- ** the Free Software Foundation; either version 2 of the License, or
- ** (at your option) any later version.
- **
- ** This program is distributed in the hope that it will be useful,
- ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
- ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
- ** the GNU General Public License for more details.
- **
- ** You should have received a copy of the GNU General Public License
- ** along with this program;  if not, write to the Free Software 
- ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
- */
-
-#include "sph_system.h"
-#include "sph_header.h"
-
-SPHSystem::SPHSystem()
-{
-	max_particle=30000;
-	num_particle=0;
-
-	kernel=0.04f;
-	mass=0.02f;
-
-	world_size.x=0.64f;
-	world_size.y=0.64f;
-	world_size.z=0.64f;
-	cell_size=kernel;
-	grid_size.x=(uint)ceil(world_size.x/cell_size);
-	grid_size.y=(uint)ceil(world_size.y/cell_size);
-	grid_size.z=(uint)ceil(world_size.z/cell_size);
-	tot_cell=grid_size.x*grid_size.y*grid_size.z;
-
-	gravity.x=0.0f; 
-	gravity.y=-6.8f;
-	gravity.z=0.0f;
-	wall_damping=-0.5f;
-	rest_density=1000.0f;
-	gas_constant=1.0f;
-	viscosity=6.5f;
-	time_step=0.003f;
-	surf_norm=6.0f;
-	surf_coe=0.1f;
-
-	poly6_value=315.0f/(64.0f * PI * pow(kernel, 9));;
-	spiky_value=-45.0f/(PI * pow(kernel, 6));
-	visco_value=45.0f/(PI * pow(kernel, 6));
-
-	grad_poly6=-945/(32 * PI * pow(kernel, 9));
-	lplc_poly6=-945/(8 * PI * pow(kernel, 9));
-
-	kernel_2=kernel*kernel;
-	self_dens=mass*poly6_value*pow(kernel, 6);
-	self_lplc_color=lplc_poly6*mass*kernel_2*(0-3/4*kernel_2);
-
-	mem=(Particle *)malloc(sizeof(Particle)*max_particle);
-	cell=(Particle **)malloc(sizeof(Particle *)*tot_cell);
-
-	sys_running=0;
-
-	printf("Initialize SPH:\n");
-	printf("World Width : %f\n", world_size.x);
-	printf("World Height: %f\n", world_size.y);
-	printf("World Length: %f\n", world_size.z);
-	printf("Cell Size  : %f\n", cell_size);
-	printf("Grid Width : %u\n", grid_size.x);
-	printf("Grid Height: %u\n", grid_size.y);
-	printf("Grid Length: %u\n", grid_size.z);
-	printf("Total Cell : %u\n", tot_cell);
-	printf("Poly6 Kernel: %f\n", poly6_value);
-	printf("Spiky Kernel: %f\n", spiky_value);
-	printf("Visco Kernel: %f\n", visco_value);
-	printf("Self Density: %f\n", self_dens);
-}
-
-SPHSystem::~SPHSystem()
-{
-	free(mem);
-	free(cell);
-}
-
-void SPHSystem::animation()
-{
-	if(sys_running == 0)
-	{
-		return;
-	}
-
-	build_table();
-	comp_dens_pres();
-	comp_force_adv();
-	advection();
-}
-
-void SPHSystem::init_system()
-{
-	float3 pos;
-	float3 vel;
-
-	vel.x=0.0f;
-	vel.y=0.0f;
-	vel.z=0.0f;
-
-	for(pos.x=world_size.x*0.0f; pos.x<world_size.x*0.6f; pos.x+=(kernel*0.5f))
-	{
-		for(pos.y=world_size.y*0.0f; pos.y<world_size.y*0.9f; pos.y+=(kernel*0.5f))
-		{
-			for(pos.z=world_size.z*0.0f; pos.z<world_size.z*0.6f; pos.z+=(kernel*0.5f))
-			{
-				add_particle(pos, vel);
-			}
-		}
-	}
-
-	printf("Init Particle: %u\n", num_particle);
-}
-
-void SPHSystem::add_particle(float3 pos, float3 vel)
-{
-	Particle *p=&(mem[num_particle]);
-
-	p->id=num_particle;
-
-	p->pos=pos;
-	p->vel=vel;
-
-	p->acc.x=0.0f;
-	p->acc.y=0.0f;
-	p->acc.z=0.0f;
-	p->ev.x=0.0f;
-	p->ev.y=0.0f;
-	p->ev.z=0.0f;
-
-	p->dens=rest_density;
-	p->pres=0.0f;
-
-	p->next=NULL;
-
-	num_particle++;
-}
-
-void SPHSystem::build_table()
-{
-	Particle *p;
-	uint hash;
-
-	for(uint i=0; i<tot_cell; i++)
-	{
-		cell[i]=NULL;
-	}
-
-	for(uint i=0; i<num_particle; i++)
-	{
-		p=&(mem[i]);
-		hash=calc_cell_hash(calc_cell_pos(p->pos));
-
-		if(cell[hash] == NULL)
-		{
-			p->next=NULL;
-			cell[hash]=p;
-		}
-		else
-		{
-			p->next=cell[hash];
-			cell[hash]=p;
-		}
-	}
-}
-
-void SPHSystem::comp_dens_pres()
-{
-	Particle *p;
-	Particle *np;
-
-	int3 cell_pos;
-	int3 near_pos;
-	uint hash;
-
-	float3 rel_pos;
-	float r2;
-
-	for(uint i=0; i<num_particle; i++)
-	{
-		p=&(mem[i]); 
-		cell_pos=calc_cell_pos(p->pos);
-
-		p->dens=0.0f;
-		p->pres=0.0f;
-
-		for(int x=-1; x<=1; x++)
-		{
-			for(int y=-1; y<=1; y++)
-			{
-				for(int z=-1; z<=1; z++)
-				{
-					near_pos.x=cell_pos.x+x;
-					near_pos.y=cell_pos.y+y;
-					near_pos.z=cell_pos.z+z;
-					hash=calc_cell_hash(near_pos);
-
-					if(hash == 0xffffffff)
-					{
-						continue;
-					}
-
-					np=cell[hash];
-					while(np != NULL)
-					{
-						rel_pos.x=np->pos.x-p->pos.x;
-						rel_pos.y=np->pos.y-p->pos.y;
-						rel_pos.z=np->pos.z-p->pos.z;
-						r2=rel_pos.x*rel_pos.x+rel_pos.y*rel_pos.y+rel_pos.z*rel_pos.z;
-
-						if(r2<INF || r2>=kernel_2)
-						{
-							np=np->next;
-							continue;
-						}
-
-						p->dens=p->dens + mass * poly6_value * pow(kernel_2-r2, 3);
-
-						np=np->next;
-					}
-				}
-			}
-		}
-
-		p->dens=p->dens+self_dens;
-		p->pres=(pow(p->dens / rest_density, 7) - 1) *gas_constant;
-	}
-}
-
-void SPHSystem::comp_force_adv()
-{
-	Particle *p;
-	Particle *np;
-
-	int3 cell_pos;
-	int3 near_pos;
-	uint hash;
-
-	float3 rel_pos;
-	float3 rel_vel;
-
-	float r2;
-	float r;
-	float kernel_r;
-	float V;
-
-	float pres_kernel;
-	float visc_kernel;
-	float temp_force;
-
-	float3 grad_color;
-	float lplc_color;
-
-	for(uint i=0; i<num_particle; i++)
-	{
-		p=&(mem[i]); 
-		cell_pos=calc_cell_pos(p->pos);
-
-		p->acc.x=0.0f;
-		p->acc.y=0.0f;
-		p->acc.z=0.0f;
-
-		grad_color.x=0.0f;
-		grad_color.y=0.0f;
-		grad_color.z=0.0f;
-		lplc_color=0.0f;
-		
-		for(int x=-1; x<=1; x++)
-		{
-			for(int y=-1; y<=1; y++)
-			{
-				for(int z=-1; z<=1; z++)
-				{
-					near_pos.x=cell_pos.x+x;
-					near_pos.y=cell_pos.y+y;
-					near_pos.z=cell_pos.z+z;
-					hash=calc_cell_hash(near_pos);
-
-					if(hash == 0xffffffff)
-					{
-						continue;
-					}
-
-					np=cell[hash];
-					while(np != NULL)
-					{
-						rel_pos.x=p->pos.x-np->pos.x;
-						rel_pos.y=p->pos.y-np->pos.y;
-						rel_pos.z=p->pos.z-np->pos.z;
-						r2=rel_pos.x*rel_pos.x+rel_pos.y*rel_pos.y+rel_pos.z*rel_pos.z;
-
-						if(r2 < kernel_2 && r2 > INF)
-						{
-							r=sqrt(r2);
-							V=mass/np->dens/2;
-							kernel_r=kernel-r;
-
-							pres_kernel=spiky_value * kernel_r * kernel_r;
-							temp_force=V * (p->pres+np->pres) * pres_kernel;
-							p->acc.x=p->acc.x-rel_pos.x*temp_force/r;
-							p->acc.y=p->acc.y-rel_pos.y*temp_force/r;
-							p->acc.z=p->acc.z-rel_pos.z*temp_force/r;
-
-							rel_vel.x=np->ev.x-p->ev.x;
-							rel_vel.y=np->ev.y-p->ev.y;
-							rel_vel.z=np->ev.z-p->ev.z;
-
-							visc_kernel=visco_value*(kernel-r);
-							temp_force=V * viscosity * visc_kernel;
-							p->acc.x=p->acc.x + rel_vel.x*temp_force; 
-							p->acc.y=p->acc.y + rel_vel.y*temp_force; 
-							p->acc.z=p->acc.z + rel_vel.z*temp_force; 
-
-							float temp=(-1) * grad_poly6 * V * pow(kernel_2-r2, 2);
-							grad_color.x += temp * rel_pos.x;
-							grad_color.y += temp * rel_pos.y;
-							grad_color.z += temp * rel_pos.z;
-							lplc_color += lplc_poly6 * V * (kernel_2-r2) * (r2-3/4*(kernel_2-r2));
-						}
-
-						np=np->next;
-					}
-				}
-			}
-		}
-
-		lplc_color+=self_lplc_color/p->dens;
-		p->surf_norm=sqrt(grad_color.x*grad_color.x+grad_color.y*grad_color.y+grad_color.z*grad_color.z);
-
-		if(p->surf_norm > surf_norm)
-		{
-			p->acc.x+=surf_coe * lplc_color * grad_color.x / p->surf_norm;
-			p->acc.y+=surf_coe * lplc_color * grad_color.y / p->surf_norm;
-			p->acc.z+=surf_coe * lplc_color * grad_color.z / p->surf_norm;
-		}
-	}
-}
-
-void SPHSystem::advection()
-{
-	Particle *p;
-	for(uint i=0; i<num_particle; i++)
-	{
-		p=&(mem[i]);
-
-		p->vel.x=p->vel.x+p->acc.x*time_step/p->dens+gravity.x*time_step;
-		p->vel.y=p->vel.y+p->acc.y*time_step/p->dens+gravity.y*time_step;
-		p->vel.z=p->vel.z+p->acc.z*time_step/p->dens+gravity.z*time_step;
-
-		p->pos.x=p->pos.x+p->vel.x*time_step;
-		p->pos.y=p->pos.y+p->vel.y*time_step;
-		p->pos.z=p->pos.z+p->vel.z*time_step;
-
-		if(p->pos.x >= world_size.x-BOUNDARY)
-		{
-			p->vel.x=p->vel.x*wall_damping;
-			p->pos.x=world_size.x-BOUNDARY;
-		}
-
-		if(p->pos.x < 0.0f)
-		{
-			p->vel.x=p->vel.x*wall_damping;
-			p->pos.x=0.0f;
-		}
-
-		if(p->pos.y >= world_size.y-BOUNDARY)
-		{
-			p->vel.y=p->vel.y*wall_damping;
-			p->pos.y=world_size.y-BOUNDARY;
-		}
-
-		if(p->pos.y < 0.0f)
-		{
-			p->vel.y=p->vel.y*wall_damping;
-			p->pos.y=0.0f;
-		}
-
-		if(p->pos.z >= world_size.z-BOUNDARY)
-		{
-			p->vel.z=p->vel.z*wall_damping;
-			p->pos.z=world_size.z-BOUNDARY;
-		}
-
-		if(p->pos.z < 0.0f)
-		{
-			p->vel.z=p->vel.z*wall_damping;
-			p->pos.z=0.0f;
-		}
-
-		p->ev.x=(p->ev.x+p->vel.x)/2;
-		p->ev.y=(p->ev.y+p->vel.y)/2;
-		p->ev.z=(p->ev.z+p->vel.z)/2;
-	}
-}
-
-int3 SPHSystem::calc_cell_pos(float3 p)
-{
-	int3 cell_pos;
-	cell_pos.x = int(floor((p.x) / cell_size));
-	cell_pos.y = int(floor((p.y) / cell_size));
-	cell_pos.z = int(floor((p.z) / cell_size));
-
-    return cell_pos;
-}
-
-uint SPHSystem::calc_cell_hash(int3 cell_pos)
-{
-	if(cell_pos.x<0 || cell_pos.x>=(int)grid_size.x || cell_pos.y<0 || cell_pos.y>=(int)grid_size.y || cell_pos.z<0 || cell_pos.z>=(int)grid_size.z)
-	{
-		return (uint)0xffffffff;
-	}
-
-	cell_pos.x = cell_pos.x & (grid_size.x-1);  
-    cell_pos.y = cell_pos.y & (grid_size.y-1);  
-	cell_pos.z = cell_pos.z & (grid_size.z-1);  
-
-	return ((uint)(cell_pos.z))*grid_size.y*grid_size.x + ((uint)(cell_pos.y))*grid_size.x + (uint)(cell_pos.x);
-}
+/** File:		sph_system.cpp
+ ** Author:		Dongli Zhang
+ ** Contact:	dongli.zhang0129@gmail.com
+ **
+ ** Copyright (C) Dongli Zhang 2013
+ **
+ ** This program is free software;  you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+ ** the GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program;  if not, write to the Free Software 
+ ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "sph_system.h"
+#include "sph_header.h"
+#include <string.h>
+
+SPHSystem::SPHSystem()
+{
+	max_particle=30000;
+	num_particle=0;
+	next_id=0;
+
+	kernel=0.04f;
+	mass=0.02f;
+
+	world_size.x=0.64f;
+	world_size.y=0.64f;
+	world_size.z=0.64f;
+
+	gravity.x=0.0f; 
+	gravity.y=-6.8f;
+	gravity.z=0.0f;
+	wall_damping=-0.5f;
+	rest_density=1000.0f;
+	gas_constant=1.0f;
+	viscosity=6.5f;
+	time_step=0.003f;
+	surf_norm=6.0f;
+	surf_coe=0.1f;
+
+	integrator=INTEGRATOR_EULER;
+	last_time_step=0.0f;
+
+	adaptive_step=1;
+	frame_time=0.012f;
+	min_time_step=0.0001f;
+	max_time_step=0.006f;
+	max_implicit_step=0.012f;
+	cfl_factor=0.4f;
+	force_factor=0.25f;
+	visc_factor=0.125f;
+
+	max_vel=0.0f;
+	max_acc=0.0f;
+	frame_step=0;
+	tot_step=0;
+
+	solver_mode=SOLVER_WCSPH;
+	max_dens_err=0.01f;
+	min_iter=3;
+	max_iter=50;
+	solver_iter=0;
+	tot_iter=0;
+	solver_err=0.0f;
+
+	jacobi_omega=0.5f;
+
+	pbf_iter=4;
+	pbf_relax=0.01f;
+	pbf_scorr=0.1f;
+	pbf_scorr_dq=0.2f;
+	pbf_xsph_coe=0.01f;
+
+	max_div_err=0.001f;
+	max_div_iter=20;
+	div_iter=0;
+	div_err=0.0f;
+
+	block_step=0;
+	max_level=3;
+	block_count=0;
+	block_active=0;
+	block_carry=0.0f;
+	num_active=0;
+	tot_force_eval=0;
+
+	sleeping=0;
+	sleep_vel=0.05f;
+	sleep_dens=0.001f;
+	sleep_steps=30;
+	num_sleep=0;
+
+	adaptive_res=0;
+	adapt_max_level=2;
+	adapt_depth=2;
+	adapt_interval=10;
+	adapt_h_ratio=pow(2.0f, 1.0f/3.0f);
+	num_coarse=0;
+
+	num_obstacle=0;
+	obstacle_margin=kernel*0.25f;
+
+	bound_part=0;
+	bound_pos=NULL;
+	bound_psi=NULL;
+	bound_start=NULL;
+
+	periodic.x=0;
+	periodic.y=0;
+	periodic.z=0;
+	any_periodic=0;
+
+	relax_tau=0.1f;
+	relax_vel=0.005f;
+	relax_window=0.5f;
+	relax_time=10.0f;
+
+	sim_time=0.0f;
+	count_every=1;
+	num_emitter=0;
+	memset(&output, 0, sizeof(output));
+
+	export_index=NULL;
+	max_export=0;
+	sample_index=NULL;
+	sample_id=NULL;
+	num_sample=0;
+	max_sample=0;
+	sample_scan=0;
+	sample_rate=0;
+
+	mem=(Particle *)malloc(sizeof(Particle)*max_particle);
+	cell=NULL;
+	cell_quiet=NULL;
+	cell_depth=NULL;
+
+	nb_cap=max_particle*64;
+	nb_start=(uint *)malloc(sizeof(uint)*(max_particle+1));
+	nb_list=(uint *)malloc(sizeof(uint)*nb_cap);
+
+	sys_running=0;
+
+	init_params();
+}
+
+/** Everything derived from the parameters above: the grid, the kernel
+ ** constants, the PBF prototype gradient and the boundary layer. The constructor
+ ** calls it with the built in defaults and load_scene() again once a scene
+ ** file has set its own.
+ */
+
+void SPHSystem::init_params()
+{
+	cell_size=kernel;
+	grid_size.x=(uint)ceil(world_size.x/cell_size);
+	grid_size.y=(uint)ceil(world_size.y/cell_size);
+	grid_size.z=(uint)ceil(world_size.z/cell_size);
+	tot_cell=grid_size.x*grid_size.y*grid_size.z;
+
+	for(uint i=0; i<=MAX_RES_LEVEL; i++)
+	{
+		for(uint j=0; j<=MAX_RES_LEVEL; j++)
+		{
+			float h=kernel*(pow(adapt_h_ratio, (float)i)+pow(adapt_h_ratio, (float)j))*0.5f;
+			adapt_scale[i][j]=kernel/h;
+			adapt_range[i][j]=h*h;
+		}
+	}
+
+	w_dens=DensKernel(kernel);
+	w_pres=PresKernel(kernel);
+	w_visc=ViscKernel(kernel);
+
+	grad_poly6=-945.0f/(32.0f * PI * ipow<9>(kernel));
+	lplc_poly6=-945.0f/(8.0f * PI * ipow<9>(kernel));
+
+	kernel_2=kernel*kernel;
+	self_dens=mass*w_dens.value(0.0f);
+	self_lplc_color=lplc_poly6*mass*kernel_2*(0-3/4*kernel_2);
+
+	lattice_density=self_dens;
+	float spacing=kernel*0.5f;
+	int range=(int)ceil(kernel/spacing);
+	for(int x=-range; x<=range; x++)
+	{
+		for(int y=-range; y<=range; y++)
+		{
+			for(int z=-range; z<=range; z++)
+			{
+				float r2=(x*x+y*y+z*z)*spacing*spacing;
+				if(r2 > INF && r2 < kernel_2)
+				{
+					lattice_density+=mass*w_dens.value(r2);
+				}
+			}
+		}
+	}
+
+	init_pbf();
+	init_boundary();
+
+	cell=(Particle **)realloc(cell, sizeof(Particle *)*tot_cell);
+	cell_quiet=(uint *)realloc(cell_quiet, sizeof(uint)*tot_cell);
+	cell_depth=(uint *)realloc(cell_depth, sizeof(uint)*tot_cell);
+	table_mem=NULL;
+	table_num=0;
+
+	for(uint i=0; i<tot_cell; i++)
+	{
+		cell_quiet[i]=0;
+	}
+
+	printf("Initialize SPH:\n");
+	printf("World Width : %f\n", world_size.x);
+	printf("World Height: %f\n", world_size.y);
+	printf("World Length: %f\n", world_size.z);
+	printf("Cell Size  : %f\n", cell_size);
+	printf("Grid Width : %u\n", grid_size.x);
+	printf("Grid Height: %u\n", grid_size.y);
+	printf("Grid Length: %u\n", grid_size.z);
+	printf("Total Cell : %u\n", tot_cell);
+	printf("Dens Kernel: %f\n", w_dens.coef);
+	printf("Pres Kernel: %f\n", w_pres.coef);
+	printf("Visc Kernel: %f\n", w_visc.coef);
+	printf("Self Density: %f\n", self_dens);
+	printf("Lattice Density: %f\n", lattice_density);
+}
+
+SPHSystem::~SPHSystem()
+{
+	free(mem);
+	free(cell);
+	free(cell_quiet);
+	free(cell_depth);
+	free(bound_pos);
+	free(bound_psi);
+	free(bound_start);
+	free(export_index);
+	free(sample_index);
+	free(sample_id);
+
+	for(uint i=0; i<num_obstacle; i++)
+	{
+		delete obstacle[i];
+	}
+	free(nb_start);
+	free(nb_list);
+}
+
+void SPHSystem::animation()
+{
+	if(sys_running == 0)
+	{
+		return;
+	}
+
+	TraceScope trace("animation");
+
+	if(adaptive_step == 0)
+	{
+		step();
+		frame_step=1;
+		sim_time+=time_step;
+		emit(time_step);
+		return;
+	}
+
+	if(block_step && solver_mode == SOLVER_WCSPH)
+	{
+		block_animation();
+		sim_time+=frame_time;
+		emit(frame_time);
+		return;
+	}
+
+	float elapsed=0.0f;
+	float remain;
+
+	frame_step=0;
+	while(elapsed < frame_time)
+	{
+		remain=frame_time-elapsed;
+		time_step=comp_time_step();
+
+		if(time_step >= remain)
+		{
+			time_step=remain;
+		}
+		else if(time_step*2.0f > remain)
+		{
+			time_step=remain*0.5f;
+		}
+
+		step();
+		elapsed+=time_step;
+		frame_step++;
+	}
+
+	sim_time+=elapsed;
+	emit(elapsed);
+}
+
+void SPHSystem::step()
+{
+	TraceScope trace("step");
+
+	if(num_coarse > 0 && (adaptive_res == 0 || solver_mode != SOLVER_WCSPH))
+	{
+		adapt_refine();
+	}
+
+#ifdef SPH_COUNTERS
+	for(uint i=0; i<NUM_COUNT_LOOP; i++)
+	{
+		counter[i].reset();
+	}
+#endif
+
+	if(solver_mode != SOLVER_PBF)
+	{
+		build_table();
+	}
+
+	sleep_update();
+
+	switch(solver_mode)
+	{
+	case SOLVER_DFSPH:
+		dfsph_step();
+		break;
+	case SOLVER_IISPH:
+		iisph_step();
+		break;
+	case SOLVER_PBF:
+		pbf_step();
+		break;
+	default:
+		if(adaptive_res)
+		{
+			adapt_step();
+			break;
+		}
+		comp_dens_pres();
+		comp_force_adv(1);
+		advection();
+		tot_force_eval+=num_particle-num_sleep;
+		break;
+	}
+
+	tot_step++;
+	tot_iter+=solver_iter;
+
+#ifdef SPH_COUNTERS
+	if(count_every > 0 && tot_step%count_every == 0)
+	{
+		printf("Step %u counters:\n", tot_step);
+		for(uint i=0; i<NUM_COUNT_LOOP; i++)
+		{
+			counter[i].print(count_name[i]);
+		}
+	}
+#endif
+}
+
+/** max_time_step caps WCSPH, whose stiff equation of state needs it.
+ ** DFSPH and IISPH solve the pressure for the step they are given and go
+ ** up to max_implicit_step, by default a whole frame, where CFL and
+ ** viscosity take over. PBF always takes the whole frame.
+ */
+
+float SPHSystem::comp_time_step()
+{
+	if(solver_mode == SOLVER_PBF)
+	{
+		return frame_time;
+	}
+
+	float dt=(solver_mode == SOLVER_DFSPH || solver_mode == SOLVER_IISPH) ? max_implicit_step : max_time_step;
+	float dt_visc=visc_factor*kernel_2*rest_density/viscosity;
+
+	if(max_vel > INF)
+	{
+		dt=fmin(dt, cfl_factor*kernel/max_vel);
+	}
+
+	if(solver_mode == SOLVER_WCSPH && max_acc > INF)
+	{
+		dt=fmin(dt, force_factor*sqrt(kernel/max_acc));
+	}
+
+	dt=fmin(dt, dt_visc);
+
+	return fmax(dt, min_time_step);
+}
+
+void SPHSystem::init_system()
+{
+	float3 pos;
+	float3 vel;
+
+	vel.x=0.0f;
+	vel.y=0.0f;
+	vel.z=0.0f;
+
+	for(pos.x=world_size.x*0.0f; pos.x<world_size.x*0.6f; pos.x+=(kernel*0.5f))
+	{
+		for(pos.y=world_size.y*0.0f; pos.y<world_size.y*0.9f; pos.y+=(kernel*0.5f))
+		{
+			for(pos.z=world_size.z*0.0f; pos.z<world_size.z*0.6f; pos.z+=(kernel*0.5f))
+			{
+				if(obstacle_dist(pos) >= obstacle_margin)
+				{
+					add_particle(pos, vel);
+				}
+			}
+		}
+	}
+
+	printf("Init Particle: %u\n", num_particle);
+}
+
+void SPHSystem::add_particle(float3 pos, float3 vel)
+{
+	init_particle(&(mem[num_particle]), next_id, pos, vel);
+	num_particle++;
+	next_id++;
+}
+
+void SPHSystem::init_particle(Particle *p, uint id, float3 pos, float3 vel)
+{
+	p->id=id;
+
+	p->pos=pos;
+	p->vel=vel;
+
+	p->acc.x=0.0f;
+	p->acc.y=0.0f;
+	p->acc.z=0.0f;
+	p->ev=vel;
+
+	p->dens=rest_density;
+	p->pres=0.0f;
+
+	p->level=0;
+	p->active=1;
+	p->last_step=0.0f;
+
+	p->sleep=0;
+	p->last_dens=rest_density;
+
+	p->mass=mass;
+	p->kernel=kernel;
+	p->res_level=0;
+	p->res_step=0;
+	p->surf_norm=0.0f;
+
+	p->next=NULL;
+}
+
+void SPHSystem::build_table()
+{
+	Particle *p;
+	uint hash;
+
+	prof.begin(PHASE_TABLE);
+
+	for(uint i=0; i<tot_cell; i++)
+	{
+		cell[i]=NULL;
+	}
+
+	for(uint i=0; i<num_particle; i++)
+	{
+		p=&(mem[i]);
+		hash=calc_cell_hash(calc_cell_pos(p->pos));
+
+		if(hash == 0xffffffff)
+		{
+			p->next=NULL;
+			continue;
+		}
+
+		if(cell[hash] == NULL)
+		{
+			p->next=NULL;
+			cell[hash]=p;
+		}
+		else
+		{
+			p->next=cell[hash];
+			cell[hash]=p;
+		}
+	}
+
+	table_mem=mem;
+	table_num=num_particle;
+
+	prof.end(PHASE_TABLE);
+}
+
+void SPHSystem::comp_dens_pres()
+{
+	Particle *p;
+	Particle *np;
+
+	int3 cell_pos;
+	int3 near_pos;
+	uint hash;
+
+	float3 rel_pos;
+	float r2;
+
+	prof.begin(PHASE_DENS);
+
+	for(uint i=0; i<num_particle; i++)
+	{
+		p=&(mem[i]); 
+
+		if(p->sleep)
+		{
+			continue;
+		}
+
+		cell_pos=calc_cell_pos(p->pos);
+
+		p->dens=0.0f;
+		p->pres=0.0f;
+
+		for(int x=-1; x<=1; x++)
+		{
+			for(int y=-1; y<=1; y++)
+			{
+				for(int z=-1; z<=1; z++)
+				{
+					near_pos.x=cell_pos.x+x;
+					near_pos.y=cell_pos.y+y;
+					near_pos.z=cell_pos.z+z;
+					hash=calc_cell_hash(near_pos);
+
+					if(hash == 0xffffffff)
+					{
+						continue;
+					}
+					COUNT_CELL(counter[COUNT_DENS]);
+
+					np=cell[hash];
+					while(np != NULL)
+					{
+						COUNT_CANDIDATE(counter[COUNT_DENS]);
+						rel_pos.x=np->pos.x-p->pos.x;
+						rel_pos.y=np->pos.y-p->pos.y;
+						rel_pos.z=np->pos.z-p->pos.z;
+						wrap_rel(rel_pos);
+						r2=rel_pos.x*rel_pos.x+rel_pos.y*rel_pos.y+rel_pos.z*rel_pos.z;
+
+						if(r2<INF || r2>=kernel_2)
+						{
+							np=np->next;
+							continue;
+						}
+
+						p->dens=p->dens + mass * w_dens.value(r2);
+						COUNT_PAIR(counter[COUNT_DENS]);
+
+						np=np->next;
+					}
+				}
+			}
+		}
+
+		p->dens=p->dens+self_dens;
+		if(bound_part)
+		{
+			p->dens+=bound_dens(p);
+		}
+		p->pres=(ipow<7>(p->dens / rest_density) - 1) *gas_constant;
+		COUNT_PARTICLE(counter[COUNT_DENS]);
+	}
+
+	prof.end(PHASE_DENS);
+}
+
+void SPHSystem::comp_force_adv(uint pres_force)
+{
+	Particle *p;
+	Particle *np;
+
+	int3 cell_pos;
+	int3 near_pos;
+	uint hash;
+
+	float3 rel_pos;
+	float3 rel_vel;
+
+	float r2;
+	float r;
+	float V;
+
+	float pres_kernel;
+	float visc_kernel;
+	float temp_force;
+
+	float3 grad_color;
+	float lplc_color;
+
+	prof.begin(PHASE_FORCE);
+
+	for(uint i=0; i<num_particle; i++)
+	{
+		p=&(mem[i]); 
+
+		if(p->sleep || (block_active && p->active == 0))
+		{
+			continue;
+		}
+
+		cell_pos=calc_cell_pos(p->pos);
+
+		p->acc.x=0.0f;
+		p->acc.y=0.0f;
+		p->acc.z=0.0f;
+
+		grad_color.x=0.0f;
+		grad_color.y=0.0f;
+		grad_color.z=0.0f;
+		lplc_color=0.0f;
+		
+		for(int x=-1; x<=1; x++)
+		{
+			for(int y=-1; y<=1; y++)
+			{
+				for(int z=-1; z<=1; z++)
+				{
+					near_pos.x=cell_pos.x+x;
+					near_pos.y=cell_pos.y+y;
+					near_pos.z=cell_pos.z+z;
+					hash=calc_cell_hash(near_pos);
+
+					if(hash == 0xffffffff)
+					{
+						continue;
+					}
+					COUNT_CELL(counter[COUNT_FORCE]);
+
+					np=cell[hash];
+					while(np != NULL)
+					{
+						COUNT_CANDIDATE(counter[COUNT_FORCE]);
+						rel_pos.x=p->pos.x-np->pos.x;
+						rel_pos.y=p->pos.y-np->pos.y;
+						rel_pos.z=p->pos.z-np->pos.z;
+						wrap_rel(rel_pos);
+						r2=rel_pos.x*rel_pos.x+rel_pos.y*rel_pos.y+rel_pos.z*rel_pos.z;
+
+						if(r2 < kernel_2 && r2 > INF)
+						{
+							COUNT_PAIR(counter[COUNT_FORCE]);
+							r=sqrt(r2);
+							V=mass/np->dens/2;
+
+							if(pres_force)
+							{
+								pres_kernel=w_pres.grad(r);
+								temp_force=V * (p->pres+np->pres) * pres_kernel;
+								p->acc.x=p->acc.x-rel_pos.x*temp_force/r;
+								p->acc.y=p->acc.y-rel_pos.y*temp_force/r;
+								p->acc.z=p->acc.z-rel_pos.z*temp_force/r;
+							}
+
+							rel_vel.x=np->ev.x-p->ev.x;
+							rel_vel.y=np->ev.y-p->ev.y;
+							rel_vel.z=np->ev.z-p->ev.z;
+
+							visc_kernel=w_visc.lplc(r);
+							temp_force=V * viscosity * visc_kernel;
+							p->acc.x=p->acc.x + rel_vel.x*temp_force; 
+							p->acc.y=p->acc.y + rel_vel.y*temp_force; 
+							p->acc.z=p->acc.z + rel_vel.z*temp_force; 
+
+							float temp=(-1) * grad_poly6 * V * (kernel_2-r2) * (kernel_2-r2);
+							grad_color.x += temp * rel_pos.x;
+							grad_color.y += temp * rel_pos.y;
+							grad_color.z += temp * rel_pos.z;
+							lplc_color += lplc_poly6 * V * (kernel_2-r2) * (r2-3/4*(kernel_2-r2));
+						}
+
+						np=np->next;
+					}
+				}
+			}
+		}
+
+		if(bound_part && pres_force)
+		{
+			bound_force(p);
+		}
+
+		lplc_color+=self_lplc_color/p->dens;
+		p->surf_norm=sqrt(grad_color.x*grad_color.x+grad_color.y*grad_color.y+grad_color.z*grad_color.z);
+
+		if(p->surf_norm > surf_norm)
+		{
+			p->acc.x+=surf_coe * lplc_color * grad_color.x / p->surf_norm;
+			p->acc.y+=surf_coe * lplc_color * grad_color.y / p->surf_norm;
+			p->acc.z+=surf_coe * lplc_color * grad_color.z / p->surf_norm;
+		}
+		COUNT_PARTICLE(counter[COUNT_FORCE]);
+	}
+
+	prof.end(PHASE_FORCE);
+}
+
+void SPHSystem::advection()
+{
+	Particle *p;
+	float3 a;
+	float v2;
+	float a2;
+	float max_v2=0.0f;
+	float max_a2=0.0f;
+
+	uint leapfrog=(integrator == INTEGRATOR_LEAPFROG && solver_mode == SOLVER_WCSPH);
+	float kick=leapfrog ? 0.5f*(last_time_step+time_step) : time_step;
+
+	prof.begin(PHASE_ADVECT);
+
+	for(uint i=0; i<num_particle; i++)
+	{
+		p=&(mem[i]);
+
+		if(p->sleep)
+		{
+			continue;
+		}
+
+		a.x=p->acc.x/p->dens+gravity.x;
+		a.y=p->acc.y/p->dens+gravity.y;
+		a.z=p->acc.z/p->dens+gravity.z;
+
+		p->vel.x=p->vel.x+a.x*kick;
+		p->vel.y=p->vel.y+a.y*kick;
+		p->vel.z=p->vel.z+a.z*kick;
+
+		p->pos.x=p->pos.x+p->vel.x*time_step;
+		p->pos.y=p->pos.y+p->vel.y*time_step;
+		p->pos.z=p->pos.z+p->vel.z*time_step;
+
+		bound_particle(p);
+
+		if(leapfrog)
+		{
+			p->ev.x=p->vel.x+a.x*time_step*0.5f;
+			p->ev.y=p->vel.y+a.y*time_step*0.5f;
+			p->ev.z=p->vel.z+a.z*time_step*0.5f;
+		}
+		else
+		{
+			p->ev.x=(p->ev.x+p->vel.x)/2;
+			p->ev.y=(p->ev.y+p->vel.y)/2;
+			p->ev.z=(p->ev.z+p->vel.z)/2;
+		}
+
+		v2=p->vel.x*p->vel.x+p->vel.y*p->vel.y+p->vel.z*p->vel.z;
+		a2=a.x*a.x+a.y*a.y+a.z*a.z;
+		max_v2=v2 > max_v2 ? v2 : max_v2;
+		max_a2=a2 > max_a2 ? a2 : max_a2;
+	}
+
+	max_vel=sqrt(max_v2);
+	max_acc=sqrt(max_a2);
+	last_time_step=leapfrog ? time_step : 0.0f;
+
+	prof.end(PHASE_ADVECT);
+}
+
+uint SPHSystem::add_obstacle(const char *mesh_file, float voxel_size)
+{
+	if(num_obstacle == MAX_OBSTACLE)
+	{
+		printf("Too many obstacles: %s\n", mesh_file);
+		return 0;
+	}
+
+	SDFVolume *sdf=new SDFVolume();
+	if(sdf->build(mesh_file, voxel_size) == 0)
+	{
+		delete sdf;
+		return 0;
+	}
+
+	obstacle[num_obstacle]=sdf;
+	num_obstacle++;
+
+	return 1;
+}
+
+float SPHSystem::obstacle_dist(float3 pos)
+{
+	float dist=1e30f;
+
+	for(uint i=0; i<num_obstacle; i++)
+	{
+		dist=fmin(dist, obstacle[i]->sample(pos, NULL));
+	}
+
+	return dist;
+}
+
+void SPHSystem::obstacle_clamp(float3 &pos, float3 *vel)
+{
+	float3 norm;
+	float dist;
+	float len;
+	float vn;
+
+	for(uint i=0; i<num_obstacle; i++)
+	{
+		dist=obstacle[i]->sample(pos, &norm);
+
+		if(dist >= obstacle_margin)
+		{
+			continue;
+		}
+
+		len=sqrt(norm.x*norm.x+norm.y*norm.y+norm.z*norm.z);
+		if(len <= INF)
+		{
+			continue;
+		}
+
+		norm.x/=len;
+		norm.y/=len;
+		norm.z/=len;
+
+		pos.x+=norm.x*(obstacle_margin-dist);
+		pos.y+=norm.y*(obstacle_margin-dist);
+		pos.z+=norm.z*(obstacle_margin-dist);
+
+		if(vel == NULL)
+		{
+			continue;
+		}
+
+		vn=vel->x*norm.x+vel->y*norm.y+vel->z*norm.z;
+		if(vn < 0.0f)
+		{
+			vel->x-=norm.x*vn*(1.0f-wall_damping);
+			vel->y-=norm.y*vn*(1.0f-wall_damping);
+			vel->z-=norm.z*vn*(1.0f-wall_damping);
+		}
+	}
+}
+
+/** Periodic axes wrap the cell coordinates in calc_cell_hash() and every
+ ** neighbor displacement goes through wrap_rel(), which picks the nearest
+ ** image, so the usual 27 cell search sees across the seam. The domain is
+ ** snapped to whole cells on a periodic axis and needs at least 3 of them,
+ ** or the search would visit a cell twice. Particles leaving the domain
+ ** come back on the other side instead of hitting a wall.
+ */
+
+void SPHSystem::set_periodic(uint x, uint y, uint z)
+{
+	if((x && grid_size.x < 3) || (y && grid_size.y < 3) || (z && grid_size.z < 3))
+	{
+		printf("Periodic axis needs at least 3 cells\n");
+		return;
+	}
+
+	periodic.x=x;
+	periodic.y=y;
+	periodic.z=z;
+	any_periodic=x || y || z;
+
+	if(x)
+	{
+		world_size.x=grid_size.x*cell_size;
+	}
+
+	if(y)
+	{
+		world_size.y=grid_size.y*cell_size;
+	}
+
+	if(z)
+	{
+		world_size.z=grid_size.z*cell_size;
+	}
+
+	init_boundary();
+
+	for(uint i=0; i<num_particle; i++)
+	{
+		wrap_pos(mem[i].pos);
+	}
+}
+
+void SPHSystem::wrap_pos(float3 &pos)
+{
+	if(periodic.x)
+	{
+		pos.x=pos.x-world_size.x*floor(pos.x/world_size.x);
+		pos.x=pos.x < world_size.x ? pos.x : 0.0f;
+	}
+
+	if(periodic.y)
+	{
+		pos.y=pos.y-world_size.y*floor(pos.y/world_size.y);
+		pos.y=pos.y < world_size.y ? pos.y : 0.0f;
+	}
+
+	if(periodic.z)
+	{
+		pos.z=pos.z-world_size.z*floor(pos.z/world_size.z);
+		pos.z=pos.z < world_size.z ? pos.z : 0.0f;
+	}
+}
+
+void SPHSystem::clamp_pos(float3 &pos)
+{
+	wrap_pos(pos);
+
+	if(periodic.x == 0)
+	{
+		pos.x=fmin(fmax(pos.x, 0.0f), world_size.x-BOUNDARY);
+	}
+
+	if(periodic.y == 0)
+	{
+		pos.y=fmin(fmax(pos.y, 0.0f), world_size.y-BOUNDARY);
+	}
+
+	if(periodic.z == 0)
+	{
+		pos.z=fmin(fmax(pos.z, 0.0f), world_size.z-BOUNDARY);
+	}
+}
+
+/** Pushes a particle that advected out of the fluid domain back in: out of
+ ** the obstacles first, then around the periodic axes, then against the
+ ** walls, where the normal velocity is damped by wall_damping.
+ */
+
+void SPHSystem::bound_particle(Particle *p)
+{
+	obstacle_clamp(p->pos, &(p->vel));
+	wrap_pos(p->pos);
+
+	if(periodic.x == 0 && p->pos.x >= world_size.x-BOUNDARY)
+	{
+		p->vel.x=p->vel.x*wall_damping;
+		p->pos.x=world_size.x-BOUNDARY;
+	}
+
+	if(periodic.x == 0 && p->pos.x < 0.0f)
+	{
+		p->vel.x=p->vel.x*wall_damping;
+		p->pos.x=0.0f;
+	}
+
+	if(periodic.y == 0 && p->pos.y >= world_size.y-BOUNDARY)
+	{
+		p->vel.y=p->vel.y*wall_damping;
+		p->pos.y=world_size.y-BOUNDARY;
+	}
+
+	if(periodic.y == 0 && p->pos.y < 0.0f)
+	{
+		p->vel.y=p->vel.y*wall_damping;
+		p->pos.y=0.0f;
+	}
+
+	if(periodic.z == 0 && p->pos.z >= world_size.z-BOUNDARY)
+	{
+		p->vel.z=p->vel.z*wall_damping;
+		p->pos.z=world_size.z-BOUNDARY;
+	}
+
+	if(periodic.z == 0 && p->pos.z < 0.0f)
+	{
+		p->vel.z=p->vel.z*wall_damping;
+		p->pos.z=0.0f;
+	}
+}
+
+void SPHSystem::build_neighbor()
+{
+	Particle *p;
+	Particle *np;
+
+	int3 cell_pos;
+	int3 near_pos;
+	uint hash;
+
+	float3 rel_pos;
+	float r2;
+	uint count=0;
+
+	prof.begin(PHASE_NEIGHBOR);
+
+	for(uint i=0; i<num_particle; i++)
+	{
+		p=&(mem[i]);
+		cell_pos=calc_cell_pos(p->pos);
+		nb_start[i]=count;
+
+		for(int x=-1; x<=1; x++)
+		{
+			for(int y=-1; y<=1; y++)
+			{
+				for(int z=-1; z<=1; z++)
+				{
+					near_pos.x=cell_pos.x+x;
+					near_pos.y=cell_pos.y+y;
+					near_pos.z=cell_pos.z+z;
+					hash=calc_cell_hash(near_pos);
+
+					if(hash == 0xffffffff)
+					{
+						continue;
+					}
+
+					np=cell[hash];
+					while(np != NULL)
+					{
+						rel_pos.x=np->pos.x-p->pos.x;
+						rel_pos.y=np->pos.y-p->pos.y;
+						rel_pos.z=np->pos.z-p->pos.z;
+						wrap_rel(rel_pos);
+						r2=rel_pos.x*rel_pos.x+rel_pos.y*rel_pos.y+rel_pos.z*rel_pos.z;
+
+						if(r2 > INF && r2 < kernel_2)
+						{
+							if(count == nb_cap)
+							{
+								nb_cap=nb_cap*2;
+								nb_list=(uint *)realloc(nb_list, sizeof(uint)*nb_cap);
+							}
+
+							nb_list[count]=(uint)(np-mem);
+							count++;
+						}
+
+						np=np->next;
+					}
+				}
+			}
+		}
+	}
+
+	nb_start[num_particle]=count;
+
+	prof.end(PHASE_NEIGHBOR);
+}
+
+int3 SPHSystem::calc_cell_pos(float3 p)
+{
+	int3 cell_pos;
+	cell_pos.x = int(floor((p.x) / cell_size));
+	cell_pos.y = int(floor((p.y) / cell_size));
+	cell_pos.z = int(floor((p.z) / cell_size));
+
+    return cell_pos;
+}
+
+uint SPHSystem::calc_cell_hash(int3 cell_pos)
+{
+	if(any_periodic)
+	{
+		cell_pos.x=periodic.x ? (cell_pos.x%(int)grid_size.x+(int)grid_size.x)%(int)grid_size.x : cell_pos.x;
+		cell_pos.y=periodic.y ? (cell_pos.y%(int)grid_size.y+(int)grid_size.y)%(int)grid_size.y : cell_pos.y;
+		cell_pos.z=periodic.z ? (cell_pos.z%(int)grid_size.z+(int)grid_size.z)%(int)grid_size.z : cell_pos.z;
+	}
+
+	if(cell_pos.x<0 || cell_pos.x>=(int)grid_size.x || cell_pos.y<0 || cell_pos.y>=(int)grid_size.y || cell_pos.z<0 || cell_pos.z>=(int)grid_size.z)
+	{
+		return (uint)0xffffffff;
+	}
+
+	return ((uint)(cell_pos.z))*grid_size.y*grid_size.x + ((uint)(cell_pos.y))*grid_size.x + (uint)(cell_pos.x);
+}
@@ -1,101 +1,357 @@
-/** File:		sph_system.h
- ** Author:		Dongli Zhang
- ** Contact:	dongli.zhang0129@gmail.com
- **
- ** Copyright (C) Dongli Zhang 2013
- **
- ** This program is free software;  you can redistribute it and/or modify
- ** it under the terms of the GNU General Public License as published by
- ** the Free Software Foundation; either version 2 of the License, or
- ** (at your option) any later version.
- **
- ** This program is distributed in the hope that it will be useful,
- ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
- ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
- ** the GNU General Public License for more details.
- **
- ** You should have received a copy of the GNU General Public License
- ** along with this program;  if not, write to the Free Software 
- ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
- */
-
-#ifndef __SPHSYSTEM_H__
-#define __SPHSYSTEM_H__
-
-#include "sph_type.h"
-
-class Particle
-{
-public:
-	uint id;
-	float3 pos;
-	float3 vel;
-	float3 acc;
-	float3 ev;
-
-	float dens;
-	float pres;
-
-	float surf_norm;
-
-	Particle *next;
-};
-
-class SPHSystem
-{
-public:
-	uint max_particle;
-	uint num_particle;
-
-	float kernel;
-	float mass;
-
-	float3 world_size;
-	float cell_size;
-	uint3 grid_size;
-	uint tot_cell;
-
-	float3 gravity;
-	float wall_damping;
-	float rest_density;
-	float gas_constant;
-	float viscosity;
-	float time_step;
-	float surf_norm;
-	float surf_coe;
-
-	float poly6_value;
-	float spiky_value;
-	float visco_value;
-
-	float grad_poly6;
-	float lplc_poly6;
-
-	float kernel_2;
-	float self_dens;
-	float self_lplc_color;
-
-	Particle *mem;
-	Particle **cell;
-
-	uint sys_running;
-
-public:
-	SPHSystem();
-	~SPHSystem();
-	void animation();
-	void init_system();
-	void add_particle(float3 pos, float3 vel);
-
-private:
-	void build_table();
-	void comp_dens_pres();
-	void comp_force_adv();
-	void advection();
-
-private:
-	int3 calc_cell_pos(float3 p);
-	uint calc_cell_hash(int3 cell_pos);
-};
-
-#endif
+/** File:		sph_system.h
+ ** Author:		Dongli Zhang
+ ** Contact:	dongli.zhang0129@gmail.com
+ **
+ ** Copyright (C) Dongli Zhang 2013
+ **
+ ** This program is free software;  you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+ ** the GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program;  if not, write to the Free Software 
+ ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef __SPHSYSTEM_H__
+#define __SPHSYSTEM_H__
+
+#include "sph_type.h"
+#include "sph_kernel.h"
+#include "sph_sdf.h"
+#include "sph_checkpoint.h"
+#include "sph_scene.h"
+#include "sph_timer.h"
+
+typedef Poly6<3> DensKernel;
+typedef Spiky<3> PresKernel;
+typedef Viscosity<3> ViscKernel;
+
+enum SolverMode
+{
+	SOLVER_WCSPH=0,
+	SOLVER_DFSPH=1,
+	SOLVER_IISPH=2,
+	SOLVER_PBF=3,
+	NUM_SOLVER
+};
+
+#define MAX_RES_LEVEL 4
+#define MAX_OBSTACLE 8
+
+enum Integrator
+{
+	INTEGRATOR_EULER=0,
+	INTEGRATOR_LEAPFROG=1,
+	NUM_INTEGRATOR
+};
+
+class Particle
+{
+public:
+	uint id;
+	float3 pos;
+	float3 vel;
+	float3 acc;
+	float3 ev;
+
+	float3 pred_pos;
+	float3 pred_vel;
+	float3 pres_acc;
+
+	float dens;
+	float pres;
+	float alpha;
+	float dens_adv;
+
+	float surf_norm;
+
+	uint level;
+	uint active;
+	float last_step;
+
+	uint sleep;
+	float last_dens;
+
+	float mass;
+	float kernel;
+	uint res_level;
+	uint res_step;
+
+	Particle *next;
+};
+
+class SPHSystem
+{
+public:
+	uint max_particle;
+	uint num_particle;
+	uint next_id;
+
+	float kernel;
+	float mass;
+
+	float3 world_size;
+	float cell_size;
+	uint3 grid_size;
+	uint tot_cell;
+
+	float3 gravity;
+	float wall_damping;
+	float rest_density;
+	float gas_constant;
+	float viscosity;
+	float time_step;
+	float surf_norm;
+	float surf_coe;
+
+	DensKernel w_dens;
+	PresKernel w_pres;
+	ViscKernel w_visc;
+
+	float grad_poly6;
+	float lplc_poly6;
+
+	float kernel_2;
+	float self_dens;
+	float self_lplc_color;
+
+	uint integrator;
+	float last_time_step;
+
+	uint adaptive_step;
+	float frame_time;
+	float min_time_step;
+	float max_time_step;
+	float max_implicit_step;
+	float cfl_factor;
+	float force_factor;
+	float visc_factor;
+
+	float max_vel;
+	float max_acc;
+	uint frame_step;
+	uint tot_step;
+
+	uint solver_mode;
+	float lattice_density;
+	float max_dens_err;
+	uint min_iter;
+	uint max_iter;
+	uint solver_iter;
+	uint tot_iter;
+	float solver_err;
+
+	float jacobi_omega;
+
+	uint pbf_iter;
+	float pbf_relax;
+	float pbf_scorr;
+	float pbf_scorr_dq;
+	float pbf_xsph_coe;
+	float pbf_grad2;
+
+	float max_div_err;
+	uint max_div_iter;
+	uint div_iter;
+	float div_err;
+
+	uint block_step;
+	uint max_level;
+	uint block_count;
+	uint block_active;
+	float block_carry;
+	uint num_active;
+	uint tot_force_eval;
+
+	uint sleeping;
+	float sleep_vel;
+	float sleep_dens;
+	uint sleep_steps;
+	uint num_sleep;
+	uint *cell_quiet;
+
+	uint adaptive_res;
+	uint adapt_max_level;
+	uint adapt_depth;
+	uint adapt_interval;
+	float adapt_h_ratio;
+	float adapt_scale[MAX_RES_LEVEL+1][MAX_RES_LEVEL+1];
+	float adapt_range[MAX_RES_LEVEL+1][MAX_RES_LEVEL+1];
+	uint num_coarse;
+	uint *cell_depth;
+
+	SDFVolume *obstacle[MAX_OBSTACLE];
+	uint num_obstacle;
+	float obstacle_margin;
+
+	uint bound_part;
+	uint num_bound;
+	float3 *bound_pos;
+	float *bound_psi;
+	uint *bound_start;
+	float3 bound_min;
+	float3 bound_max;
+
+	uint3 periodic;
+
+	float relax_tau;
+	float relax_vel;
+	float relax_window;
+	float relax_time;
+	uint any_periodic;
+
+	float sim_time;
+	Emitter emitter[MAX_EMITTER];
+	uint num_emitter;
+	SceneOutput output;
+
+	Profiler prof;
+	LoopCounter counter[NUM_COUNT_LOOP];
+	uint count_every;
+
+	uint *export_index;
+	uint max_export;
+	uint *sample_index;
+	uint *sample_id;
+	uint num_sample;
+	uint max_sample;
+	uint sample_scan;
+	uint sample_rate;
+
+	Particle *mem;
+	Particle **cell;
+	Particle *table_mem;
+	uint table_num;
+
+	uint *nb_start;
+	uint *nb_list;
+	uint nb_cap;
+
+	uint sys_running;
+
+public:
+	SPHSystem();
+	~SPHSystem();
+	void animation();
+	void init_system();
+	void add_particle(float3 pos, float3 vel);
+	uint add_obstacle(const char *mesh_file, float voxel_size);
+	float obstacle_dist(float3 pos);
+	void set_periodic(uint x, uint y, uint z);
+	uint save_checkpoint(const char *file);
+	uint load_checkpoint(const char *file);
+	uint init_relaxed(const char *cache_dir);
+	uint relax_cached(const char *cache_dir);
+	unsigned long long relax_key();
+	uint load_scene(const char *file, char **extra, uint num_extra);
+	const uint *select_particle(const ExportFilter *filter, uint *num);
+	void build_table();
+	void comp_dens_pres();
+	void comp_force_adv(uint pres_force);
+	void advection();
+
+private:
+	void init_params();
+	void init_particle(Particle *p, uint id, float3 pos, float3 vel);
+	void step();
+	float comp_time_step();
+	void build_neighbor();
+	void obstacle_clamp(float3 &pos, float3 *vel);
+	void wrap_pos(float3 &pos);
+	void clamp_pos(float3 &pos);
+	void bound_particle(Particle *p);
+	void reserve_particle(uint num);
+	void pack_checkpoint(CheckpointHeader *h);
+	void unpack_checkpoint(const CheckpointHeader *h);
+	void relax_system();
+	void *scene_param(const char *name, uint *type);
+	uint scene_inside(const SceneShape *shape, float3 pos);
+	uint fill_shape(const SceneShape *shape, uint index);
+	void emit(float dt);
+	void emit_layer(Emitter *e, float offset);
+	uint select_region(const ExportFilter *filter);
+	uint select_sample(uint sample);
+
+	void init_boundary();
+	int3 bound_cell_pos(float3 pos);
+	uint bound_far(float3 pos);
+	float bound_dens(Particle *p);
+	void bound_force(Particle *p);
+
+	void dfsph_step();
+	void dfsph_dens_alpha();
+	void dfsph_div_solve();
+	void dfsph_dens_solve();
+	float dfsph_dens_adv(bool div);
+	void dfsph_kappa_vel(float scale);
+
+	void iisph_step();
+	void iisph_dens_diag();
+	void iisph_source();
+	void iisph_pres_acc();
+	float iisph_relax();
+
+	void init_pbf();
+	void pbf_step();
+	void pbf_clamp(float3 &pos);
+	float pbf_lambda();
+	void pbf_project(float w_corr);
+	void pbf_xsph();
+
+	void block_animation();
+	void block_substep(uint count);
+	void block_level(uint count);
+	void block_advection();
+
+	void sleep_update();
+	void wake_all();
+
+	void adapt_step();
+	void adapt_refine();
+	uint adapt_target(float3 pos);
+	uint adapt_air(int3 cell_pos);
+	void adapt_depth_field();
+	void adapt_merge();
+	void adapt_split();
+	void adapt_halve(Particle *p);
+	void adapt_sort();
+	void adapt_span(int3 &min_pos, int3 &max_pos);
+	void adapt_dens_pres();
+	void adapt_force();
+
+private:
+	int3 calc_cell_pos(float3 p);
+	uint calc_cell_hash(int3 cell_pos);
+
+	inline void wrap_rel(float3 &rel) const
+	{
+		if(any_periodic == 0)
+		{
+			return;
+		}
+
+		if(periodic.x)
+		{
+			rel.x=rel.x > world_size.x*0.5f ? rel.x-world_size.x : (rel.x < -world_size.x*0.5f ? rel.x+world_size.x : rel.x);
+		}
+
+		if(periodic.y)
+		{
+			rel.y=rel.y > world_size.y*0.5f ? rel.y-world_size.y : (rel.y < -world_size.y*0.5f ? rel.y+world_size.y : rel.y);
+		}
+
+		if(periodic.z)
+		{
+			rel.z=rel.z > world_size.z*0.5f ? rel.z-world_size.z : (rel.z < -world_size.z*0.5f ? rel.z+world_size.z : rel.z);
+		}
+	}
+};
+
+#endif
@@ -1,47 +1,415 @@
-/** File:		sph_timer.cpp
- ** Author:		Dongli Zhang
- ** Contact:	dongli.zhang0129@gmail.com
- **
- ** Copyright (C) Dongli Zhang 2013
- **
- ** This program is free software;  you can redistribute it and/or modify
- ** it under the terms of the GNU General Public License as published by
- ** the Free Software Foundation; either version 2 of the License, or
- ** (at your option) any later version.
- **
- ** This program is distributed in the hope that it will be useful,
- ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
- ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
- ** the GNU General Public License for more details.
- **
- ** You should have received a copy of the GNU General Public License
- ** along with this program;  if not, write to the Free Software 
- ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
- */
-
-#include "sph_timer.h"
-
-Timer::Timer()
-{
-	frames=0;
-	update_time=1000;
-	last_time=0;
-	FPS=0;
-}
-
-void Timer::update()
-{
-	frames++;
-
-	if(GetTickCount()-last_time > update_time) 
-	{
-		FPS=((double)frames/(double)(GetTickCount()-last_time))*1000.0; 
-		last_time=GetTickCount();
-		frames=0;
-	}
-}
-
-double Timer::get_fps()
-{
-	return FPS;
-}
+/** File:		sph_timer.cpp
+ ** Author:		Dongli Zhang
+ ** Contact:	dongli.zhang0129@gmail.com
+ **
+ ** Copyright (C) Dongli Zhang 2013
+ **
+ ** This program is free software;  you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+ ** the GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program;  if not, write to the Free Software 
+ ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "sph_timer.h"
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+
+const char *phase_name[NUM_PHASE]=
+{
+	"table",
+	"neighbor",
+	"density",
+	"force",
+	"pressure",
+	"advect",
+	"export",
+	"render",
+	"other",
+	"frame"
+};
+
+const char *count_name[NUM_COUNT_LOOP]=
+{
+	"density",
+	"force"
+};
+
+struct TraceRing
+{
+	uint tid;
+	char name[32];
+	std::atomic<unsigned long long> head;
+	TraceEvent event[TRACE_RING];
+};
+
+std::atomic<uint> trace_enabled(0);
+
+static std::atomic<TraceRing *> trace_ring[TRACE_MAX_THREAD];
+static std::atomic<uint> trace_num(0);
+static thread_local TraceRing *local_ring=NULL;
+static thread_local uint local_full=0;
+
+Profiler::Profiler()
+{
+	enabled=0;
+	csv=NULL;
+	reset();
+}
+
+Profiler::~Profiler()
+{
+	close_csv();
+}
+
+void Profiler::reset()
+{
+	for(uint i=0; i<NUM_PHASE; i++)
+	{
+		start[i]=0.0;
+		cur[i]=0.0;
+		total[i]=0.0;
+	}
+
+	num_frame=0;
+	num_window=0;
+	head=0;
+	last_frame=profile_now();
+}
+
+void Profiler::end_frame()
+{
+	double now=profile_now();
+	double named=0.0;
+
+	cur[PHASE_FRAME]=now-last_frame;
+	last_frame=now;
+
+	for(uint i=0; i<PHASE_OTHER; i++)
+	{
+		named+=cur[i];
+	}
+	cur[PHASE_OTHER]=cur[PHASE_FRAME]-named > 0.0 ? cur[PHASE_FRAME]-named : 0.0;
+
+	for(uint i=0; i<NUM_PHASE; i++)
+	{
+		window[i][head]=(float)(cur[i]*1000.0);
+		total[i]+=cur[i];
+	}
+	head=(head+1)%PROFILE_WINDOW;
+	num_window=num_window < PROFILE_WINDOW ? num_window+1 : PROFILE_WINDOW;
+	num_frame++;
+
+	if(csv != NULL)
+	{
+		fprintf(csv, "%u", num_frame);
+		for(uint i=0; i<NUM_PHASE; i++)
+		{
+			fprintf(csv, ",%.4f", cur[i]*1000.0);
+		}
+		fprintf(csv, "\n");
+	}
+
+	for(uint i=0; i<NUM_PHASE; i++)
+	{
+		cur[i]=0.0;
+	}
+}
+
+double Profiler::mean(uint phase)
+{
+	double sum=0.0;
+
+	for(uint i=0; i<num_window; i++)
+	{
+		sum+=window[phase][i];
+	}
+
+	return num_window > 0 ? sum/num_window : 0.0;
+}
+
+static int compare_ms(const void *a, const void *b)
+{
+	float x=*(const float *)a;
+	float y=*(const float *)b;
+
+	return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+double Profiler::percentile(uint phase, float p)
+{
+	float sorted[PROFILE_WINDOW];
+	uint rank;
+
+	if(num_window == 0)
+	{
+		return 0.0;
+	}
+
+	memcpy(sorted, window[phase], sizeof(float)*num_window);
+	qsort(sorted, num_window, sizeof(float), compare_ms);
+
+	rank=(uint)(p*(num_window-1)+0.5f);
+
+	return sorted[rank < num_window ? rank : num_window-1];
+}
+
+double Profiler::peak(uint phase)
+{
+	float value=0.0f;
+
+	for(uint i=0; i<num_window; i++)
+	{
+		value=window[phase][i] > value ? window[phase][i] : value;
+	}
+
+	return value;
+}
+
+double Profiler::get_fps()
+{
+	double ms=mean(PHASE_FRAME);
+
+	return ms > 0.0 ? 1000.0/ms : 0.0;
+}
+
+void Profiler::print()
+{
+	double frame=mean(PHASE_FRAME);
+
+	printf("Profile over the last %u frames, %u in total (ms):\n", num_window, num_frame);
+	printf("%-10s %10s %10s %10s %10s %10s %8s\n", "phase", "mean", "p50", "p95", "p99", "max", "share");
+	for(uint i=0; i<NUM_PHASE; i++)
+	{
+		printf("%-10s %10.3f %10.3f %10.3f %10.3f %10.3f %7.1f%%\n", phase_name[i], mean(i), percentile(i, 0.5f), percentile(i, 0.95f), percentile(i, 0.99f), peak(i), frame > 0.0 ? mean(i)*100.0/frame : 0.0);
+	}
+}
+
+void Profiler::title(char *buf, uint size)
+{
+	char part[64];
+	size_t used;
+
+	sprintf(part, "%.1f ms (p95 %.1f, max %.1f)", mean(PHASE_FRAME), percentile(PHASE_FRAME, 0.95f), peak(PHASE_FRAME));
+	buf[0]='\0';
+	used=0;
+
+	for(uint i=0; i<=PHASE_FRAME; i++)
+	{
+		if(strlen(part)+used >= size)
+		{
+			break;
+		}
+		strcpy(buf+used, part);
+		used+=strlen(part);
+
+		if(enabled == 0 || i == PHASE_FRAME)
+		{
+			break;
+		}
+		sprintf(part, " %s %.1f", phase_name[i], mean(i));
+	}
+}
+
+uint Profiler::open_csv(const char *file)
+{
+	close_csv();
+
+	csv=fopen(file, "w");
+	if(csv == NULL)
+	{
+		printf("Cannot write profile: %s\n", file);
+		return 0;
+	}
+
+	fprintf(csv, "frame");
+	for(uint i=0; i<NUM_PHASE; i++)
+	{
+		fprintf(csv, ",%s_ms", phase_name[i]);
+	}
+	fprintf(csv, "\n");
+
+	return 1;
+}
+
+void Profiler::close_csv()
+{
+	if(csv != NULL)
+	{
+		fclose(csv);
+		csv=NULL;
+	}
+}
+
+LoopCounter::LoopCounter()
+{
+	reset();
+}
+
+void LoopCounter::reset()
+{
+	cells=0;
+	candidates=0;
+	pairs=0;
+	particles=0;
+	min_nb=0xffffffff;
+	max_nb=0;
+	cur_nb=0;
+
+	for(uint i=0; i<NUM_NB_BIN; i++)
+	{
+		hist[i]=0;
+	}
+}
+
+void LoopCounter::print(const char *name)
+{
+	if(particles == 0)
+	{
+		return;
+	}
+
+	printf("  %-8s cells %llu candidates %llu pairs %llu (%.1f%%) nb min %u mean %.2f max %u\n", name, cells, candidates, pairs,
+		candidates > 0 ? pairs*100.0/candidates : 0.0, min_nb, (double)pairs/particles, max_nb);
+
+	printf("  %-8s hist", "");
+	for(uint i=0; i<NUM_NB_BIN; i++)
+	{
+		if(hist[i] > 0)
+		{
+			printf(i == NUM_NB_BIN-1 ? " %u+:%u" : " %u:%u", i*NB_BIN_WIDTH, hist[i]);
+		}
+	}
+	printf("\n");
+}
+
+/** The ring of the calling thread, made on its first event. Past
+ ** TRACE_MAX_THREAD threads the rest are not traced.
+ */
+
+static TraceRing *trace_local()
+{
+	uint tid;
+
+	if(local_ring != NULL || local_full)
+	{
+		return local_ring;
+	}
+
+	tid=trace_num.fetch_add(1);
+	if(tid >= TRACE_MAX_THREAD)
+	{
+		local_full=1;
+		return NULL;
+	}
+
+	local_ring=new TraceRing();
+	local_ring->tid=tid;
+	sprintf(local_ring->name, "thread %u", tid);
+	local_ring->head.store(0);
+	trace_ring[tid].store(local_ring, std::memory_order_release);
+
+	return local_ring;
+}
+
+void trace_thread(const char *name)
+{
+	TraceRing *ring=trace_local();
+
+	if(ring != NULL)
+	{
+		strncpy(ring->name, name, sizeof(ring->name)-1);
+		ring->name[sizeof(ring->name)-1]='\0';
+	}
+}
+
+void trace_event(const char *name, double start, double dur)
+{
+	TraceRing *ring=trace_local();
+	unsigned long long head;
+	TraceEvent *e;
+
+	if(ring == NULL)
+	{
+		return;
+	}
+
+	head=ring->head.load(std::memory_order_relaxed);
+	e=&(ring->event[head%TRACE_RING]);
+	e->name=name;
+	e->start=start;
+	e->dur=dur;
+	ring->head.store(head+1, std::memory_order_release);
+}
+
+uint trace_dump(const char *file)
+{
+	TraceRing *ring[TRACE_MAX_THREAD];
+	unsigned long long head[TRACE_MAX_THREAD];
+	unsigned long long first[TRACE_MAX_THREAD];
+	uint num=trace_num.load();
+	double origin=-1.0;
+	uint count=0;
+	TraceEvent *e;
+	FILE *fp;
+
+	num=num < TRACE_MAX_THREAD ? num : TRACE_MAX_THREAD;
+	for(uint i=0; i<num; i++)
+	{
+		ring[i]=trace_ring[i].load(std::memory_order_acquire);
+		head[i]=ring[i] != NULL ? ring[i]->head.load(std::memory_order_acquire) : 0;
+		first[i]=head[i] > TRACE_RING-TRACE_GUARD ? head[i]-(TRACE_RING-TRACE_GUARD) : 0;
+
+		for(unsigned long long j=first[i]; j<head[i]; j++)
+		{
+			e=&(ring[i]->event[j%TRACE_RING]);
+			origin=origin < 0.0 || e->start < origin ? e->start : origin;
+		}
+	}
+
+	fp=fopen(file, "w");
+	if(fp == NULL)
+	{
+		printf("Cannot write trace: %s\n", file);
+		return 0;
+	}
+
+	fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	for(uint i=0; i<num; i++)
+	{
+		if(ring[i] == NULL)
+		{
+			continue;
+		}
+
+		fprintf(fp, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}", count > 0 ? ",\n" : "", ring[i]->tid, ring[i]->name);
+		count++;
+
+		for(unsigned long long j=first[i]; j<head[i]; j++)
+		{
+			e=&(ring[i]->event[j%TRACE_RING]);
+			fprintf(fp, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}", e->name, ring[i]->tid, (e->start-origin)*1e6, e->dur*1e6);
+			count++;
+		}
+	}
+	fprintf(fp, "\n]}\n");
+
+	if(fclose(fp) != 0)
+	{
+		printf("Cannot write trace: %s\n", file);
+		return 0;
+	}
+
+	printf("Trace: %u events to %s\n", count, file);
+
+	return 1;
+}
@@ -1,41 +1,248 @@
-/** File:		sph_timer.h
- ** Author:		Dongli Zhang
- ** Contact:	dongli.zhang0129@gmail.com
- **
- ** Copyright (C) Dongli Zhang 2013
- **
- ** This program is free software;  you can redistribute it and/or modify
- ** it under the terms of the GNU General Public License as published by
- ** the Free Software Foundation; either version 2 of the License, or
- ** (at your option) any later version.
- **
- ** This program is distributed in the hope that it will be useful,
- ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
- ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
- ** the GNU General Public License for more details.
- **
- ** You should have received a copy of the GNU General Public License
- ** along with this program;  if not, write to the Free Software 
- ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
- */
-
-#ifndef __SPHTIMER_H__
-#define __SPHTIMER_H__
-
-#include <windows.h>
-
-class Timer
-{
-private:
-	int frames;
-	int update_time;
-	int last_time;
-	double FPS;
-
-public:
-	Timer();
-	void update();
-	double get_fps();
-};
-
-#endif
+/** File:		sph_timer.h
+ ** Author:		Dongli Zhang
+ ** Contact:	dongli.zhang0129@gmail.com
+ **
+ ** Copyright (C) Dongli Zhang 2013
+ **
+ ** This program is free software;  you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+ ** the GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program;  if not, write to the Free Software 
+ ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef __SPHTIMER_H__
+#define __SPHTIMER_H__
+
+#include "sph_type.h"
+#include <stdio.h>
+#include <chrono>
+#include <atomic>
+
+#define PROFILE_WINDOW 128
+#define TRACE_RING 65536
+#define TRACE_GUARD 1024
+#define TRACE_MAX_THREAD 16
+
+enum ProfilePhase
+{
+	PHASE_TABLE=0,
+	PHASE_NEIGHBOR=1,
+	PHASE_DENS=2,
+	PHASE_FORCE=3,
+	PHASE_PRESSURE=4,
+	PHASE_ADVECT=5,
+	PHASE_EXPORT=6,
+	PHASE_RENDER=7,
+	PHASE_OTHER=8,
+	PHASE_FRAME=9,
+	NUM_PHASE
+};
+
+extern const char *phase_name[NUM_PHASE];
+
+/** Timeline of scoped events for chrome://tracing and Perfetto.
+ **
+ ** Every thread that records gets its own ring of TRACE_RING events the
+ ** first time, so recording is a clock read and a store with no lock; the
+ ** ring only moves its head with a release store once the event is
+ ** complete. trace_dump() writes every ring as Chrome trace JSON and can
+ ** run while the threads keep recording: it leaves out the TRACE_GUARD
+ ** oldest events of a full ring, which a writer may be overwriting.
+ **
+ ** Times are steady_clock seconds like profile_now(). Profiler phases are
+ ** traced by begin() and end() when trace_enabled is set, whether or not
+ ** the profiler itself is enabled. trace_enabled is switched on by the main
+ ** thread while the writer thread may be reading it, so it is atomic; the
+ ** readers use relaxed loads, the rings order their own events.
+ */
+
+struct TraceEvent
+{
+	const char *name;
+	double start;
+	double dur;
+};
+
+extern std::atomic<uint> trace_enabled;
+
+void trace_thread(const char *name);
+void trace_event(const char *name, double start, double dur);
+uint trace_dump(const char *file);
+
+/** Per phase wall time of every frame, on steady_clock.
+ **
+ ** begin() and end() bracket a phase and add to its time in the current
+ ** frame, so a phase run once per step or once per solver iteration sums
+ ** up over the frame. end_frame() closes the frame: PHASE_FRAME is the time
+ ** since the previous end_frame(), PHASE_OTHER whatever the named phases
+ ** did not cover. The last PROFILE_WINDOW frames of every phase are kept
+ ** for the mean, percentiles and max, and each frame can go to a CSV file
+ ** as one row in milliseconds.
+ **
+ ** With enabled 0 begin() and end() are a test and a branch, and the
+ ** frame time is still kept for get_fps().
+ */
+
+class Profiler
+{
+public:
+	uint enabled;
+	uint num_frame;
+	double total[NUM_PHASE];
+
+public:
+	Profiler();
+	~Profiler();
+
+	void begin(uint phase)
+	{
+		if(enabled || trace_enabled.load(std::memory_order_relaxed))
+		{
+			start[phase]=profile_now();
+		}
+	}
+
+	void end(uint phase)
+	{
+		double now;
+		uint trace=trace_enabled.load(std::memory_order_relaxed);
+
+		if(enabled || trace)
+		{
+			now=profile_now();
+			if(enabled)
+			{
+				cur[phase]+=now-start[phase];
+			}
+			if(trace)
+			{
+				trace_event(phase_name[phase], start[phase], now-start[phase]);
+			}
+		}
+	}
+
+	void end_frame();
+	void reset();
+
+	double mean(uint phase);
+	double percentile(uint phase, float p);
+	double peak(uint phase);
+	double get_fps();
+
+	void print();
+	void title(char *buf, uint size);
+	uint open_csv(const char *file);
+	void close_csv();
+
+	static double profile_now()
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+private:
+	double start[NUM_PHASE];
+	double cur[NUM_PHASE];
+	float window[NUM_PHASE][PROFILE_WINDOW];
+	uint num_window;
+	uint head;
+	double last_frame;
+	FILE *csv;
+};
+
+#define NB_BIN_WIDTH 4
+#define NUM_NB_BIN 17
+
+enum CountLoop
+{
+	COUNT_DENS=0,
+	COUNT_FORCE=1,
+	NUM_COUNT_LOOP
+};
+
+/** Neighbor search counters of one loop, summed over a step.
+ **
+ ** cells are the hashed cells that exist, candidates every particle met in
+ ** their lists and pairs the candidates inside the kernel. Each particle's
+ ** pairs go to min, max and a histogram of NB_BIN_WIDTH wide bins, the last
+ ** one open. The COUNT_ macros are what the loops call; they only expand
+ ** when built with -DSPH_COUNTERS, so a normal build does no extra work.
+ */
+
+class LoopCounter
+{
+public:
+	unsigned long long cells;
+	unsigned long long candidates;
+	unsigned long long pairs;
+	uint particles;
+	uint min_nb;
+	uint max_nb;
+	uint cur_nb;
+	uint hist[NUM_NB_BIN];
+
+public:
+	LoopCounter();
+	void reset();
+	void print(const char *name);
+
+	void end_particle()
+	{
+		pairs+=cur_nb;
+		particles++;
+		min_nb=cur_nb < min_nb ? cur_nb : min_nb;
+		max_nb=cur_nb > max_nb ? cur_nb : max_nb;
+		hist[cur_nb/NB_BIN_WIDTH < NUM_NB_BIN ? cur_nb/NB_BIN_WIDTH : NUM_NB_BIN-1]++;
+		cur_nb=0;
+	}
+};
+
+#ifdef SPH_COUNTERS
+#define COUNT_CELL(c) ((c).cells++)
+#define COUNT_CANDIDATE(c) ((c).candidates++)
+#define COUNT_PAIR(c) ((c).cur_nb++)
+#define COUNT_PARTICLE(c) ((c).end_particle())
+#else
+#define COUNT_CELL(c)
+#define COUNT_CANDIDATE(c)
+#define COUNT_PAIR(c)
+#define COUNT_PARTICLE(c)
+#endif
+
+/** Traces the enclosing block under name, for code with several returns
+ ** or outside the profiler phases.
+ */
+
+class TraceScope
+{
+public:
+	TraceScope(const char *_name)
+	{
+		name=_name;
+		start=trace_enabled.load(std::memory_order_relaxed) ? Profiler::profile_now() : -1.0;
+	}
+
+	~TraceScope()
+	{
+		if(start >= 0.0)
+		{
+			trace_event(name, start, Profiler::profile_now()-start);
+		}
+	}
+
+private:
+	const char *name;
+	double start;
+};
+
+extern const char *count_name[NUM_COUNT_LOOP];
+
+#endif
@@ -21,7 +21,6 @@
 
 #include "MarchingCube.h"
 #include "MarchingCubeTable.h"
-#include <gl/glut.h>
 #include <stdio.h>
 
 MarchingCube::MarchingCube(uint _row_vox, uint _col_vox, uint _len_vox, float *_scalar, float3 *_pos, float3 _origin, float _step, float _isovalue)
@@ -30,6 +29,7 @@ MarchingCube::MarchingCube(uint _row_vox, uint _col_vox, uint _len_vox, float *_
 	col_vox = _col_vox;
 	len_vox = _len_vox;
 	tot_vox	= row_vox*col_vox*len_vox;
+	step	= _step;
 
 	scalar  = _scalar;
 	pos		= _pos;
@@ -39,11 +39,18 @@ MarchingCube::MarchingCube(uint _row_vox, uint _col_vox, uint _len_vox, float *_
 	
 	normal  = (float3 *)malloc(sizeof(float3)*tot_vox);
 	memset(normal, 0, sizeof(float3)*tot_vox);
+
+	num_tri = 0;
+	max_tri = 1024;
+	tri_pos = (float3 *)malloc(sizeof(float3)*3*max_tri);
+	tri_norm = (float3 *)malloc(sizeof(float3)*3*max_tri);
 }
 
 MarchingCube::~MarchingCube()
 {
 	free(normal);
+	free(tri_pos);
+	free(tri_norm);
 }
 
 void MarchingCube::run()
@@ -66,6 +73,8 @@ void MarchingCube::run()
 	int flag_index;
 	int edge_flags;
 
+	num_tri = 0;
+
 	for(uint count_x=0; count_x<row_vox; count_x++)
 	{
 		for(uint count_y=0; count_y<col_vox; count_y++)
@@ -207,18 +216,24 @@ void MarchingCube::run()
 						break;
 					}
 
-					glBegin(GL_TRIANGLES);
-						for(uint count_point = 0; count_point < 3; count_point++)
-						{
-							index = triangle_table[flag_index][3*count_triangle+count_point];
+					if(num_tri == max_tri)
+					{
+						max_tri = max_tri*2;
+						tri_pos = (float3 *)realloc(tri_pos, sizeof(float3)*3*max_tri);
+						tri_norm = (float3 *)realloc(tri_norm, sizeof(float3)*3*max_tri);
+					}
+
+					for(uint count_point = 0; count_point < 3; count_point++)
+					{
+						index = triangle_table[flag_index][3*count_triangle+count_point];
+
+						tri_norm[3*num_tri+count_point] = edge_norm[index];
+						tri_pos[3*num_tri+count_point].x = edge_vertex[index].x+origin.x;
+						tri_pos[3*num_tri+count_point].y = edge_vertex[index].y+origin.y;
+						tri_pos[3*num_tri+count_point].z = edge_vertex[index].z+origin.z;
+					}
 
-							glNormal3f(edge_norm[index].x, edge_norm[index].y, edge_norm[index].z);
-							glVertex3f(edge_vertex[index].x+origin.x,
-										edge_vertex[index].y+origin.y, 
-										edge_vertex[index].z+origin.z);
-						
-						}
-					glEnd();
+					num_tri++;
 				}
 			}
 		}
@@ -26,6 +26,7 @@
 #include <stdlib.h>
 #include <string.h>
 
+#ifndef __SPHTYPE_H__
 typedef unsigned int uint;
 
 struct float3
@@ -34,6 +35,7 @@ struct float3
 	float y;
 	float z;
 };
+#endif
 
 class MarchingCube
 {
@@ -54,6 +56,11 @@ private:
 
 public:
 
+	float3 *tri_pos;
+	float3 *tri_norm;
+	uint num_tri;
+	uint max_tri;
+
 	MarchingCube(uint _row_vox, uint _col_vox, uint _len_vox, float *_scalar, float3 *_pos, float3 _origin, float _step, float _isovalue);
 	~MarchingCube();
 	void run();
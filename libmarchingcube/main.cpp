@@ -19,8 +19,10 @@
  ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include "../SPH_CPU_3D_v1/sph_frame.h"
 #include "MarchingCube.h"
 #include <gl\glut.h>
+#include <stdio.h>
 
 float window_width  = 600;
 float window_height = 600;
@@ -53,6 +55,92 @@ uint tot_vox;
 float vox_size;
 MarchingCube *mc;
 
+FrameReader *replay = NULL;
+uint replay_frame = 0;
+uint replay_running = 1;
+
+/** Splats the particles of the current replay frame into model_scalar with
+ ** the poly6 kernel, each taking the volume (kernel/2)^3 it has in the
+ ** lattice of init_system(), so the field is about 1 inside the fluid.
+ */
+void splat_replay()
+{
+	float h = replay->head.kernel;
+	float h2 = h*h;
+	float coe = 315.0f/(64.0f*3.141592f*pow(h, 9))*pow(h*0.5f, 3);
+
+	float3 ratio;
+	float3 p;
+	float3 rel;
+	float r2;
+
+	int lo[3];
+	int hi[3];
+	uint index;
+
+	ratio.x = world_side.x/replay->head.world_size.x;
+	ratio.y = world_side.y/replay->head.world_size.y;
+	ratio.z = world_side.z/replay->head.world_size.z;
+
+	memset(model_scalar, 0, sizeof(float)*tot_vox);
+
+	for(uint i=0; i<replay->num_particle; i++)
+	{
+		p.x = replay->pos[i].x*ratio.x;
+		p.y = replay->pos[i].y*ratio.y;
+		p.z = replay->pos[i].z*ratio.z;
+
+		lo[0] = (int)ceil((p.x-h*ratio.x)/vox_size);
+		lo[1] = (int)ceil((p.y-h*ratio.y)/vox_size);
+		lo[2] = (int)ceil((p.z-h*ratio.z)/vox_size);
+		hi[0] = (int)floor((p.x+h*ratio.x)/vox_size);
+		hi[1] = (int)floor((p.y+h*ratio.y)/vox_size);
+		hi[2] = (int)floor((p.z+h*ratio.z)/vox_size);
+
+		lo[0] = lo[0] < 0 ? 0 : lo[0];
+		lo[1] = lo[1] < 0 ? 0 : lo[1];
+		lo[2] = lo[2] < 0 ? 0 : lo[2];
+		hi[0] = hi[0] >= (int)row_vox ? (int)row_vox-1 : hi[0];
+		hi[1] = hi[1] >= (int)col_vox ? (int)col_vox-1 : hi[1];
+		hi[2] = hi[2] >= (int)len_vox ? (int)len_vox-1 : hi[2];
+
+		for(int count_x=lo[0]; count_x<=hi[0]; count_x++)
+		{
+			for(int count_y=lo[1]; count_y<=hi[1]; count_y++)
+			{
+				for(int count_z=lo[2]; count_z<=hi[2]; count_z++)
+				{
+					rel.x = (count_x*vox_size-p.x)/ratio.x;
+					rel.y = (count_y*vox_size-p.y)/ratio.y;
+					rel.z = (count_z*vox_size-p.z)/ratio.z;
+					r2 = rel.x*rel.x+rel.y*rel.y+rel.z*rel.z;
+
+					if(r2 < h2)
+					{
+						index = count_z*row_vox*col_vox+count_y*row_vox+count_x;
+						model_scalar[index] += coe*(h2-r2)*(h2-r2)*(h2-r2);
+					}
+				}
+			}
+		}
+	}
+}
+
+void init_replay(const char *file)
+{
+	replay = new FrameReader();
+
+	if(replay->open(file) == 0 || (replay->head.attrib & FRAME_POS) == 0 || replay->seek(0) == 0)
+	{
+		printf("Cannot replay: %s\n", file);
+		delete replay;
+		replay = NULL;
+		return;
+	}
+
+	printf("Replay: %u frames\n", replay->num_frame);
+}
+
 void init_marching_cube_model()
 {
 	vox_size = 0.5f;
@@ -85,6 +173,11 @@ void init_marching_cube_model()
 				model_vox[index].y = count_y*vox_size;
 				model_vox[index].z = count_z*vox_size;
 
+				if(replay != NULL)
+				{
+					continue;
+				}
+
 				dist = (model_vox[index].x-model_center.x)*(model_vox[index].x-model_center.x)
 						+(model_vox[index].y-model_center.y)*(model_vox[index].y-model_center.y)
 						+(model_vox[index].z-model_center.z)*(model_vox[index].z-model_center.z);
@@ -100,6 +193,11 @@ void init_marching_cube_model()
 		}
 	}
 
+	if(replay != NULL)
+	{
+		splat_replay();
+	}
+
 	mc = new MarchingCube(row_vox, col_vox, len_vox, model_scalar, model_vox, world_origin, vox_size, 0.4f);
 }
 
@@ -206,8 +304,30 @@ void display_func()
 	glEnable(GL_LIGHT1);
 	glEnable(GL_LIGHTING);
 
+	if(replay != NULL)
+	{
+		if(replay_running && replay_frame+1 < replay->num_frame)
+		{
+			replay_frame++;
+		}
+
+		if(replay_frame != replay->frame)
+		{
+			replay->seek(replay_frame);
+			splat_replay();
+		}
+	}
+
 	mc->run();
 
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_NORMAL_ARRAY);
+	glVertexPointer(3, GL_FLOAT, 0, mc->tri_pos);
+	glNormalPointer(GL_FLOAT, 0, mc->tri_norm);
+	glDrawArrays(GL_TRIANGLES, 0, mc->num_tri*3);
+	glDisableClientState(GL_NORMAL_ARRAY);
+	glDisableClientState(GL_VERTEX_ARRAY);
+
 	glDisable(GL_LIGHTING);
 
 	glColor3f(1.0f, 0.0f, 0.0f);
@@ -222,11 +342,21 @@ void display_func()
 	glPopMatrix();
 
     glutSwapBuffers();
+
+	if(replay != NULL)
+	{
+		char title[64];
+		sprintf(title, "Marching Cube. Replay: %u/%u Time: %.3f", replay->frame+1, replay->num_frame, replay->time);
+		glutSetWindowTitle(title);
+	}
 }
 
 void idle_func()
 {
-	//glutPostRedisplay();
+	if(replay != NULL && replay_running)
+	{
+		glutPostRedisplay();
+	}
 }
 
 void reshape_func(GLint width, GLint height)
@@ -247,6 +377,23 @@ void reshape_func(GLint width, GLint height)
 
 void keyboard_func(unsigned char key, int x, int y)
 {
+	if(replay != NULL && key == ' ')
+	{
+		replay_running = 1-replay_running;
+	}
+
+	if(replay != NULL && (key == ',' || key == '.'))
+	{
+		replay_running = 0;
+		replay_frame = key == ',' ? (replay_frame > 0 ? replay_frame-1 : 0) : (replay_frame+1 < replay->num_frame ? replay_frame+1 : replay_frame);
+	}
+
+	if(replay != NULL && (key == '[' || key == ']'))
+	{
+		uint jump = replay->num_frame/10 > 0 ? replay->num_frame/10 : 1;
+		replay_frame = key == '[' ? (replay_frame > jump ? replay_frame-jump : 0) : (replay_frame+jump < replay->num_frame ? replay_frame+jump : replay->num_frame-1);
+	}
+
 	if(key == 'w')
 	{
 		z_trans += 1.0f;
@@ -350,6 +497,10 @@ int main(int argc, char **argv)
     glutCreateWindow("Marching Cube");
 
 	init();
+	if(argc > 1)
+	{
+		init_replay(argv[1]);
+	}
 	init_marching_cube_model();
 
     glutDisplayFunc(display_func);
@@ -364,6 +515,7 @@ int main(int argc, char **argv)
 
 	free(model_scalar);
 	free(model_vox);
+	delete replay;
 
     return 0;
 }